@@ -21,6 +21,9 @@ struct Action {
   SHA sha1;                  ///< SHA code of action
   int32_t duration{0};       ///< duration of action
   Dependencies dependencies; ///< List of dependencies
+  int64_t memory{0};         ///< memory held on the node while running
+  int32_t slots{1};          ///< CPU slots held on the node while running
+  int32_t deviation{0};      ///< standard deviation of duration
 
   // Heterogenious Earliest-Finish-Time (HEFT) parameters
   Time rank{
@@ -0,0 +1,571 @@
+#include "heft.h"
+#include "input.h"
+#include "memory.h"
+#include "output.h"
+#include "schedulers.h"
+#include "server.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// @brief Reports number of allocations and peak heap usage of a benchmarked
+/// function above the heap in use when it started
+class HeapMemoryManager : public benchmark::MemoryManager {
+public:
+  void Start() override {
+    const auto usage = builder::heapUsage();
+    startAllocations_ = usage.allocations;
+    startBytes_ = usage.bytes;
+    builder::resetPeakHeapBytes();
+  }
+
+  // Older versions of the library have only this overload
+  void Stop(Result *result) { Stop(*result); }
+
+  void Stop(Result &result) override {
+    const auto usage = builder::heapUsage();
+    result.num_allocs = usage.allocations - startAllocations_;
+    result.max_bytes_used = usage.peakBytes - startBytes_;
+    result.net_heap_growth = usage.bytes - startBytes_;
+  }
+
+private:
+  int64_t startAllocations_{0};
+  int64_t startBytes_{0};
+};
+
+// ---- Synthetic actions graphs ----
+
+/// @brief Shapes of generated actions graphs
+enum class Shape {
+  Chain,          ///< every action depends on the previous one
+  FanOutIn,       ///< one root, all actions depend on it, one sink on all
+  Layered,        ///< 100 layers, 1 to 4 random dependencies in the previous
+  CompilerLinker, ///< code generation, compilation, libraries, executables
+  DeepDense       ///< every action depends on 32 previous ones
+};
+
+const char *shapeName(Shape shape) {
+  switch (shape) {
+  case Shape::Chain:
+    return "chain";
+  case Shape::FanOutIn:
+    return "fan_out_in";
+  case Shape::Layered:
+    return "layered";
+  case Shape::CompilerLinker:
+    return "compiler_linker";
+  case Shape::DeepDense:
+    return "deep_dense";
+  }
+  return "";
+}
+
+/// @brief Writes actions in the input file format with 16 hex digits SHAs,
+/// the same seed always gives the same text
+class Generator {
+public:
+  explicit Generator(int64_t actionsNumber) {
+    // Typical line is a SHA, a duration and a few dependencies
+    text_.reserve(actionsNumber * 64);
+  }
+
+  /// @brief Append action depending on actions with given indices
+  /// @return index of the action
+  int64_t add(builder::Duration duration, const std::vector<int64_t> &deps) {
+    appendSha(actionsNumber_);
+    text_ += ' ';
+    text_ += std::to_string(duration);
+    for (auto dependency : deps) {
+      text_ += ' ';
+      appendSha(dependency);
+    }
+    text_ += '\n';
+    return actionsNumber_++;
+  }
+
+  /// @brief Random number in [from, to]
+  int64_t random(int64_t from, int64_t to) {
+    return std::uniform_int_distribution<int64_t>(from, to)(random_);
+  }
+
+  int64_t size() const { return actionsNumber_; }
+  std::string &text() { return text_; }
+
+private:
+  void appendSha(int64_t index) {
+    // SplitMix64 scatters SHAs like real hashes do
+    uint64_t z = static_cast<uint64_t>(index) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    static const char digits[] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4) {
+      text_ += digits[(z >> shift) & 0xf];
+    }
+  }
+
+  std::string text_{};
+  int64_t actionsNumber_{0};
+  std::mt19937_64 random_{20240229};
+};
+
+/// @brief Generate actions graph of given shape in the input file format
+std::string generateActions(Shape shape, int64_t actionsNumber) {
+  Generator g(actionsNumber);
+  std::vector<int64_t> deps;
+  switch (shape) {
+  case Shape::Chain:
+    g.add(g.random(1, 100), {});
+    while (g.size() < actionsNumber) {
+      g.add(g.random(1, 100), {g.size() - 1});
+    }
+    break;
+
+  case Shape::FanOutIn:
+    g.add(g.random(1, 100), {});
+    while (g.size() < actionsNumber - 1) {
+      g.add(g.random(1, 100), {0});
+    }
+    for (int64_t i = 1; i < g.size(); ++i) {
+      deps.push_back(i);
+    }
+    g.add(g.random(1, 100), deps);
+    break;
+
+  case Shape::Layered: {
+    const int64_t width = std::max<int64_t>(1, actionsNumber / 100);
+    while (g.size() < actionsNumber) {
+      const int64_t layerBegin = g.size() / width * width;
+      deps.clear();
+      if (layerBegin > 0) {
+        for (auto i = g.random(1, 4); i > 0; --i) {
+          deps.push_back(g.random(layerBegin - width, layerBegin - 1));
+        }
+      }
+      g.add(g.random(1, 100), deps);
+    }
+    break;
+  }
+
+  case Shape::CompilerLinker: {
+    // 1% code generators, libraries of 50 compiled sources linked with a few
+    // earlier libraries, then executables linking 8 libraries each
+    const int64_t generators = std::max<int64_t>(1, actionsNumber / 100);
+    const int64_t executables = std::max<int64_t>(1, actionsNumber / 1000);
+    const int64_t librariesEnd = actionsNumber - executables;
+    std::vector<int64_t> libraries;
+    while (g.size() < generators) {
+      g.add(g.random(10, 100), {});
+    }
+    while (g.size() < librariesEnd) {
+      std::vector<int64_t> objects;
+      while (objects.size() < 50 && g.size() < librariesEnd - 1) {
+        deps.clear();
+        for (auto i = g.random(0, 2); i > 0; --i) {
+          deps.push_back(g.random(0, generators - 1));
+        }
+        objects.push_back(g.add(g.random(100, 5000), deps));
+      }
+      for (auto i = std::min<int64_t>(3, libraries.size()); i > 0; --i) {
+        objects.push_back(
+            libraries[g.random(0, static_cast<int64_t>(libraries.size()) - 1)]);
+      }
+      libraries.push_back(g.add(g.random(1000, 20000), objects));
+    }
+    while (g.size() < actionsNumber) {
+      deps.clear();
+      for (int i = 0; i < 8; ++i) {
+        deps.push_back(
+            libraries[g.random(0, static_cast<int64_t>(libraries.size()) - 1)]);
+      }
+      g.add(g.random(1000, 20000), deps);
+    }
+    break;
+  }
+
+  case Shape::DeepDense:
+    while (g.size() < actionsNumber) {
+      deps.clear();
+      for (int64_t i = std::max<int64_t>(0, g.size() - 32); i < g.size(); ++i) {
+        deps.push_back(i);
+      }
+      g.add(g.random(1, 100), deps);
+    }
+    break;
+  }
+  return std::move(g.text());
+}
+
+// ---- Benchmarks ----
+
+/// @brief Number of executors actions are scheduled on
+constexpr builder::Id executorsNumber{64};
+
+/// @brief Input and scheduled graph of a shape and size, benchmarks of
+/// every stage start from the state left by the previous stages
+struct Workload {
+  Shape shape{};
+  int64_t actionsNumber{0};
+  std::string text{};
+  builder::Graph graph{};
+  builder::RankIds rankIds{};
+  builder::Time heftMakespan{0}; ///< makespan of the plan of schedule()
+  std::unique_ptr<builder::Actions> actions{}; ///< created on demand
+  builder::RankShas rankShas{};
+  std::unique_ptr<builder::PlanningServer> server{}; ///< created on demand
+};
+
+/// @brief Workload of the last benchmark, benchmarks are registered in order
+/// of shapes and sizes, so every workload is created once
+Workload &getWorkload(Shape shape, int64_t actionsNumber) {
+  static std::unique_ptr<Workload> workload;
+  if (!workload || workload->shape != shape ||
+      workload->actionsNumber != actionsNumber) {
+    workload.reset();
+    workload = std::make_unique<Workload>();
+    workload->shape = shape;
+    workload->actionsNumber = actionsNumber;
+    workload->text = generateActions(shape, actionsNumber);
+    workload->graph = builder::parse_graph(workload->text);
+    builder::calculateRanks(workload->graph);
+    workload->rankIds = builder::computeRankIds(workload->graph);
+    builder::schedule(executorsNumber, workload->rankIds, workload->graph);
+    workload->heftMakespan = builder::makespan(workload->graph);
+  }
+  return *workload;
+}
+
+/// @brief Actions map of the workload after calculateRanks()
+builder::Actions &getActions(Workload &workload) {
+  if (!workload.actions) {
+    std::istringstream input(workload.text);
+    workload.actions =
+        std::make_unique<builder::Actions>(builder::load_actions(input));
+    builder::calculateRanks(*workload.actions);
+    workload.rankShas = builder::computeRankShas(*workload.actions);
+  }
+  return *workload.actions;
+}
+
+/// @brief Planning server of a copy of the workload graph
+builder::PlanningServer &getServer(Workload &workload) {
+  if (!workload.server) {
+    workload.server = std::make_unique<builder::PlanningServer>(
+        workload.graph, builder::Placement::Append, 0);
+  }
+  return *workload.server;
+}
+
+void setThroughput(benchmark::State &state, const Workload &workload) {
+  state.SetItemsProcessed(state.iterations() * workload.actionsNumber);
+  state.counters["edges"] =
+      static_cast<double>(workload.graph.dependencies.targets.size());
+}
+
+void loadActions(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  for (auto _ : state) {
+    std::istringstream input(workload.text);
+    benchmark::DoNotOptimize(builder::load_actions(input));
+  }
+  state.SetBytesProcessed(state.iterations() * workload.text.size());
+  setThroughput(state, workload);
+}
+
+void loadGraph(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(builder::parse_graph(workload.text));
+  }
+  state.SetBytesProcessed(state.iterations() * workload.text.size());
+  setThroughput(state, workload);
+}
+
+void calculateRanks(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  for (auto _ : state) {
+    builder::calculateRanks(workload.graph);
+    benchmark::ClobberMemory();
+  }
+  setThroughput(state, workload);
+}
+
+void calculateRanksInParallel(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  const auto executors = builder::Executors::identical(executorsNumber);
+  for (auto _ : state) {
+    builder::calculateRanks(workload.graph, executors, 0);
+    benchmark::ClobberMemory();
+  }
+  setThroughput(state, workload);
+  state.counters["threads"] = std::thread::hardware_concurrency();
+}
+
+void computeRankIds(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(builder::computeRankIds(workload.graph));
+  }
+  setThroughput(state, workload);
+}
+
+void computeRankShas(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  auto &actions = getActions(workload);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(builder::computeRankShas(actions));
+  }
+  setThroughput(state, workload);
+}
+
+void schedule(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  for (auto _ : state) {
+    builder::schedule(executorsNumber, workload.rankIds, workload.graph);
+    benchmark::ClobberMemory();
+  }
+  setThroughput(state, workload);
+}
+
+void scheduleActions(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  auto &actions = getActions(workload);
+  for (auto _ : state) {
+    builder::schedule(executorsNumber, workload.rankShas, actions);
+    benchmark::ClobberMemory();
+  }
+  setThroughput(state, workload);
+}
+
+void getExecutionPlan(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(builder::getExecutionPlan(workload.graph));
+  }
+  setThroughput(state, workload);
+}
+
+/// @brief Stream buffer which drops output and counts its bytes
+class CountingBuffer : public std::streambuf {
+public:
+  int64_t bytes() const { return bytes_; }
+
+protected:
+  std::streamsize xsputn(const char *, std::streamsize count) override {
+    bytes_ += count;
+    return count;
+  }
+  int_type overflow(int_type c) override {
+    ++bytes_;
+    return traits_type::not_eof(c);
+  }
+
+private:
+  int64_t bytes_{0};
+};
+
+void savePlan(benchmark::State &state, Shape shape,
+              builder::PlanFormat format) {
+  auto &workload = getWorkload(shape, state.range(0));
+  CountingBuffer buffer;
+  std::ostream output(&buffer);
+  for (auto _ : state) {
+    builder::save_plan(workload.graph, format, output);
+  }
+  state.SetBytesProcessed(buffer.bytes());
+  setThroughput(state, workload);
+}
+
+void savePlanTsv(benchmark::State &state, Shape shape) {
+  savePlan(state, shape, builder::PlanFormat::Tsv);
+}
+
+void savePlanNdjson(benchmark::State &state, Shape shape) {
+  savePlan(state, shape, builder::PlanFormat::Ndjson);
+}
+
+void savePlanTrace(benchmark::State &state, Shape shape) {
+  savePlan(state, shape, builder::PlanFormat::ChromeTrace);
+}
+
+void getCriticalPath(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(builder::getCriticalPath(workload.graph));
+  }
+  setThroughput(state, workload);
+}
+
+/// @brief Latency of answering a request of the planning server
+void serverRequest(benchmark::State &state, Shape shape,
+                   const std::string &request) {
+  auto &workload = getWorkload(shape, state.range(0));
+  auto &server = getServer(workload);
+  std::string response;
+  for (auto _ : state) {
+    response.clear();
+    server.handle(request, response);
+    benchmark::DoNotOptimize(response.data());
+  }
+  if (response.rfind("error ", 0) == 0) {
+    state.SkipWithError(response.c_str());
+  }
+  setThroughput(state, workload);
+}
+
+void serverMakespan(benchmark::State &state, Shape shape) {
+  serverRequest(state, shape, "makespan " + std::to_string(executorsNumber));
+}
+
+void serverCriticalPath(benchmark::State &state, Shape shape) {
+  serverRequest(state, shape, "critical-path");
+}
+
+/// @brief Update of the action in the middle of the graph, its ancestors
+/// are recalculated
+void serverUpdate(benchmark::State &state, Shape shape) {
+  auto &workload = getWorkload(shape, state.range(0));
+  const auto id = workload.graph.size() / 2;
+  const std::string sha(workload.graph.shas[id]);
+  const auto duration = workload.graph.durations[id];
+  serverRequest(state, shape,
+                "update " + sha + " " + std::to_string(duration + 1));
+  // Next benchmarks see the original durations
+  std::string response;
+  getServer(workload).handle("update " + sha + " " + std::to_string(duration),
+                             response);
+}
+
+/// @brief Runtime of a scheduler with makespan of its plan, which is the
+/// quality it buys
+void runScheduler(benchmark::State &state, Shape shape,
+                  std::string_view name) {
+  auto &workload = getWorkload(shape, state.range(0));
+  const auto executors = builder::Executors::identical(executorsNumber);
+  const auto scheduler = builder::makeScheduler(name);
+  for (auto _ : state) {
+    scheduler->schedule(executors, workload.graph, builder::Placement::Append);
+    benchmark::ClobberMemory();
+  }
+  setThroughput(state, workload);
+  const auto makespan = builder::makespan(workload.graph);
+  state.counters["makespan"] = static_cast<double>(makespan);
+  state.counters["makespan_vs_heft"] =
+      static_cast<double>(makespan) / std::max<builder::Time>(
+                                          1, workload.heftMakespan);
+}
+
+/// @brief Largest graph of a shape, edges of the deep dense graph take 32
+/// times more memory than its actions
+int64_t maxActionsOf(Shape shape, int64_t maxActions) {
+  return shape == Shape::DeepDense ? std::min<int64_t>(maxActions, 1000000)
+                                   : maxActions;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // --max-actions=N limits sizes of graphs, they grow 10 times from 1000
+  int64_t maxActions{10000000};
+  // Benchmarks of the map of actions are slow and memory hungry, so they
+  // have a separate limit, --max-map-actions=N
+  int64_t maxMapActions{1000000};
+  // Schedulers other than HEFT are compared on smaller graphs,
+  // --max-scheduler-actions=N
+  int64_t maxSchedulerActions{100000};
+  std::vector<char *> arguments{argv[0]};
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument.rfind("--max-actions=", 0) == 0) {
+      maxActions = std::stoll(argument.substr(std::strlen("--max-actions=")));
+    } else if (argument.rfind("--max-map-actions=", 0) == 0) {
+      maxMapActions =
+          std::stoll(argument.substr(std::strlen("--max-map-actions=")));
+    } else if (argument.rfind("--max-scheduler-actions=", 0) == 0) {
+      maxSchedulerActions =
+          std::stoll(argument.substr(std::strlen("--max-scheduler-actions=")));
+    } else {
+      arguments.push_back(argv[i]);
+    }
+  }
+  int argumentsNumber = static_cast<int>(arguments.size());
+
+  using Stage = void (*)(benchmark::State &, Shape);
+  struct NamedStage {
+    const char *name;
+    Stage stage;
+    bool onActionsMap;
+  };
+  const NamedStage stages[] = {
+      {"load_actions", loadActions, true},
+      {"load_graph", loadGraph, false},
+      {"calculateRanks", calculateRanks, false},
+      {"calculateRanks/parallel", calculateRanksInParallel, false},
+      {"computeRankShas", computeRankShas, true},
+      {"computeRankIds", computeRankIds, false},
+      {"schedule/actions", scheduleActions, true},
+      {"schedule", schedule, false},
+      {"getExecutionPlan", getExecutionPlan, false},
+      {"save_plan/tsv", savePlanTsv, false},
+      {"save_plan/ndjson", savePlanNdjson, false},
+      {"save_plan/trace", savePlanTrace, false},
+      {"getCriticalPath", getCriticalPath, false},
+      {"server/makespan", serverMakespan, false},
+      {"server/critical-path", serverCriticalPath, false},
+      {"server/update", serverUpdate, false},
+  };
+  // All stages of a workload run one after another to create it once
+  for (auto shape : {Shape::Chain, Shape::FanOutIn, Shape::Layered,
+                     Shape::CompilerLinker, Shape::DeepDense}) {
+    for (int64_t actionsNumber = 1000;
+         actionsNumber <= maxActionsOf(shape, maxActions);
+         actionsNumber *= 10) {
+      for (auto &[name, stage, onActionsMap] : stages) {
+        if (onActionsMap && actionsNumber > maxMapActions) {
+          continue;
+        }
+        benchmark::RegisterBenchmark(
+            (std::string(name) + "/" + shapeName(shape)).c_str(), stage, shape)
+            ->Arg(actionsNumber)
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+      }
+      if (actionsNumber > maxSchedulerActions) {
+        continue;
+      }
+      for (auto name : builder::schedulerNames()) {
+        benchmark::RegisterBenchmark(
+            ("scheduler/" + std::string(name) + "/" + shapeName(shape)).c_str(),
+            runScheduler, shape, name)
+            ->Arg(actionsNumber)
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+      }
+    }
+  }
+
+  HeapMemoryManager memoryManager;
+  benchmark::RegisterMemoryManager(&memoryManager);
+  benchmark::Initialize(&argumentsNumber, arguments.data());
+  if (benchmark::ReportUnrecognizedArguments(argumentsNumber,
+                                             arguments.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::RegisterMemoryManager(nullptr);
+  benchmark::Shutdown();
+  return 0;
+}
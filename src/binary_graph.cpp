@@ -0,0 +1,205 @@
+#include "binary_graph.h"
+#include "binary_io.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace builder {
+
+namespace {
+
+using binary_io::readBytes;
+using binary_io::writeArray;
+using binary_io::writeBytes;
+
+const char signature[8] = {'B', 'L', 'D', 'G', 'R', 'A', 'P', 'H'};
+/// Version of the format, it must change whenever arrays are added, so that
+/// files of other versions are rejected instead of misread
+const uint32_t formatVersion{2};
+const uint32_t withRanksFlag{1};
+const uint32_t withDataSizesFlag{2};
+const uint32_t withDemandsFlag{4};
+const uint32_t withDeviationsFlag{8};
+const uint32_t knownFlags{withRanksFlag | withDataSizesFlag | withDemandsFlag |
+                          withDeviationsFlag};
+const uint64_t byteOrderMark{0x0102030405060708ull};
+const std::string_view formatName{"Binary graph"};
+
+/// @brief Binary graph file header, it is followed by arrays of the graph,
+/// each padded to 8 bytes
+struct Header {
+  char signature[8];        ///< binary graph format signature
+  uint32_t version;         ///< format version
+  uint32_t flags;           ///< withRanksFlag, withDataSizesFlag,
+                            ///< withDemandsFlag, withDeviationsFlag if saved
+  uint64_t byteOrder;       ///< byteOrderMark in byte order of the writer
+  int64_t actionsNumber;    ///< number of actions including phony ones
+  int64_t edgesNumber;      ///< number of dependencies
+  int64_t shaBytesNumber;   ///< size of the SHA pool
+  int64_t indexSlotsNumber; ///< size of the SHA index
+};
+
+std::runtime_error inconsistency(const std::string &what) {
+  return binary_io::inconsistency(formatName, what);
+}
+
+void checkOffsets(const std::vector<Offset> &offsets, int64_t size) {
+  binary_io::checkOffsets(offsets, size, formatName);
+}
+
+/// @brief Check that every dependency has a smaller Id than its dependent,
+/// and dependents are the reverse edges as built by Graph::finalize()
+void checkEdges(const Graph &graph) {
+  std::vector<Offset> position(graph.dependents.offsets.begin(),
+                               graph.dependents.offsets.end() - 1);
+  const bool withDataSizes = !graph.dependencies.dataSizes.empty();
+  for (Id node = 0; node < graph.size(); ++node) {
+    for (Offset edge = graph.dependencies.offsets[node];
+         edge < graph.dependencies.offsets[node + 1]; ++edge) {
+      const Id dependency = graph.dependencies.targets[edge];
+      if (dependency < 0 || dependency >= node) {
+        throw inconsistency("dependencies");
+      }
+      const Offset reverseEdge = position[dependency]++;
+      if (reverseEdge >= graph.dependents.offsets[dependency + 1] ||
+          graph.dependents.targets[reverseEdge] != node ||
+          (withDataSizes && graph.dependents.dataSizes[reverseEdge] !=
+                                graph.dependencies.dataSizes[edge])) {
+        throw inconsistency("dependents");
+      }
+    }
+  }
+}
+
+} // namespace
+
+void save_binary_graph(const Graph &graph, const std::filesystem::path &file,
+                       bool withRanks) {
+  std::ofstream of(file, std::ofstream::out | std::ofstream::trunc |
+                             std::ofstream::binary);
+  if (!of) {
+    throw std::runtime_error("Couldn't open output file '" + file.string() +
+                             "'");
+  }
+  Header header{};
+  std::memcpy(header.signature, signature, sizeof(signature));
+  header.version = formatVersion;
+  header.flags =
+      (withRanks ? withRanksFlag : 0) |
+      (graph.dependencies.dataSizes.empty() ? 0 : withDataSizesFlag) |
+      (graph.memoryDemands.empty() ? 0 : withDemandsFlag) |
+      (graph.deviations.empty() ? 0 : withDeviationsFlag);
+  header.byteOrder = byteOrderMark;
+  header.actionsNumber = graph.size();
+  header.edgesNumber = graph.dependencies.targets.size();
+  header.shaBytesNumber = graph.shas.bytes.size();
+  header.indexSlotsNumber = graph.shaIndex.slots.size();
+  writeBytes(of, &header, sizeof(header));
+
+  writeArray(of, graph.shas.offsets);
+  writeBytes(of, graph.shas.bytes.data(), graph.shas.bytes.size());
+  writeArray(of, graph.shaIndex.slots);
+  writeArray(of, graph.durations);
+  writeArray(of, graph.dependencies.offsets);
+  writeArray(of, graph.dependencies.targets);
+  writeArray(of, graph.dependents.offsets);
+  writeArray(of, graph.dependents.targets);
+  if (header.flags & withDataSizesFlag) {
+    writeArray(of, graph.dependencies.dataSizes);
+    writeArray(of, graph.dependents.dataSizes);
+  }
+  if (header.flags & withDemandsFlag) {
+    writeArray(of, graph.memoryDemands);
+    writeArray(of, graph.slotDemands);
+  }
+  if (header.flags & withDeviationsFlag) {
+    writeArray(of, graph.deviations);
+  }
+  if (withRanks) {
+    writeArray(of, graph.ranks);
+    writeArray(of, graph.longestPaths);
+    writeArray(of, graph.predecessors);
+  }
+  of.close();
+  if (!of) {
+    throw std::runtime_error("Error writing binary graph to '" +
+                             file.string() + "'");
+  }
+}
+
+bool is_binary_graph(std::string_view data) {
+  return data.size() >= sizeof(signature) &&
+         std::memcmp(data.data(), signature, sizeof(signature)) == 0;
+}
+
+Graph load_binary_graph(std::string_view data) {
+  if (!is_binary_graph(data) || data.size() < sizeof(Header)) {
+    throw std::runtime_error("Not a binary graph file.");
+  }
+  Header header;
+  std::memcpy(&header, readBytes(data, sizeof(Header), formatName),
+              sizeof(Header));
+  if (header.version != formatVersion || header.byteOrder != byteOrderMark ||
+      (header.flags & ~knownFlags) != 0) {
+    throw std::runtime_error(
+        "Binary graph file has unsupported version, flags or byte order, "
+        "it must be rebuilt from the text input.");
+  }
+  if (header.actionsNumber < 3) {
+    throw std::runtime_error(
+        "There must be at least one action to schedule, got zero actions.");
+  }
+
+  if (header.actionsNumber > std::numeric_limits<Id>::max()) {
+    throw std::runtime_error("Binary graph file has too many actions.");
+  }
+
+  auto read = [&](int64_t count, auto &array) {
+    binary_io::readArray(data, count, array, formatName);
+  };
+  Graph graph;
+  read(header.actionsNumber + 1, graph.shas.offsets);
+  checkOffsets(graph.shas.offsets, header.shaBytesNumber);
+  graph.shas.bytes.assign(readBytes(data, header.shaBytesNumber, formatName),
+                          header.shaBytesNumber);
+  read(header.indexSlotsNumber, graph.shaIndex.slots);
+  read(header.actionsNumber, graph.durations);
+  read(header.actionsNumber + 1, graph.dependencies.offsets);
+  checkOffsets(graph.dependencies.offsets, header.edgesNumber);
+  read(header.edgesNumber, graph.dependencies.targets);
+  read(header.actionsNumber + 1, graph.dependents.offsets);
+  checkOffsets(graph.dependents.offsets, header.edgesNumber);
+  read(header.edgesNumber, graph.dependents.targets);
+  if (header.flags & withDataSizesFlag) {
+    read(header.edgesNumber, graph.dependencies.dataSizes);
+    read(header.edgesNumber, graph.dependents.dataSizes);
+  }
+  if (header.flags & withDemandsFlag) {
+    read(header.actionsNumber, graph.memoryDemands);
+    read(header.actionsNumber, graph.slotDemands);
+  }
+  if (header.flags & withDeviationsFlag) {
+    read(header.actionsNumber, graph.deviations);
+  }
+  binary_io::checkIndex(graph.shaIndex.slots, graph.size(), formatName);
+  checkEdges(graph);
+
+  graph.resetSchedule();
+  if (header.flags & withRanksFlag) {
+    read(header.actionsNumber, graph.ranks);
+    read(header.actionsNumber, graph.longestPaths);
+    read(header.actionsNumber, graph.predecessors);
+    for (Id predecessor : graph.predecessors) {
+      if (predecessor < -1 || predecessor >= graph.size()) {
+        throw inconsistency("predecessors");
+      }
+    }
+    graph.ranksCalculated = true;
+  }
+  return graph;
+}
+
+} // namespace builder
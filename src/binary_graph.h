@@ -0,0 +1,33 @@
+#pragma once
+
+#include "graph.h"
+
+#include <filesystem>
+
+namespace builder {
+
+/// @brief Save graph in the binary graph format, which is loaded by
+/// load_graph() much faster than the text format. The format stores the SHA
+/// pool and index, durations with their deviations, CSR edges with their data
+/// sizes, resource demands and optionally HEFT ranks and longest paths, all
+/// in native byte order.
+/// @param graph graph to save
+/// @param file path to file to write to
+/// @param withRanks save ranks calculated by calculateRanks() as well
+void save_binary_graph(const Graph &graph, const std::filesystem::path &file,
+                       bool withRanks);
+
+/// @brief Check if given bytes are the beginning of a binary graph file
+/// @param data beginning of the file content
+/// @return true if data starts with the binary graph format signature
+bool is_binary_graph(std::string_view data);
+
+/// @brief Load graph from content of a binary graph file, arrays are copied
+/// in bulk without per-action allocations or hashing
+/// @param data content of file written by save_binary_graph()
+/// @return graph, with ranks calculated if they were saved. Throws
+/// std::runtime_error if the file is of another version, truncated, or its
+/// Ids, edges or SHA index are inconsistent.
+Graph load_binary_graph(std::string_view data);
+
+} // namespace builder
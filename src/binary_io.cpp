@@ -0,0 +1,82 @@
+#include "binary_io.h"
+
+#include <random>
+#include <system_error>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace builder {
+
+namespace binary_io {
+
+namespace {
+
+/// @brief Write parts to a new file and flush it to the disk
+void writeDurably(const std::filesystem::path &file,
+                  std::initializer_list<std::string_view> parts,
+                  std::string_view format) {
+  auto failure = [&]() {
+    return std::runtime_error("Error writing " + std::string(format) +
+                              " file to '" + file.string() + "'");
+  };
+#if defined(_WIN32)
+  std::ofstream of(file, std::ofstream::out | std::ofstream::trunc |
+                             std::ofstream::binary);
+  for (auto part : parts) {
+    of.write(part.data(), part.size());
+  }
+  of.close();
+  if (!of) {
+    throw failure();
+  }
+#else
+  const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw failure();
+  }
+  for (auto part : parts) {
+    while (!part.empty()) {
+      const auto written = ::write(fd, part.data(), part.size());
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        ::close(fd);
+        throw failure();
+      }
+      part.remove_prefix(written);
+    }
+  }
+  const bool synced = ::fsync(fd) == 0;
+  if (::close(fd) != 0 || !synced) {
+    throw failure();
+  }
+#endif
+}
+
+} // namespace
+
+void replaceFile(const std::filesystem::path &file,
+                 std::initializer_list<std::string_view> parts,
+                 std::string_view format) {
+  // Several processes may write the same file at once, each writes its own
+  // temporary file
+  auto temporary = file;
+  temporary += ".tmp" + std::to_string(std::random_device{}());
+  try {
+    writeDurably(temporary, parts, format);
+    std::filesystem::rename(temporary, file);
+  } catch (const std::exception &) {
+    std::error_code error;
+    std::filesystem::remove(temporary, error);
+    throw;
+  }
+}
+
+} // namespace binary_io
+
+} // namespace builder
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace builder {
+
+/// @brief Arrays of binary file formats, stored back to back in native byte
+/// order, each padded to 8 bytes so that they can be used in place
+namespace binary_io {
+
+inline size_t padded(size_t bytes) { return (bytes + 7) / 8 * 8; }
+
+inline void writeBytes(std::ofstream &of, const void *data, size_t bytes) {
+  static const char padding[8]{};
+  of.write(static_cast<const char *>(data), bytes);
+  of.write(padding, padded(bytes) - bytes);
+}
+
+template <class T>
+void writeArray(std::ofstream &of, const std::vector<T> &array) {
+  writeBytes(of, array.data(), array.size() * sizeof(T));
+}
+
+/// @brief Same as writeBytes(), but to content kept in memory
+inline void appendBytes(std::string &content, const void *data,
+                        size_t bytes) {
+  content.append(static_cast<const char *>(data), bytes);
+  content.append(padded(bytes) - bytes, '\0');
+}
+
+template <class T>
+void appendArray(std::string &content, const std::vector<T> &array) {
+  appendBytes(content, array.data(), array.size() * sizeof(T));
+}
+
+/// @brief Replace the file by the parts written back to back. They are
+/// written to a temporary file of a unique name next to it, which is flushed
+/// to the disk and renamed over the file, so that readers and concurrent
+/// writers never see it half written, even after a crash.
+/// @param file path to file to replace
+/// @param parts content of the file
+/// @param format name of the file format in errors, e.g. 'Duration model'
+/// Throws std::runtime_error or std::filesystem::filesystem_error on failure,
+/// the temporary file is removed then.
+void replaceFile(const std::filesystem::path &file,
+                 std::initializer_list<std::string_view> parts,
+                 std::string_view format);
+
+/// @brief Take bytes from the beginning of the data
+/// @param data [in, out] rest of the file content
+/// @param bytes number of bytes without padding
+/// @param format name of the file format in errors, e.g. 'Binary graph'
+/// @return beginning of the bytes, throws std::runtime_error if the data is
+/// too short
+inline const char *readBytes(std::string_view &data, size_t bytes,
+                             std::string_view format) {
+  // Padding of a huge size wraps around, so the size is checked first
+  if (bytes > data.size() || data.size() < padded(bytes)) {
+    throw std::runtime_error(std::string(format) + " file is truncated.");
+  }
+  const char *begin = data.data();
+  data.remove_prefix(padded(bytes));
+  return begin;
+}
+
+/// @brief Take array of count elements from the beginning of the data
+/// @param data [in, out] rest of the file content
+/// @param count number of elements from the file header
+/// @param array [out] elements of the array
+/// @param format name of the file format in errors, e.g. 'Binary graph'
+/// Throws std::runtime_error if count is negative or larger than the data.
+template <class T>
+void readArray(std::string_view &data, int64_t count, std::vector<T> &array,
+               std::string_view format) {
+  if (count < 0) {
+    throw std::runtime_error(std::string(format) +
+                             " file has negative array size.");
+  }
+  // Size in bytes of a crafted count may wrap around to a small one
+  if (static_cast<uint64_t>(count) > data.size() / sizeof(T)) {
+    throw std::runtime_error(std::string(format) + " file is truncated.");
+  }
+  const char *bytes = readBytes(data, count * sizeof(T), format);
+  if (reinterpret_cast<uintptr_t>(bytes) % alignof(T) == 0) {
+    const T *begin = reinterpret_cast<const T *>(bytes);
+    array.assign(begin, begin + count);
+  } else {
+    array.resize(count);
+    std::memcpy(array.data(), bytes, count * sizeof(T));
+  }
+}
+
+/// @brief Error of a file which has arrays of the right sizes, but their
+/// content doesn't fit together
+inline std::runtime_error inconsistency(std::string_view format,
+                                        const std::string &what) {
+  return std::runtime_error(std::string(format) + " file has inconsistent " +
+                            what + ".");
+}
+
+/// @brief Check offsets of a pool, they must begin with 0, end with the size
+/// of the pool and never decrease
+template <class T>
+void checkOffsets(const std::vector<T> &offsets, int64_t size,
+                  std::string_view format) {
+  if (offsets.front() != 0 || offsets.back() != size ||
+      !std::is_sorted(offsets.begin(), offsets.end())) {
+    throw inconsistency(format, "offsets");
+  }
+}
+
+/// @brief Check a SHA index of size entries, it must be a power of two slots
+/// of Ids or -1 with every entry in it and a free slot to end lookups, or no
+/// slots if there are no entries
+template <class T>
+void checkIndex(const std::vector<T> &slots, int64_t size,
+                std::string_view format) {
+  if (slots.empty() && size == 0) {
+    return;
+  }
+  if (slots.size() <= static_cast<uint64_t>(size) ||
+      (slots.size() & (slots.size() - 1)) != 0) {
+    throw inconsistency(format, "SHA index size");
+  }
+  int64_t usedSlots{0};
+  for (T id : slots) {
+    if (id < -1 || id >= size) {
+      throw inconsistency(format, "SHA index");
+    }
+    usedSlots += id >= 0;
+  }
+  if (usedSlots != size) {
+    throw inconsistency(format, "SHA index");
+  }
+}
+
+} // namespace binary_io
+
+} // namespace builder
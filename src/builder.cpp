@@ -1,12 +1,30 @@
+#include "binary_graph.h"
+#include "dispatch.h"
+#include "duration_model.h"
+#include "execution.h"
 #include "heft.h"
 #include "input.h"
+#include "memory.h"
+#include "output.h"
+#include "plan_cache.h"
+#include "schedulers.h"
+#include "server.h"
+#include "simulation.h"
+#include "slack.h"
+#include "stats.h"
+#include "sweep.h"
 
 #include <boost/program_options.hpp>
 
 #include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <vector>
 
 namespace po = boost::program_options;
 
@@ -24,21 +42,35 @@ Expected input file format is each line defining action duration and its depende
   action_sha duration
 or
   action_sha duration dependency_sha1 dependency_sha2 ...
+Dependency may be followed by the size of data it passes, like dependency_sha1:4096.
+Resources an action holds while running may be given among dependencies, like
+  action_sha duration memory=32000 slots=4 dependency_sha1 ...
+and so may standard deviation of duration, like deviation=20.
 Actions must be defined before mentioned as a dependency,
 hence no circular dependency is not possible to define (and cicrular deps are not supported).
 Empty lines with only whitespaces are allowed and discarded.
 
+Executors file format (option -e) is each line defining a class of identical
+executors on a node with durations of actions divided by the speed factor:
+  executor class_name count speed_factor [node_name]
+or bandwidths of passing data within a node and between nodes, 0 for unlimited:
+  bandwidth intra_node inter_node
+or duration of an action on executors of a class:
+  duration action_sha class_name duration
+or memory and CPU slots of a node shared by its executors, 0 for unlimited:
+  capacity node_name memory slots
+
 Schedule output file format:
   sha scheduledTime
 
 Allowed options: )";
 
 /// @brief Output scheduled execution plan to a given file
-/// @param executionPlan vector of pair<startTime, SHA> sorted in non-decreasing
-/// order of startTime
+/// @param graph scheduled actions graph
+/// @param format format of the plan
 /// @param scheduledExecutionPlanOutputPath path to file to output results to
 void outputScheduledExecutionPlanToGivenPath(
-    const builder::ExecutionPlan &executionPlan,
+    const builder::Graph &graph, builder::PlanFormat format,
     std::string &scheduledExecutionPlanOutputPath);
 
 /// @brief Output critical path to stdout
@@ -46,11 +78,93 @@ void outputScheduledExecutionPlanToGivenPath(
 /// order of execution
 void outputCriticalPath(const builder::CriticalPath &criticalPath);
 
+/// @brief Output actions with slack of at most maxSlack and the longest
+/// paths to stdout
+/// @param graph actions graph
+/// @param slack start times returned by calculateSlack()
+/// @param maxSlack largest slack of reported actions, no report if negative
+/// @param pathsNumber number of the longest paths to output
+void outputSlack(const builder::Graph &graph, const builder::SlackTimes &slack,
+                 builder::Time maxSlack, size_t pathsNumber);
+
+/// @brief Output percentiles of simulated makespans and the actions most
+/// often on the critical path to stdout
+/// @param graph scheduled actions graph
+/// @param distribution makespans returned by simulateMakespans()
+void outputMakespanDistribution(
+    const builder::Graph &graph,
+    const builder::MakespanDistribution &distribution);
+
+/// @brief Execute scheduled actions and output actual durations
+/// @param graph [in, out] scheduled actions graph, durations of executed
+/// actions are updated
+/// @param executorsNumber number of executors
+/// @param commandsPath path to file with commands of actions
+/// @param durationsOutputPath path to output graph with actual durations to,
+/// nothing is written if empty
+/// @return true if all actions succeeded
+bool executeActions(builder::Graph &graph, builder::Id executorsNumber,
+                    const std::string &commandsPath,
+                    const std::string &durationsOutputPath);
+
+/// @brief Output table of plans for numbers of executors to stdout
+/// @param sweep plans returned by sweepConcurrency()
+void outputConcurrencySweep(const builder::ConcurrencySweep &sweep);
+
+/// @brief Output statistics of replayed dispatch session to stdout
+/// @param stats statistics returned by replay_dispatch()
+void outputReplayStats(const builder::ReplayStats &stats);
+
+/// @brief Learn durations from run logs and replace durations of the graph
+/// by their estimates
+/// @param graph [in, out] loaded actions graph
+/// @param durationModelPath path to the duration model, which is created if
+/// it doesn't exist and saved if logs are given
+/// @param logPaths paths to run logs to add to the model, '-' for stdin
+/// @param executors executors of the runs loaded for the graph, or nullptr
+/// @param estimator how durations are estimated
+/// @param stats [in, out] phases of the run
+/// @param info stream to output summary to
+void updateDurations(builder::Graph &graph,
+                     const std::string &durationModelPath,
+                     const std::vector<std::string> &logPaths,
+                     const builder::Executors *executors,
+                     builder::Estimator estimator, builder::RunStats &stats,
+                     std::ostream &info);
+
+/// @brief Output memory taken by the graph, heap usage and peak resident set
+/// size of the process to stdout
+/// @param graph loaded actions graph
+void outputMemoryReport(const builder::Graph &graph);
+
 int main(int argc, char *argv[]) try {
   int32_t concurrency{10};
+  unsigned threadsNumber{0};
+  std::string placementName{"append"};
   std::string inputPath{""};
   std::string scheduledExecutionPlanOutputPath{""};
+  std::string binaryGraphOutputPath{""};
+  std::string executorsPath{""};
+  std::string replayPath{""};
+  std::string commandsPath{""};
+  std::string durationsOutputPath{""};
+  std::string concurrencySweep{""};
+  std::string schedulerName{"heft"};
+  std::string planFormatName{"tsv"};
+  std::string servePath{""};
+  std::string statsFormatName{""};
+  std::string durationModelPath{""};
+  std::vector<std::string> logPaths{};
+  std::string estimatorName{"mean"};
+  std::string cachePath{""};
+  std::vector<std::string> targetShas{};
+  uint64_t cacheBytes{uint64_t{1} << 30};
+  builder::Time maxSlack{-1};
+  size_t pathsNumber{0};
+  size_t samplesNumber{0};
   bool doOutputCriticalPath{false};
+  bool doDispatch{false};
+  bool doOutputMemoryReport{false};
 
   po::options_description desc(helpMessage);
   desc.add_options()("help,h", "produce this help message")(
@@ -61,10 +175,96 @@ int main(int argc, char *argv[]) try {
       "critical-path,p",
       po::bool_switch(&doOutputCriticalPath)->default_value(false),
       "output critical path")(
+      "slack",
+      po::value<builder::Time>(&maxSlack)->implicit_value(0),
+      "output actions whose start can be delayed by at most a given time "
+      "without delaying the end with infinite executors, 0 for critical ones")(
+      "paths,k", po::value<size_t>(&pathsNumber)->default_value(0),
+      "output a given number of the longest paths of actions")(
+      "simulate", po::value<size_t>(&samplesNumber)->default_value(0),
+      "run the plan a given number of times with durations sampled by their "
+      "deviations and output percentiles of makespan")(
       "output,o",
       po::value<std::string>(&scheduledExecutionPlanOutputPath)
           ->default_value(""),
-      "output full schedule to a given path");
+      "output full schedule to a given path")(
+      "output-format,f",
+      po::value<std::string>(&planFormatName)->default_value("tsv"),
+      "format of the full schedule: 'tsv' lines of SHA and start time, "
+      "'ndjson' lines of SHA, executor, start and end time, 'trace' events "
+      "of Chrome tracing and Perfetto")(
+      "binary-output,b",
+      po::value<std::string>(&binaryGraphOutputPath)->default_value(""),
+      "output graph with precomputed ranks in binary format to a given path, "
+      "it can be used as input instead of the text file")(
+      "placement,l",
+      po::value<std::string>(&placementName)->default_value("append"),
+      "placement of actions on executors: 'append' after the last action of "
+      "an executor, 'insertion' into the earliest idle gap of an executor")(
+      "threads,t", po::value<unsigned>(&threadsNumber)->default_value(0),
+      "number of threads to use, 0 to use all hardware threads")(
+      "executors,e", po::value<std::string>(&executorsPath)->default_value(""),
+      "executors description file path, to plan on heterogeneous executors "
+      "instead of the given number of identical ones")(
+      "dispatch,d", po::bool_switch(&doDispatch)->default_value(false),
+      "dispatch actions online on concurrency executors: read 'finished "
+      "action_sha time executor' events from stdin and write 'run "
+      "action_sha executor' decisions to stdout")(
+      "replay,r", po::value<std::string>(&replayPath)->default_value(""),
+      "replay recorded dispatch session from a given path and report "
+      "latency of handling events")(
+      "execute,x", po::value<std::string>(&commandsPath)->default_value(""),
+      "execute the plan on concurrency executors with commands of actions "
+      "from a given path, lines are 'action_sha command'")(
+      "durations-output,w",
+      po::value<std::string>(&durationsOutputPath)->default_value(""),
+      "output graph with actual durations of executed actions in "
+      "milliseconds to a given path, it can be used as input of the next "
+      "run")(
+      "concurrency-sweep,s",
+      po::value<std::string>(&concurrencySweep)->default_value(""),
+      "schedule on every number of identical executors of range "
+      "first:last:step and output makespan, utilization and critical path "
+      "ratio of each, with the knee where adding executors stops paying off")(
+      "scheduler,a",
+      po::value<std::string>(&schedulerName)->default_value("heft"),
+      "scheduling algorithm: 'heft', 'cpop', 'peft', 'lookahead' HEFT or "
+      "'best' of them by makespan")(
+      "memory-report,m",
+      po::bool_switch(&doOutputMemoryReport)->default_value(false),
+      "output memory taken by the graph, peak heap usage, number of heap "
+      "allocations and peak resident set size")(
+      "serve,S", po::value<std::string>(&servePath)->default_value(""),
+      "keep the graph in memory and answer planning requests on identical "
+      "executors on a Unix domain socket of a given path, or on stdin and "
+      "stdout for '-'")(
+      "stats",
+      po::value<std::string>(&statsFormatName)->implicit_value("text"),
+      "output wall and CPU time, graph size, heap allocations and counters "
+      "of every phase of the run as 'text' or one line of 'json'")(
+      "duration-model,M",
+      po::value<std::string>(&durationModelPath)->default_value(""),
+      "plan with durations estimated from statistics of past runs kept in a "
+      "given file, which is created if it doesn't exist")(
+      "ingest-log,L", po::value<std::vector<std::string>>(&logPaths),
+      "add records 'action_sha duration [executor]' of a run log from a "
+      "given path to the duration model, '-' for stdin, executors are of -e "
+      "if given")(
+      "estimator",
+      po::value<std::string>(&estimatorName)->default_value("mean"),
+      "estimate of durations from the duration model: 'mean', 'ewma' moving "
+      "average, 'p50' or 'p90' percentile of recent runs")(
+      "cache,C", po::value<std::string>(&cachePath)->default_value(""),
+      "keep plans in a given directory keyed by hash of the graph and "
+      "planning parameters, and take the plan from there instead of "
+      "scheduling when it's found")(
+      "cache-size",
+      po::value<uint64_t>(&cacheBytes)->default_value(cacheBytes),
+      "largest size of the plan cache in bytes, the least recently used "
+      "plans are removed")(
+      "target,T",
+      po::value<std::vector<std::string>>(&targetShas)->multitoken(),
+      "plan only given actions and actions they depend on");
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
   po::notify(vm);
@@ -79,6 +279,21 @@ int main(int argc, char *argv[]) try {
               << std::endl;
     return 0;
   }
+  builder::Placement placement{builder::Placement::Append};
+  if (placementName == "insertion") {
+    placement = builder::Placement::Insertion;
+  } else if (placementName != "append") {
+    std::cout << "Unknown placement '" << placementName
+              << "', must be 'append' or 'insertion'." << std::endl;
+    return 0;
+  }
+  const auto scheduler = builder::makeScheduler(schedulerName);
+  const auto planFormat = builder::parse_plan_format(planFormatName);
+  const auto estimator = builder::parse_estimator(estimatorName);
+  const bool doOutputStats = statsFormatName.length();
+  const auto statsFormat = doOutputStats
+                               ? builder::parse_stats_format(statsFormatName)
+                               : builder::StatsFormat::Text;
   if (inputPath.empty()) {
     std::cout << "Need input file to operate on, please read the parameter "
                  "description below:"
@@ -87,37 +302,283 @@ int main(int argc, char *argv[]) try {
     return 0;
   }
 
-  std::cout << "Run parameters: " << std::endl;
-  std::cout << "  actions input file path: '" << inputPath << "'" << std::endl;
-  std::cout << "  concurrency (numer of executors to schedule execution on): "
-            << concurrency << std::endl;
-  std::cout << "  scheduled execution plan output file path: '"
-            << scheduledExecutionPlanOutputPath << "'" << std::endl;
-  std::cout << "  do output critical path: " << std::boolalpha
-            << doOutputCriticalPath << std::endl;
-  std::cout << std::endl;
+  // Decisions of dispatching and responses of serving on stdin go to stdout,
+  // so everything else goes to stderr
+  const bool doServe = servePath.length();
+  std::ostream &info = doDispatch || doServe ? std::cerr : std::cout;
+  info << "Run parameters: " << std::endl;
+  info << "  actions input file path: '" << inputPath << "'" << std::endl;
+  info << "  concurrency (numer of executors to schedule execution on): "
+       << concurrency << std::endl;
+  info << "  scheduled execution plan output file path: '"
+       << scheduledExecutionPlanOutputPath << "'" << std::endl;
+  info << "  scheduled execution plan format: " << planFormatName
+       << std::endl;
+  info << "  do output critical path: " << std::boolalpha
+       << doOutputCriticalPath << std::endl;
+  info << "  max slack of reported actions: " << maxSlack << std::endl;
+  info << "  number of longest paths: " << pathsNumber << std::endl;
+  info << "  number of simulated runs: " << samplesNumber << std::endl;
+  info << "  binary graph output file path: '" << binaryGraphOutputPath << "'"
+       << std::endl;
+  info << "  placement of actions on executors: " << placementName << std::endl;
+  info << "  scheduler: " << schedulerName << std::endl;
+  info << "  threads number (0 for all hardware threads): " << threadsNumber
+       << std::endl;
+  info << "  executors file path: '" << executorsPath << "'" << std::endl;
+  info << "  dispatch online: " << doDispatch << std::endl;
+  info << "  dispatch session replay file path: '" << replayPath << "'"
+       << std::endl;
+  info << "  commands file path: '" << commandsPath << "'" << std::endl;
+  info << "  actual durations output file path: '" << durationsOutputPath
+       << "'" << std::endl;
+  info << "  concurrency sweep: '" << concurrencySweep << "'" << std::endl;
+  info << "  do output memory report: " << doOutputMemoryReport << std::endl;
+  info << "  serve on: '" << servePath << "'" << std::endl;
+  info << "  stats format: '" << statsFormatName << "'" << std::endl;
+  info << "  duration model file path: '" << durationModelPath << "'"
+       << std::endl;
+  for (auto &logPath : logPaths) {
+    info << "  run log file path: '" << logPath << "'" << std::endl;
+  }
+  info << "  duration estimator: " << estimatorName << std::endl;
+  info << "  plan cache directory: '" << cachePath << "'" << std::endl;
+  info << "  plan cache size: " << cacheBytes << std::endl;
+  for (auto &targetSha : targetShas) {
+    info << "  target action: '" << targetSha << "'" << std::endl;
+  }
+  info << std::endl;
+
+  // Phases are recorded in every mode, the report is output on request
+  builder::RunStats stats;
+  // Executors file is loaded with the graph, as durations are given for
+  // actions of the whole graph, not only of the targets cone
+  builder::Executors loadedExecutors;
+  // Ranks are calculated on identical executors, or left to the caller if
+  // their number is 0
+  auto loadGraph = [&](builder::Id ranksExecutorsNumber) {
+    info << "Reading input file: '" << inputPath << "'" << std::endl;
+    stats.begin("load_graph");
+    auto graph = builder::load_graph(inputPath, threadsNumber);
+    stats.end(graph);
+    if (executorsPath.length()) {
+      info << "Reading executors file: '" << executorsPath << "'"
+           << std::endl;
+      stats.begin("load_executors");
+      loadedExecutors = builder::load_executors(executorsPath, graph);
+      stats.end(graph);
+    }
+    if (targetShas.size()) {
+      stats.begin("ancestorSubgraph");
+      std::vector<builder::Id> targets;
+      for (auto &targetSha : targetShas) {
+        const builder::Id target = graph.find(targetSha);
+        if (target < 0) {
+          throw std::runtime_error("Unknown target action '" + targetSha +
+                                   "'");
+        }
+        targets.push_back(target);
+      }
+      auto subgraph = builder::ancestorSubgraph(graph, targets);
+      loadedExecutors.keepActionsOf(graph, subgraph);
+      stats.end(subgraph);
+      graph = std::move(subgraph);
+    }
+    if (durationModelPath.length()) {
+      updateDurations(graph, durationModelPath, logPaths,
+                      executorsPath.length() ? &loadedExecutors : nullptr,
+                      estimator, stats, info);
+    }
+    if (!graph.ranksCalculated && ranksExecutorsNumber > 0) {
+      stats.begin("calculateRanks");
+      builder::calculateRanks(
+          graph, builder::Executors::identical(ranksExecutorsNumber),
+          threadsNumber);
+      stats.end(graph);
+    }
+    return graph;
+  };
+  auto outputStats = [&]() {
+    stats.end();
+    if (doOutputStats) {
+      builder::save_stats(stats, statsFormat, info);
+    }
+  };
 
   const bool doOutputExecutionPlan = scheduledExecutionPlanOutputPath.length();
+  const bool doOutputBinaryGraph = binaryGraphOutputPath.length();
+  const bool doReplay = replayPath.length();
+  const bool doExecute = commandsPath.length();
+  const bool doSweep = concurrencySweep.length();
+  const bool doOutputSlack = maxSlack >= 0 || pathsNumber > 0;
+  const bool doSimulate = samplesNumber > 0;
+  const bool doUseCache = cachePath.length();
 
-  if (doOutputCriticalPath || doOutputExecutionPlan) {
-    std::cout << "Reading input file: '" << inputPath << "'" << std::endl;
+  if (doDispatch || doReplay) {
+    auto graph = loadGraph(concurrency);
+    outputStats();
+    if (doReplay) {
+      std::ifstream log(replayPath);
+      if (!log) {
+        throw std::runtime_error("Couldn't open replay file '" + replayPath +
+                                 "'");
+      }
+      outputReplayStats(builder::replay_dispatch(graph, concurrency, log));
+    } else {
+      builder::run_dispatch(graph, concurrency, std::cin, std::cout);
+    }
+    return 0;
+  }
 
-    auto actions = builder::load_actions(inputPath);
-    builder::calculateRanks(actions);
-    const auto rankShas = computeRankShas(actions);
-    schedule(2, rankShas, actions);
+  if (doServe) {
+    // Requests give only numbers of executors, speeds, durations and
+    // capacities of an executors file would be silently ignored
+    if (executorsPath.length()) {
+      throw std::runtime_error(
+          "Planning server schedules on identical executors, executors file "
+          "can't be given with --serve.");
+    }
+    // Ranks of identical executors don't depend on their number
+    builder::PlanningServer server(loadGraph(1), placement, threadsNumber);
+    outputStats();
+    if (servePath == "-") {
+      builder::run_server(server, std::cin, std::cout);
+    } else {
+      info << "Serving on '" << servePath << "'" << std::endl;
+      builder::serve_unix_socket(server, servePath);
+    }
+    return 0;
+  }
+
+  if (doSweep) {
+    // Sweep is a number of plans on identical executors, no other outputs
+    const auto executorsNumbers =
+        builder::parse_concurrency_sweep(concurrencySweep);
+    auto graph = loadGraph(1);
+    stats.begin("sweepConcurrency");
+    const auto sweep = builder::sweepConcurrency(graph, executorsNumbers,
+                                                 placement, threadsNumber);
+    stats.end(graph);
+    outputConcurrencySweep(sweep);
+    if (doOutputMemoryReport) {
+      outputMemoryReport(graph);
+    }
+    outputStats();
+    return 0;
+  }
+
+  if (doOutputCriticalPath || doOutputExecutionPlan || doOutputBinaryGraph ||
+      doExecute || doOutputSlack || doSimulate) {
+    // Binary graph keeps ranks, otherwise they are calculated when the plan
+    // is not cached
+    auto graph = loadGraph(doOutputBinaryGraph ? concurrency : 0);
+    if (doOutputBinaryGraph) {
+      std::cout << "Outputting binary graph to this file path: "
+                << binaryGraphOutputPath << std::endl;
+      stats.begin("save_binary_graph");
+      builder::save_binary_graph(graph, binaryGraphOutputPath, true);
+      stats.end(graph);
+      if (!doOutputCriticalPath && !doOutputExecutionPlan && !doExecute &&
+          !doOutputSlack && !doSimulate) {
+        outputStats();
+        return 0;
+      }
+    }
+    const auto executors = executorsPath.length()
+                               ? loadedExecutors
+                               : builder::Executors::identical(concurrency);
+    builder::PlanKey planKey;
+    builder::CriticalPath criticalPath;
+    bool isCached{false};
+    if (doUseCache) {
+      stats.begin("hashGraph");
+      planKey = builder::makePlanKey(builder::hashGraph(graph, threadsNumber),
+                                     executors, schedulerName, placement);
+      stats.end(graph);
+      stats.begin("load_cached_plan");
+      isCached =
+          builder::load_cached_plan(cachePath, planKey, graph, criticalPath);
+      stats.end(graph);
+      std::cout << "Plan " << planKey.hex()
+                << (isCached ? " is taken from the cache."
+                             : " is not in the cache.")
+                << std::endl;
+    }
+    // Precomputed ranks are made of durations on identical executors. Cached
+    // plans don't keep ranks, but execution orders ready actions by them.
+    if ((!isCached || doExecute) &&
+        (!graph.ranksCalculated || executorsPath.length())) {
+      stats.begin("calculateRanks");
+      builder::calculateRanks(graph, executors, threadsNumber);
+      stats.end(graph);
+    }
+    if (!isCached) {
+      stats.begin("schedule");
+      const auto usedScheduler =
+          scheduler->schedule(executors, graph, placement);
+      stats.end(graph);
+      if (usedScheduler != scheduler->name()) {
+        std::cout << "Plan with the shortest makespan "
+                  << builder::makespan(graph) << " is made by "
+                  << usedScheduler << std::endl;
+      }
+      stats.begin("getCriticalPath");
+      criticalPath = getCriticalPath(graph);
+      stats.end(graph);
+      if (doUseCache) {
+        stats.begin("save_cached_plan");
+        // The plan is made anyway, a cache which can't be written only slows
+        // down the next runs
+        try {
+          builder::save_cached_plan(cachePath, planKey, graph, criticalPath,
+                                    cacheBytes);
+        } catch (const std::exception &e) {
+          std::cerr << "Plan is not cached: " << e.what() << std::endl;
+        }
+        stats.end(graph);
+      }
+    }
 
     if (doOutputExecutionPlan) {
-      outputScheduledExecutionPlanToGivenPath(getExecutionPlan(actions),
+      stats.begin("save_plan");
+      outputScheduledExecutionPlanToGivenPath(graph, planFormat,
                                               scheduledExecutionPlanOutputPath);
+      stats.end(graph);
     } else {
       std::cout << "Scheduled execution plan not requested." << std::endl;
     }
     if (doOutputCriticalPath) {
-      outputCriticalPath(getCriticalPath(actions));
+      outputCriticalPath(criticalPath);
     } else {
       std::cout << "Critical path output not requested." << std::endl;
     }
+    if (doOutputSlack) {
+      stats.begin("calculateSlack");
+      const auto slack = builder::calculateSlack(graph);
+      stats.end(graph);
+      outputSlack(graph, slack, maxSlack, pathsNumber);
+    }
+    if (doSimulate) {
+      stats.begin("simulateMakespans");
+      const auto distribution = builder::simulateMakespans(
+          graph, executors, samplesNumber, 1, threadsNumber);
+      stats.end(graph);
+      outputMakespanDistribution(graph, distribution);
+    }
+    if (doExecute) {
+      stats.begin("execute");
+      const bool succeeded = executeActions(graph, executors.size(),
+                                            commandsPath, durationsOutputPath);
+      stats.end(graph);
+      if (!succeeded) {
+        outputStats();
+        return 1;
+      }
+    }
+    if (doOutputMemoryReport) {
+      outputMemoryReport(graph);
+    }
+    outputStats();
   } else {
     std::cout << "No output requested, exiting." << std::endl;
   }
@@ -131,25 +592,12 @@ int main(int argc, char *argv[]) try {
 //--- Output implementetion below ---
 
 void outputScheduledExecutionPlanToGivenPath(
-    const builder::ExecutionPlan &executionPlan,
+    const builder::Graph &graph, builder::PlanFormat format,
     std::string &scheduledExecutionPlanOutputPath) {
   std::cout << std::endl;
   std::cout << "Outputting execution plan to this file path: "
             << scheduledExecutionPlanOutputPath << std::endl;
-  std::ofstream of(scheduledExecutionPlanOutputPath,
-                   std::ofstream::out | std::ofstream::trunc);
-  if (!of) {
-    throw std::runtime_error("Couldn't open output file '" +
-                             scheduledExecutionPlanOutputPath + "'");
-  }
-  for (auto &[startTime, sha] : executionPlan) {
-    // const auto &action = actions.at(sha);
-    of << sha << "\t" << startTime << std::endl;
-    if (!of) {
-      throw std::runtime_error("Error outputting execution plan to '" +
-                               scheduledExecutionPlanOutputPath + "'");
-    }
-  }
+  builder::save_plan(graph, format, scheduledExecutionPlanOutputPath);
   std::cout << "Output of execution plan finished." << std::endl;
   std::cout << std::endl;
 }
@@ -167,4 +615,189 @@ void outputCriticalPath(const builder::CriticalPath &criticalPath) {
   }
   std::cout << "End of critical path." << std::endl;
   std::cout << std::endl;
-}
\ No newline at end of file
+}
+
+void outputSlack(const builder::Graph &graph, const builder::SlackTimes &slack,
+                 builder::Time maxSlack, size_t pathsNumber) {
+  std::cout << std::endl;
+  std::cout << "Infinite executors makespan = " << slack.length << std::endl;
+  if (maxSlack >= 0) {
+    std::cout << "Actions with slack of at most " << maxSlack
+              << ", SHA, slack, earliest and latest start, duration:"
+              << std::endl;
+    for (auto id : builder::nearCriticalActions(graph, slack, maxSlack)) {
+      std::cout << "  " << graph.shas[id] << '\t' << slack.slack(id) << '\t'
+                << slack.earliestStarts[id] << '\t' << slack.latestStarts[id]
+                << '\t' << graph.durations[id] << std::endl;
+    }
+    std::cout << "End of actions with small slack." << std::endl;
+  }
+  const auto paths = builder::longestPaths(graph, slack, pathsNumber);
+  for (size_t index = 0; index < paths.size(); ++index) {
+    std::cout << "Path " << index + 1 << " of length " << paths[index].length
+              << ", SHAs in order of execution:" << std::endl;
+    for (auto id : paths[index].ids) {
+      std::cout << "  " << graph.shas[id] << std::endl;
+    }
+  }
+  std::cout << std::endl;
+}
+
+void outputMakespanDistribution(
+    const builder::Graph &graph,
+    const builder::MakespanDistribution &distribution) {
+  const size_t actionsNumber{20};
+  std::cout << std::endl;
+  std::cout << "Simulated " << distribution.makespans.size()
+            << " runs, planned makespan = " << distribution.planned
+            << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "  mean = " << distribution.mean() << std::endl;
+  for (double fraction : {0.5, 0.9, 0.95, 0.99}) {
+    std::cout << "  p" << static_cast<int>(fraction * 100) << " = "
+              << distribution.percentile(fraction) << std::endl;
+  }
+  std::cout << "  max = " << distribution.percentile(1) << std::endl;
+  std::vector<builder::Id> ids;
+  for (builder::Id id = 0; id < graph.size(); ++id) {
+    if (distribution.criticalCounts[id] > 0) {
+      ids.push_back(id);
+    }
+  }
+  std::stable_sort(ids.begin(), ids.end(), [&](auto left, auto right) {
+    return distribution.criticalCounts[left] >
+           distribution.criticalCounts[right];
+  });
+  ids.resize(std::min(ids.size(), actionsNumber));
+  std::cout << "Actions most often on the critical path, SHA and share of "
+               "runs:"
+            << std::endl;
+  for (auto id : ids) {
+    std::cout << "  " << graph.shas[id] << '\t'
+              << 100.0 * distribution.criticalCounts[id] /
+                     distribution.makespans.size()
+              << '%' << std::endl;
+  }
+  std::cout << "End of critical actions." << std::endl;
+  std::cout.unsetf(std::ios::floatfield);
+  std::cout << std::endl;
+}
+
+void outputConcurrencySweep(const builder::ConcurrencySweep &sweep) {
+  std::cout << std::endl;
+  std::cout << std::setw(10) << "Executors" << std::setw(14) << "Makespan"
+            << std::setw(14) << "Utilization" << std::setw(10) << "CP ratio"
+            << std::endl;
+  std::cout << std::fixed;
+  for (auto &point : sweep.points) {
+    std::cout << std::setw(10) << point.executorsNumber << std::setw(14)
+              << point.makespan << std::setw(13) << std::setprecision(1)
+              << point.utilization * 100 << '%' << std::setw(10)
+              << std::setprecision(3) << point.criticalPathRatio << std::endl;
+  }
+  std::cout.unsetf(std::ios::floatfield);
+  if (sweep.knee >= 0) {
+    std::cout << "Knee, where adding executors stops paying off = "
+              << sweep.points[sweep.knee].executorsNumber << std::endl;
+    std::cout << "Fewest executors with the shortest makespan = "
+              << sweep.points[sweep.saturation].executorsNumber << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+void outputReplayStats(const builder::ReplayStats &stats) {
+  std::cout << std::endl;
+  std::cout << "Replayed events = " << stats.events << std::endl;
+  std::cout << "Replayed makespan = " << stats.makespan << std::endl;
+  std::cout << "Mean event latency, ns = "
+            << (stats.events ? stats.totalLatencyNs / stats.events : 0)
+            << std::endl;
+  std::cout << "Max event latency, ns = " << stats.maxLatencyNs << std::endl;
+  std::cout << std::endl;
+}
+
+void updateDurations(builder::Graph &graph,
+                     const std::string &durationModelPath,
+                     const std::vector<std::string> &logPaths,
+                     const builder::Executors *executors,
+                     builder::Estimator estimator, builder::RunStats &stats,
+                     std::ostream &info) {
+  builder::DurationModel model;
+  if (std::filesystem::exists(durationModelPath)) {
+    stats.begin("load_duration_model");
+    model = builder::load_duration_model(durationModelPath);
+    stats.end();
+  }
+  if (logPaths.size()) {
+    stats.begin("ingest_log");
+    // Without executors they are identical, durations need no normalizing
+    int64_t records{0};
+    for (auto &logPath : logPaths) {
+      records +=
+          logPath == "-"
+              ? builder::ingest_log(model, std::cin, executors)
+              : builder::ingest_log(model, std::filesystem::path(logPath),
+                                    executors);
+    }
+    stats.end();
+    info << "Ingested run log records = " << records << std::endl;
+    stats.begin("save_duration_model");
+    builder::save_duration_model(model, durationModelPath);
+    stats.end();
+  }
+  stats.begin("applyDurationModel");
+  const auto update = builder::applyDurationModel(graph, model, estimator);
+  stats.end(graph);
+  info << "Actions with learned durations = " << update.observed
+       << ", unseen actions = " << update.unseen
+       << ", their durations are scaled by " << update.fallbackScale
+       << std::endl;
+}
+
+void outputMemoryReport(const builder::Graph &graph) {
+  const auto heap = builder::heapUsage();
+  std::cout << std::endl;
+  std::cout << "Graph storage, bytes = " << graph.storageBytes() << " ("
+            << graph.storageBytes() / std::max<size_t>(1, graph.size())
+            << " per action)" << std::endl;
+  std::cout << "Peak heap usage, bytes = " << heap.peakBytes << std::endl;
+  std::cout << "Heap allocations = " << heap.allocations << std::endl;
+  std::cout << "Peak resident set size, bytes = "
+            << builder::peakResidentBytes() << std::endl;
+  std::cout << std::endl;
+}
+
+bool executeActions(builder::Graph &graph, builder::Id executorsNumber,
+                    const std::string &commandsPath,
+                    const std::string &durationsOutputPath) {
+  std::cout << std::endl;
+  std::cout << "Reading commands file: '" << commandsPath << "'" << std::endl;
+  const auto commands = builder::load_commands(commandsPath, graph);
+  const auto result =
+      builder::execute(graph, executorsNumber, [&](builder::Id action) {
+        return std::system(commands[action].c_str());
+      });
+  std::cout << "Execution wall time, ms = " << result.wallTime << std::endl;
+
+  // Executed actions are planned with their actual durations next time
+  for (builder::Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    if (result.durations[id] >= 0) {
+      const builder::Time maxDuration =
+          std::numeric_limits<builder::Duration>::max();
+      graph.durations[id] = static_cast<builder::Duration>(
+          std::clamp<builder::Time>(result.durations[id], 1, maxDuration));
+    }
+  }
+  if (durationsOutputPath.length()) {
+    std::cout << "Outputting actual durations to this file path: "
+              << durationsOutputPath << std::endl;
+    builder::save_graph(graph, durationsOutputPath);
+  }
+  if (result.failedAction >= 0) {
+    std::cerr << "Action " << graph.shas[result.failedAction]
+              << " failed with status " << result.failedStatus << std::endl;
+    return false;
+  }
+  std::cout << "All actions succeeded." << std::endl;
+  return true;
+}
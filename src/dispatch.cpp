@@ -0,0 +1,201 @@
+#include "dispatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace builder {
+
+namespace {
+
+std::runtime_error lineError(int64_t lineNumber, const std::string &message) {
+  return std::runtime_error("Line " + std::to_string(lineNumber) + ": " +
+                            message);
+}
+
+} // namespace
+
+Dispatcher::Dispatcher(const Graph &graph, Id executorsNumber)
+    : graph_(graph), runningOn_(graph.size(), -1) {
+  if (executorsNumber < 1) {
+    throw std::runtime_error("Number of executors must be positive, got " +
+                             std::to_string(executorsNumber));
+  }
+  remainingDependencies_.resize(graph.size());
+  for (Id id = 0; id < graph.size(); ++id) {
+    remainingDependencies_[id] = graph.dependencies.size(id);
+  }
+  // Executor 0 is the first to be used
+  for (Id executor = executorsNumber - 1; executor >= 0; --executor) {
+    idleExecutors_.push_back(executor);
+  }
+}
+
+void Dispatcher::start(std::vector<Dispatch> &decisions) {
+  // Phony Start action is finished before everything
+  for (auto dependent = graph_.dependents.begin(graph_.startId());
+       dependent != graph_.dependents.end(graph_.startId()); ++dependent) {
+    if (--remainingDependencies_[*dependent] == 0) {
+      ready_.emplace(graph_.ranks[*dependent], *dependent);
+    }
+  }
+  dispatch(decisions);
+}
+
+void Dispatcher::finished(Id action, Id executor,
+                          std::vector<Dispatch> &decisions) {
+  if (action <= graph_.startId() || action >= graph_.endId() ||
+      runningOn_[action] != executor || executor < 0) {
+    throw std::runtime_error("Action " +
+                             (action >= 0 && action < graph_.size()
+                                  ? std::string(graph_.shas[action])
+                                  : std::to_string(action)) +
+                             " is not running on executor " +
+                             std::to_string(executor));
+  }
+  runningOn_[action] = -1;
+  ++finishedNumber_;
+  idleExecutors_.push_back(executor);
+  for (auto dependent = graph_.dependents.begin(action);
+       dependent != graph_.dependents.end(action); ++dependent) {
+    if (--remainingDependencies_[*dependent] == 0 &&
+        *dependent != graph_.endId()) {
+      ready_.emplace(graph_.ranks[*dependent], *dependent);
+    }
+  }
+  dispatch(decisions);
+}
+
+void Dispatcher::dispatch(std::vector<Dispatch> &decisions) {
+  while (!ready_.empty() && !idleExecutors_.empty()) {
+    const Id action = ready_.top().second;
+    ready_.pop();
+    const Id executor = idleExecutors_.back();
+    idleExecutors_.pop_back();
+    runningOn_[action] = executor;
+    decisions.push_back(Dispatch{action, executor});
+  }
+}
+
+void run_dispatch(const Graph &graph, Id executorsNumber, std::istream &events,
+                  std::ostream &decisions) {
+  Dispatcher dispatcher(graph, executorsNumber);
+  std::vector<Dispatch> batch;
+  auto output = [&]() {
+    for (auto &[action, executor] : batch) {
+      decisions << "run " << graph.shas[action] << ' ' << executor << '\n';
+    }
+    batch.clear();
+    if (dispatcher.done()) {
+      decisions << "done\n";
+    }
+    decisions.flush();
+  };
+  dispatcher.start(batch);
+  output();
+
+  std::string s{};
+  int64_t lineNumber{0};
+  while (!dispatcher.done() && std::getline(events, s)) {
+    ++lineNumber;
+    std::istringstream line(s);
+    std::string kind, sha, rest;
+    Time time{0};
+    Id executor{-1};
+    if (!(line >> kind)) {
+      // Empty lines with only whitespaces are discarded
+      continue;
+    }
+    if (kind != "finished" || !(line >> sha >> time >> executor) ||
+        line >> rest) {
+      throw lineError(lineNumber, "Event format error, faulty input line = '" +
+                                      s + "'");
+    }
+    try {
+      dispatcher.finished(graph.at(sha), executor, batch);
+    } catch (std::exception &e) {
+      throw lineError(lineNumber, e.what());
+    }
+    output();
+  }
+}
+
+ReplayStats replay_dispatch(const Graph &graph, Id executorsNumber,
+                            std::istream &log) {
+  // Actual durations of actions recorded in the log
+  std::vector<Time> durations(graph.durations.begin(), graph.durations.end());
+  std::vector<Time> startTimes(graph.size(), 0);
+  Time lastEventTime{0};
+  std::string s{};
+  int64_t lineNumber{0};
+  while (std::getline(log, s)) {
+    ++lineNumber;
+    std::istringstream line(s);
+    std::string kind, sha;
+    if (!(line >> kind) || kind == "done") {
+      continue;
+    }
+    Time time{0};
+    Id executor{-1};
+    auto actionOf = [&](const std::string &sha) {
+      const Id action = graph.find(sha);
+      if (action < 0) {
+        throw lineError(lineNumber, "Unknown action " + sha + ".");
+      }
+      return action;
+    };
+    if (kind == "run" && line >> sha >> executor) {
+      startTimes[actionOf(sha)] = lastEventTime;
+    } else if (kind == "finished" && line >> sha >> time >> executor) {
+      const Id action = actionOf(sha);
+      if (time < startTimes[action]) {
+        throw lineError(lineNumber,
+                        "Action " + sha + " finished before it was started.");
+      }
+      durations[action] = time - startTimes[action];
+      lastEventTime = time;
+    } else {
+      throw lineError(lineNumber, "Dispatch log format error, faulty input "
+                                  "line = '" +
+                                      s + "'");
+    }
+  }
+
+  // Simulate execution with events in order of finish time
+  using Event = std::tuple<Time, Id, Id>; // finish time, action, executor
+  std::priority_queue<Event, std::vector<Event>, std::greater<>> running;
+  Dispatcher dispatcher(graph, executorsNumber);
+  std::vector<Dispatch> decisions;
+  auto startDecisions = [&](Time time) {
+    for (auto &[action, executor] : decisions) {
+      running.emplace(time + durations[action], action, executor);
+    }
+    decisions.clear();
+  };
+  dispatcher.start(decisions);
+  startDecisions(0);
+
+  ReplayStats stats;
+  while (!running.empty()) {
+    const auto [time, action, executor] = running.top();
+    running.pop();
+    const auto begin = std::chrono::steady_clock::now();
+    dispatcher.finished(action, executor, decisions);
+    const int64_t latency =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin)
+            .count();
+    ++stats.events;
+    stats.makespan = time;
+    stats.totalLatencyNs += latency;
+    stats.maxLatencyNs = std::max(stats.maxLatencyNs, latency);
+    startDecisions(time);
+  }
+  return stats;
+}
+
+} // namespace builder
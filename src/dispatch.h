@@ -0,0 +1,109 @@
+#pragma once
+
+#include "action.h"
+#include "graph.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace builder {
+
+/// @brief Decision to run action on executor
+struct Dispatch {
+  Id action{-1};   ///< Id of action to run
+  Id executor{-1}; ///< Id of executor to run it on
+};
+
+/// @brief Online dispatcher of actions driven by completion events instead of
+/// a static plan. Ready actions wait in a queue keyed by HEFT rank and are
+/// given to idle executors as soon as they appear, the executor which has
+/// just finished an action is the first to get a new one. Every event takes
+/// time proportional to dependents of the finished action and logarithmic in
+/// the number of ready actions, there's no replanning.
+class Dispatcher {
+public:
+  /// @brief Create dispatcher with all actions not started
+  /// @param graph actions graph after calculateRanks(), it must outlive the
+  /// dispatcher
+  /// @param executorsNumber number of identical executors
+  Dispatcher(const Graph &graph, Id executorsNumber);
+
+  /// @brief Decisions for actions which are ready at start
+  /// @param decisions [out] decisions are appended to it
+  void start(std::vector<Dispatch> &decisions);
+
+  /// @brief Handle completion of action and give ready actions to idle
+  /// executors, throws std::runtime_error if action isn't running on the
+  /// executor
+  /// @param action Id of finished action
+  /// @param executor Id of executor it was running on
+  /// @param decisions [out] decisions are appended to it
+  void finished(Id action, Id executor, std::vector<Dispatch> &decisions);
+
+  /// @brief True if all actions are finished
+  bool done() const { return finishedNumber_ == graph_.size() - 2; }
+
+private:
+  /// @brief Give ready actions with highest ranks to idle executors
+  void dispatch(std::vector<Dispatch> &decisions);
+
+  /// @brief Highest rank first, the earlier declared action first for equal
+  /// ranks, as in computeRankIds()
+  struct LowerRank {
+    bool operator()(const std::pair<Time, Id> &lhs,
+                    const std::pair<Time, Id> &rhs) const {
+      return lhs.first < rhs.first ||
+             (lhs.first == rhs.first && lhs.second > rhs.second);
+    }
+  };
+
+  const Graph &graph_;
+  std::vector<Id> remainingDependencies_{}; ///< unfinished dependencies
+  std::vector<Id> runningOn_{}; ///< executor of running action or -1
+  /// ready actions by rank
+  std::priority_queue<std::pair<Time, Id>, std::vector<std::pair<Time, Id>>,
+                      LowerRank>
+      ready_{};
+  std::vector<Id> idleExecutors_{}; ///< the last one is used first
+  Id finishedNumber_{0};            ///< number of finished actions
+};
+
+/// @brief Run dispatcher on text events. Every input line is an event:
+///   finished action_sha time executor
+/// and every decision is output as line:
+///   run action_sha executor
+/// Decisions for an event are flushed before the next event is read, after
+/// all actions are finished "done" line is output.
+/// @param graph actions graph after calculateRanks()
+/// @param executorsNumber number of identical executors
+/// @param events input stream of events
+/// @param decisions output stream of decisions
+void run_dispatch(const Graph &graph, Id executorsNumber, std::istream &events,
+                  std::ostream &decisions);
+
+/// @brief Statistics of replay_dispatch()
+struct ReplayStats {
+  int64_t events{0};         ///< number of handled completion events
+  Time makespan{0};          ///< time when the last action finished
+  int64_t totalLatencyNs{0}; ///< total time of handling events
+  int64_t maxLatencyNs{0};   ///< longest time of handling an event
+};
+
+/// @brief Replay recorded dispatch session on the dispatcher and measure
+/// latency of handling events. The log is the input and output of
+/// run_dispatch() interleaved in order, actual durations of actions are
+/// taken from it: an action starts at the time of the last event before
+/// its run line and ends at the time of its finished event. Actions missing
+/// in the log take their planned duration.
+/// @param graph actions graph after calculateRanks()
+/// @param executorsNumber number of identical executors
+/// @param log recorded dispatch session
+/// @return replay statistics
+ReplayStats replay_dispatch(const Graph &graph, Id executorsNumber,
+                            std::istream &log);
+
+} // namespace builder
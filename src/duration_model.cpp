@@ -0,0 +1,339 @@
+#include "duration_model.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace builder {
+
+namespace {
+
+const char signature[8] = {'B', 'L', 'D', 'D', 'U', 'R', 'M', 'D'};
+const uint32_t formatVersion{1};
+const uint64_t byteOrderMark{0x0102030405060708ull};
+const std::string_view formatName{"Duration model"};
+
+/// @brief Duration model file header, it is followed by arrays of the model,
+/// each padded to 8 bytes
+struct Header {
+  char signature[8];        ///< duration model format signature
+  uint32_t version;         ///< format version
+  uint32_t windowSize;      ///< DurationModel::windowSize of the writer
+  uint64_t byteOrder;       ///< byteOrderMark in byte order of the writer
+  int64_t actionsNumber;    ///< number of observed actions
+  int64_t shaBytesNumber;   ///< size of the SHA pool
+  int64_t indexSlotsNumber; ///< size of the SHA index
+};
+
+Duration clampDuration(double duration) {
+  return static_cast<Duration>(std::clamp<double>(
+      std::llround(duration), 1, std::numeric_limits<Duration>::max()));
+}
+
+/// @brief Speed factors of executors indexed by executor Id
+std::vector<double> executorSpeeds(const Executors &executors) {
+  std::vector<double> speeds;
+  speeds.reserve(executors.size());
+  for (auto &executorClass : executors.classes) {
+    speeds.insert(speeds.end(), executorClass.count, executorClass.speed);
+  }
+  return speeds;
+}
+
+std::runtime_error lineError(int64_t lineNumber, const std::string &message) {
+  return std::runtime_error("Line " + std::to_string(lineNumber) + ": " +
+                            message);
+}
+
+} // namespace
+
+Estimator parse_estimator(std::string_view name) {
+  if (name == "mean") {
+    return Estimator::Mean;
+  }
+  if (name == "ewma") {
+    return Estimator::Ewma;
+  }
+  if (name == "p50") {
+    return Estimator::Median;
+  }
+  if (name == "p90") {
+    return Estimator::P90;
+  }
+  throw std::runtime_error("Unknown estimator '" + std::string(name) +
+                           "', must be mean, ewma, p50 or p90.");
+}
+
+void DurationModel::observe(std::string_view sha, Time duration) {
+  const auto clamped = static_cast<Duration>(std::clamp<Time>(
+      duration, 0, std::numeric_limits<Duration>::max()));
+  Id index = find(sha);
+  if (index < 0) {
+    index = size();
+    shas.push_back(sha);
+    shaIndex.insertLast(shas);
+    counts.push_back(0);
+    means.push_back(0);
+    ewmas.push_back(clamped);
+    windows.resize(windows.size() + windowSize, 0);
+  }
+  windows[index * windowSize + counts[index] % windowSize] = clamped;
+  const int64_t count = ++counts[index];
+  means[index] += (clamped - means[index]) / count;
+  ewmas[index] += ewmaWeight * (clamped - ewmas[index]);
+}
+
+Duration DurationModel::estimate(Id index, Estimator estimator) const {
+  if (estimator == Estimator::Mean) {
+    return clampDuration(means[index]);
+  }
+  if (estimator == Estimator::Ewma) {
+    return clampDuration(ewmas[index]);
+  }
+  // Nearest rank percentile of the recent observations
+  const int64_t number = std::min(counts[index], windowSize);
+  Duration recent[windowSize];
+  std::copy_n(windows.begin() + index * windowSize, number, recent);
+  const double quantile = estimator == Estimator::Median ? 0.5 : 0.9;
+  const auto rank = static_cast<int64_t>(std::ceil(quantile * number)) - 1;
+  std::nth_element(recent, recent + rank, recent + number);
+  return clampDuration(recent[rank]);
+}
+
+Duration DurationModel::deviation(Id index) const {
+  const int64_t number = std::min(counts[index], windowSize);
+  if (number < 2) {
+    return 0;
+  }
+  const auto recent = windows.begin() + index * windowSize;
+  double mean{0};
+  for (int64_t run = 0; run < number; ++run) {
+    mean += recent[run];
+  }
+  mean /= number;
+  double squares{0};
+  for (int64_t run = 0; run < number; ++run) {
+    squares += (recent[run] - mean) * (recent[run] - mean);
+  }
+  return static_cast<Duration>(std::llround(std::sqrt(squares / (number - 1))));
+}
+
+int64_t parse_log(DurationModel &model, std::string_view text,
+                  const Executors *executors, int64_t firstLineNumber) {
+  const auto speeds =
+      executors ? executorSpeeds(*executors) : std::vector<double>{};
+  int64_t records{0};
+  int64_t lineNumber{firstLineNumber};
+  size_t i{0};
+  auto isSpace = [&]() {
+    return text[i] == ' ' || text[i] == '\t' || text[i] == '\r';
+  };
+  auto skipSpaces = [&]() {
+    while (i < text.size() && isSpace()) {
+      ++i;
+    }
+  };
+  // Number of at most 18 digits, or -1 if there are none or too many
+  auto scanNumber = [&]() -> int64_t {
+    const size_t begin = i;
+    int64_t number{0};
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+      number = number * 10 + (text[i] - '0');
+      if (i - begin == 18) {
+        return -1;
+      }
+    }
+    return i == begin ? -1 : number;
+  };
+  for (; i < text.size(); ++lineNumber) {
+    auto formatError = [&]() {
+      return lineError(lineNumber, "Log record must be 'action_sha duration "
+                                   "[executor]' with non-negative numbers.");
+    };
+    skipSpaces();
+    if (i == text.size() || text[i] == '\n') {
+      ++i;
+      continue;
+    }
+    const size_t shaBegin = i;
+    while (i < text.size() && !isSpace() && text[i] != '\n') {
+      ++i;
+    }
+    const auto sha = text.substr(shaBegin, i - shaBegin);
+    skipSpaces();
+    const int64_t duration = scanNumber();
+    if (duration < 0) {
+      throw formatError();
+    }
+    skipSpaces();
+    double speed{1};
+    if (i < text.size() && text[i] != '\n') {
+      const int64_t executor = scanNumber();
+      if (executor < 0) {
+        throw formatError();
+      }
+      if (executors) {
+        if (executor >= static_cast<int64_t>(speeds.size())) {
+          throw lineError(lineNumber, "Executor " + std::to_string(executor) +
+                                          " is not declared.");
+        }
+        speed = speeds[executor];
+      }
+      skipSpaces();
+    }
+    if (i < text.size() && text[i] != '\n') {
+      throw formatError();
+    }
+    ++i;
+    // Durations are kept as on executors of speed factor 1
+    model.observe(sha, std::llround(duration * speed));
+    ++records;
+  }
+  return records;
+}
+
+int64_t ingest_log(DurationModel &model, std::istream &fi,
+                   const Executors *executors) {
+  const size_t blockSize{size_t{1} << 20};
+  std::string buffer;
+  int64_t records{0};
+  int64_t lineNumber{1};
+  while (fi) {
+    const size_t kept = buffer.size();
+    buffer.resize(kept + blockSize);
+    fi.read(buffer.data() + kept, blockSize);
+    buffer.resize(kept + fi.gcount());
+    // Whole lines are ingested, the rest is kept for the next block
+    const size_t linesEnd = fi ? buffer.rfind('\n') + 1 : buffer.size();
+    if (linesEnd == 0) {
+      continue;
+    }
+    const std::string_view lines(buffer.data(), linesEnd);
+    records += parse_log(model, lines, executors, lineNumber);
+    lineNumber += std::count(lines.begin(), lines.end(), '\n');
+    buffer.erase(0, linesEnd);
+  }
+  return records;
+}
+
+int64_t ingest_log(DurationModel &model, const std::filesystem::path &file,
+                   const Executors *executors) {
+  MappedFile mappedFile(file);
+  return parse_log(model, mappedFile.data(), executors);
+}
+
+DurationsUpdate applyDurationModel(Graph &graph, const DurationModel &model,
+                                   Estimator estimator) {
+  DurationsUpdate update;
+  std::vector<double> ratios;
+  std::vector<Id> unseen;
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    const Id index = model.find(graph.shas[id]);
+    if (index < 0) {
+      unseen.push_back(id);
+      continue;
+    }
+    const Duration estimate = model.estimate(index, estimator);
+    ratios.push_back(static_cast<double>(estimate) / graph.durations[id]);
+    graph.durations[id] = estimate;
+    if (model.counts[index] > 1) {
+      graph.setDeviation(id, model.deviation(index));
+    }
+  }
+  if (!ratios.empty()) {
+    auto median = ratios.begin() + ratios.size() / 2;
+    std::nth_element(ratios.begin(), median, ratios.end());
+    update.fallbackScale = *median;
+  }
+  for (Id id : unseen) {
+    graph.durations[id] =
+        clampDuration(graph.durations[id] * update.fallbackScale);
+    if (graph.deviation(id) != 0) {
+      graph.setDeviation(id,
+                         clampDuration(graph.deviation(id) *
+                                       update.fallbackScale));
+    }
+  }
+  update.observed = static_cast<Id>(ratios.size());
+  update.unseen = static_cast<Id>(unseen.size());
+  graph.ranksCalculated = false;
+  return update;
+}
+
+void save_duration_model(const DurationModel &model,
+                         const std::filesystem::path &file) {
+  Header header{};
+  std::memcpy(header.signature, signature, sizeof(signature));
+  header.version = formatVersion;
+  header.windowSize = DurationModel::windowSize;
+  header.byteOrder = byteOrderMark;
+  header.actionsNumber = model.size();
+  header.shaBytesNumber = model.shas.bytes.size();
+  header.indexSlotsNumber = model.shaIndex.slots.size();
+  std::string content;
+  binary_io::appendBytes(content, &header, sizeof(header));
+  binary_io::appendArray(content, model.shas.offsets);
+  binary_io::appendBytes(content, model.shas.bytes.data(),
+                         model.shas.bytes.size());
+  binary_io::appendArray(content, model.shaIndex.slots);
+  binary_io::appendArray(content, model.counts);
+  binary_io::appendArray(content, model.means);
+  binary_io::appendArray(content, model.ewmas);
+  binary_io::appendArray(content, model.windows);
+  // Concurrent runs and crashes never leave a half written model
+  binary_io::replaceFile(file, {content}, formatName);
+}
+
+DurationModel load_duration_model(const std::filesystem::path &file) {
+  MappedFile mappedFile(file);
+  auto data = mappedFile.data();
+  if (data.size() < sizeof(Header) ||
+      std::memcmp(data.data(), signature, sizeof(signature)) != 0) {
+    throw std::runtime_error("Not a duration model file '" + file.string() +
+                             "'");
+  }
+  Header header;
+  std::memcpy(&header, binary_io::readBytes(data, sizeof(Header), formatName),
+              sizeof(Header));
+  if (header.version != formatVersion || header.byteOrder != byteOrderMark ||
+      header.windowSize != DurationModel::windowSize) {
+    throw std::runtime_error(
+        "Duration model file has unsupported version or byte order, it must "
+        "be learned from the logs again.");
+  }
+  if (header.actionsNumber < 0 ||
+      header.actionsNumber > std::numeric_limits<Id>::max()) {
+    throw std::runtime_error(
+        "Duration model file has wrong number of actions.");
+  }
+  auto read = [&](int64_t count, auto &array) {
+    binary_io::readArray(data, count, array, formatName);
+  };
+  DurationModel model;
+  read(header.actionsNumber + 1, model.shas.offsets);
+  binary_io::checkOffsets(model.shas.offsets, header.shaBytesNumber,
+                          formatName);
+  model.shas.bytes.assign(
+      binary_io::readBytes(data, header.shaBytesNumber, formatName),
+      header.shaBytesNumber);
+  read(header.indexSlotsNumber, model.shaIndex.slots);
+  binary_io::checkIndex(model.shaIndex.slots, header.actionsNumber,
+                        formatName);
+  read(header.actionsNumber, model.counts);
+  // Estimates take at least one observation of every action
+  if (std::any_of(model.counts.begin(), model.counts.end(),
+                  [](int64_t count) { return count < 1; })) {
+    throw binary_io::inconsistency(formatName, "counts");
+  }
+  read(header.actionsNumber, model.means);
+  read(header.actionsNumber, model.ewmas);
+  read(header.actionsNumber * DurationModel::windowSize, model.windows);
+  return model;
+}
+
+} // namespace builder
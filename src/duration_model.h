@@ -0,0 +1,128 @@
+#pragma once
+
+#include "action.h"
+#include "executors.h"
+#include "graph.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <string_view>
+#include <vector>
+
+namespace builder {
+
+/// @brief How a duration is estimated from observed durations of an action
+enum class Estimator {
+  Mean,   ///< mean of all observations
+  Ewma,   ///< exponentially weighted moving average, follows recent changes
+  Median, ///< median of the recent observations
+  P90     ///< 90th percentile of the recent observations, a cautious estimate
+};
+
+/// @brief Parse name of estimator
+/// @param name 'mean', 'ewma', 'p50' or 'p90'
+/// @return estimator, throws std::runtime_error on unknown name
+Estimator parse_estimator(std::string_view name);
+
+/// @brief Statistics of observed durations of actions learned from logs of
+/// runs. Actions are interned into dense indices with the same SHA pool and
+/// index as the graph, statistics are arrays indexed by them. Durations are
+/// normalized to executors of speed factor 1.
+struct DurationModel {
+  /// number of the most recent observations percentiles are taken from
+  static constexpr int64_t windowSize{16};
+  /// weight of a new observation in the moving average
+  static constexpr double ewmaWeight{0.25};
+
+  ShaPool shas{};                 ///< index to SHA of action
+  ShaIndex shaIndex{};            ///< SHA of action to index
+  std::vector<int64_t> counts{};  ///< number of observations
+  std::vector<double> means{};    ///< mean of all observations
+  std::vector<double> ewmas{};    ///< moving average of observations
+  /// ring buffers of the most recent observations, windowSize per action,
+  /// the next observation of action i goes to i * windowSize +
+  /// counts[i] % windowSize
+  std::vector<Duration> windows{};
+
+  Id size() const { return shas.size(); }
+
+  /// @brief Find index of action by SHA
+  /// @return index of action or -1 if it was never observed
+  Id find(std::string_view sha) const { return shaIndex.find(shas, sha); }
+
+  /// @brief Add observed duration of action
+  /// @param sha SHA of action, it's added if it was never observed
+  /// @param duration observed duration, clamped into the range of Duration
+  void observe(std::string_view sha, Time duration);
+
+  /// @brief Estimate duration of action
+  /// @param index index of action from find()
+  /// @param estimator how to estimate from the observations
+  /// @return estimated duration, at least 1
+  Duration estimate(Id index, Estimator estimator) const;
+
+  /// @brief Standard deviation of the recent observations of action
+  /// @param index index of action from find()
+  /// @return sample standard deviation, 0 if there are less than two
+  Duration deviation(Id index) const;
+};
+
+/// @brief Add records of a run log to the model. Every line of the log is
+/// 'action_sha duration [executor]', where executor is the Id of executor
+/// the action ran on, empty lines are skipped.
+/// @param model [in, out] model to add observations to
+/// @param text lines of the log
+/// @param executors executors of the run to normalize durations by speed
+/// factors of their classes, or nullptr if executors are identical
+/// @param firstLineNumber number of the first line in errors
+/// @return number of records added, throws std::runtime_error with the line
+/// number on a malformed line
+int64_t parse_log(DurationModel &model, std::string_view text,
+                  const Executors *executors = nullptr,
+                  int64_t firstLineNumber = 1);
+
+/// @brief Same as parse_log(), but the log is read from the stream in
+/// blocks of lines, so that logs of any size take constant memory
+int64_t ingest_log(DurationModel &model, std::istream &fi,
+                   const Executors *executors = nullptr);
+
+/// @brief Same as parse_log(), but the log file is mapped into memory
+int64_t ingest_log(DurationModel &model, const std::filesystem::path &file,
+                   const Executors *executors = nullptr);
+
+/// @brief Result of applyDurationModel()
+struct DurationsUpdate {
+  Id observed{0}; ///< actions which took their estimates
+  Id unseen{0};   ///< actions which were never observed
+  /// median ratio of estimate to duration of the input over observed
+  /// actions, durations of unseen actions are multiplied by it
+  double fallbackScale{1};
+};
+
+/// @brief Replace durations of the graph by estimates of the model, and their
+/// deviations by deviations of the recent observations. Actions which were
+/// never observed keep their input durations and deviations corrected by the
+/// typical error of input durations of observed actions. Ranks must be
+/// calculated after the update.
+/// @param graph [in, out] actions graph
+/// @param model learned statistics
+/// @param estimator how to estimate durations from the observations
+/// @return numbers of observed and unseen actions and the fallback scale
+DurationsUpdate applyDurationModel(Graph &graph, const DurationModel &model,
+                                   Estimator estimator);
+
+/// @brief Save the model in a binary format of its arrays in native byte
+/// order, the file is replaced as a whole by binary_io::replaceFile()
+/// @param model model to save
+/// @param file path to file to write to
+void save_duration_model(const DurationModel &model,
+                         const std::filesystem::path &file);
+
+/// @brief Load model saved by save_duration_model()
+/// @param file path to file to read from
+/// @return loaded model, throws std::runtime_error if the file is missing or
+/// malformed
+DurationModel load_duration_model(const std::filesystem::path &file);
+
+} // namespace builder
@@ -0,0 +1,55 @@
+#include "eft.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace builder {
+
+ExecutorChoice earliestStartExecutor(const Time *availableTimes,
+                                     Id executorsNumber, Time readyTime,
+                                     Id preferredExecutor) {
+  // Start time on executor is max(availableTime, readyTime), so the earliest
+  // start is readyTime on any executor free by then, the latest of them
+  // fits the best. Otherwise it's on the executor which gets free first.
+  // Both are found by branch-free reductions over lanes
+  const size_t size = executorsNumber;
+  const Time *available = availableTimes;
+  const size_t lanesNumber{8};
+  Time latestFree[lanesNumber];
+  Time earliestBusy[lanesNumber];
+  std::fill(latestFree, latestFree + lanesNumber, Time{-1});
+  std::fill(earliestBusy, earliestBusy + lanesNumber,
+            std::numeric_limits<Time>::max());
+  size_t i = 0;
+  for (; i + lanesNumber <= size; i += lanesNumber) {
+    for (size_t lane = 0; lane < lanesNumber; ++lane) {
+      const Time time = available[i + lane];
+      const Time free = time <= readyTime ? time : Time{-1};
+      latestFree[lane] = std::max(latestFree[lane], free);
+      earliestBusy[lane] = std::min(earliestBusy[lane], time);
+    }
+  }
+  for (; i < size; ++i) {
+    const Time free = available[i] <= readyTime ? available[i] : Time{-1};
+    latestFree[0] = std::max(latestFree[0], free);
+    earliestBusy[0] = std::min(earliestBusy[0], available[i]);
+  }
+  const Time bestFree = *std::max_element(latestFree, latestFree + lanesNumber);
+  const Time bestAvailable =
+      bestFree >= 0
+          ? bestFree
+          : *std::min_element(earliestBusy, earliestBusy + lanesNumber);
+
+  ExecutorChoice choice;
+  choice.start = std::max(bestAvailable, readyTime);
+  if (preferredExecutor >= 0 &&
+      std::max(available[preferredExecutor], readyTime) == choice.start) {
+    choice.executor = preferredExecutor;
+  } else {
+    choice.executor = static_cast<Id>(
+        std::find(available, available + size, bestAvailable) - available);
+  }
+  return choice;
+}
+
+} // namespace builder
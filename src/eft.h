@@ -0,0 +1,29 @@
+#pragma once
+
+#include "action.h"
+
+namespace builder {
+
+/// @brief Executor chosen for an action and start time of the action on it
+struct ExecutorChoice {
+  Id executor{-1}; ///< Id of the chosen executor
+  Time start{0};   ///< start time of the action on the executor
+};
+
+/// @brief Earliest Finish Time (EFT) step of HEFT for identical executors.
+/// Evaluates start time of the action on every executor and takes the
+/// earliest. Among executors with the same start time the preferred one is
+/// taken, then the one which got free the latest (to keep executors which got
+/// free earlier for other actions), then the one with the smallest Id.
+/// The scan is branch-free over a contiguous array, so compilers vectorize it.
+/// @param availableTimes times when executors get free, indexed by Id
+/// @param executorsNumber number of executors
+/// @param readyTime time when all dependencies of the action are finished
+/// @param preferredExecutor executor to keep the action on if it is not worse,
+/// e.g. the one which finished the last dependency, or -1
+/// @return chosen executor and start time of the action on it
+ExecutorChoice earliestStartExecutor(const Time *availableTimes,
+                                     Id executorsNumber, Time readyTime,
+                                     Id preferredExecutor);
+
+} // namespace builder
@@ -0,0 +1,180 @@
+#include "execution.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace builder {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Time millisecondsSince(Clock::time_point begin) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                               begin)
+      .count();
+}
+
+/// @brief Highest rank first, the earlier declared action first for equal
+/// ranks, as in computeRankIds()
+bool lowerRank(const std::pair<Time, Id> &lhs,
+               const std::pair<Time, Id> &rhs) {
+  return lhs.first < rhs.first ||
+         (lhs.first == rhs.first && lhs.second > rhs.second);
+}
+
+/// @brief Ready actions of an executor, a heap by rank
+struct ReadyQueue {
+  std::mutex mutex{};
+  std::vector<std::pair<Time, Id>> heap{};
+};
+
+/// @brief State shared by executor threads of execute()
+class Execution {
+public:
+  Execution(const Graph &graph, Id executorsNumber, const ActionRunner &run)
+      : graph_(graph), run_(run), queues_(executorsNumber),
+        remainingDependencies_(new std::atomic<Id>[graph.size()]) {
+    result_.durations.assign(graph.size(), -1);
+    result_.executorIds.assign(graph.size(), -1);
+    for (Id id = 0; id < graph.size(); ++id) {
+      remainingDependencies_[id] = graph.dependencies.size(id);
+    }
+  }
+
+  ExecutionResult run() {
+    const auto begin = Clock::now();
+    // Phony Start action is finished before everything
+    finish(graph_.startId(), 0);
+    std::vector<std::thread> executors;
+    for (Id executor = 1; executor < static_cast<Id>(queues_.size());
+         ++executor) {
+      executors.emplace_back(&Execution::work, this, executor);
+    }
+    work(0);
+    for (auto &executor : executors) {
+      executor.join();
+    }
+    result_.wallTime = millisecondsSince(begin);
+    return std::move(result_);
+  }
+
+private:
+  /// @brief Run ready actions on the executor till everything is finished
+  void work(Id executor) {
+    while (true) {
+      const Id action = take(executor);
+      if (stopped_) {
+        return;
+      }
+      if (action < 0) {
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wakeUp_.wait(lock, [&]() { return readyNumber_ > 0 || stopped_; });
+        if (stopped_) {
+          return;
+        }
+        continue;
+      }
+
+      const auto begin = Clock::now();
+      const int status = run_(action);
+      result_.durations[action] = millisecondsSince(begin);
+      result_.executorIds[action] = executor;
+      if (status != 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        if (result_.failedAction < 0) {
+          result_.failedAction = action;
+          result_.failedStatus = status;
+        }
+        stopped_ = true;
+        wakeUp_.notify_all();
+        return;
+      }
+      finish(action, executor);
+    }
+  }
+
+  /// @brief Take the highest ranked action of own queue or steal one
+  /// @return Id of action or -1 if all queues are empty
+  Id take(Id executor) {
+    const Id executorsNumber = static_cast<Id>(queues_.size());
+    for (Id i = 0; i < executorsNumber; ++i) {
+      auto &queue = queues_[(executor + i) % executorsNumber];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.heap.empty()) {
+        std::pop_heap(queue.heap.begin(), queue.heap.end(), lowerRank);
+        const Id action = queue.heap.back().second;
+        queue.heap.pop_back();
+        --readyNumber_;
+        return action;
+      }
+    }
+    return -1;
+  }
+
+  /// @brief Release dependents of the finished action
+  void finish(Id action, Id executor) {
+    for (auto dependent = graph_.dependents.begin(action);
+         dependent != graph_.dependents.end(action); ++dependent) {
+      if (--remainingDependencies_[*dependent] != 0) {
+        continue;
+      }
+      if (*dependent == graph_.endId()) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopped_ = true;
+        wakeUp_.notify_all();
+        continue;
+      }
+      const Id planned = graph_.executorIds[*dependent];
+      const bool isPlanned =
+          planned >= 0 && planned < static_cast<Id>(queues_.size());
+      auto &queue = queues_[isPlanned ? planned : executor];
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.heap.emplace_back(graph_.ranks[*dependent], *dependent);
+        std::push_heap(queue.heap.begin(), queue.heap.end(), lowerRank);
+      }
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        ++readyNumber_;
+      }
+      wakeUp_.notify_one();
+    }
+  }
+
+  const Graph &graph_;
+  const ActionRunner &run_;
+  std::vector<ReadyQueue> queues_;
+  std::unique_ptr<std::atomic<Id>[]> remainingDependencies_;
+  ExecutionResult result_{};
+
+  std::mutex sleepMutex_{};             ///< guards sleeping and stopping
+  std::condition_variable wakeUp_{};    ///< signals ready actions or stop
+  std::atomic<int64_t> readyNumber_{0}; ///< actions in all queues
+  std::atomic<bool> stopped_{false};    ///< all finished or failed
+};
+
+} // namespace
+
+ExecutionResult execute(const Graph &graph, Id executorsNumber,
+                        const ActionRunner &run) {
+  if (executorsNumber < 1) {
+    throw std::runtime_error("Number of executors must be positive, got " +
+                             std::to_string(executorsNumber));
+  }
+  if (!graph.ranksCalculated) {
+    throw std::runtime_error("Ranks must be calculated before execution.");
+  }
+  Execution execution(graph, executorsNumber, run);
+  return execution.run();
+}
+
+} // namespace builder
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "action.h"
+#include "graph.h"
+
+#include <functional>
+#include <vector>
+
+namespace builder {
+
+/// @brief Function running action with given Id, returns its exit status,
+/// which is 0 on success
+using ActionRunner = std::function<int(Id action)>;
+
+/// @brief Result of execute()
+struct ExecutionResult {
+  std::vector<Time> durations{}; ///< actual milliseconds by Id, -1 if not run
+  std::vector<Id> executorIds{}; ///< executor action ran on, -1 if not run
+  Id failedAction{-1};           ///< first failed action or -1
+  int failedStatus{0};           ///< exit status of the failed action
+  Time wallTime{0};              ///< milliseconds from start to finish
+};
+
+/// @brief Run actions of the graph on a pool of executor threads. An action
+/// becomes ready when all its dependencies finished and goes to the ready
+/// queue of the executor it was scheduled on. Every executor runs the highest
+/// ranked action of its queue, and steals the highest ranked action of
+/// another queue when its own is empty. After an action fails no more
+/// actions are started.
+/// @param graph actions graph after calculateRanks() and schedule(), actions
+/// without a valid executor are queued on executor of the action finished
+/// last
+/// @param executorsNumber number of executor threads
+/// @param run function running an action, it's called concurrently
+/// @return actual durations and executors of actions. Throws
+/// std::runtime_error if ranks of the graph aren't calculated, e.g. after
+/// its plan is loaded from the cache.
+ExecutionResult execute(const Graph &graph, Id executorsNumber,
+                        const ActionRunner &run);
+
+} // namespace builder
@@ -0,0 +1,156 @@
+#include "executors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace builder {
+
+Executors Executors::identical(Id number) {
+  Executors executors;
+  executors.addClass("default", number, 1.0);
+  return executors;
+}
+
+void Executors::addClass(std::string name, Id count, double speed,
+                         std::string_view node) {
+  if (count <= 0) {
+    throw std::runtime_error("Number of executors of class " + name +
+                             " must be positive, got " +
+                             std::to_string(count));
+  }
+  if (!(speed > 0)) {
+    throw std::runtime_error("Speed factor of executors of class " + name +
+                             " must be positive, got " + std::to_string(speed));
+  }
+  const Id nodeIndex =
+      std::find(nodes.begin(), nodes.end(), node) - nodes.begin();
+  if (nodeIndex == static_cast<Id>(nodes.size())) {
+    nodes.emplace_back(node);
+    if (hasCapacities()) {
+      capacities.emplace_back();
+    }
+  }
+  classes.push_back(
+      ExecutorClass{std::move(name), count, speed, size(), nodeIndex});
+}
+
+void Executors::setCapacity(std::string_view node, Resources capacity) {
+  const auto found = std::find(nodes.begin(), nodes.end(), node);
+  if (found == nodes.end()) {
+    throw std::runtime_error("Node " + std::string(node) +
+                             " must be declared by executors before use.");
+  }
+  if (capacity.memory < 0 || capacity.slots < 0) {
+    throw std::runtime_error("Capacity of node " + std::string(node) +
+                             " must not be negative.");
+  }
+  capacities.resize(nodes.size());
+  capacities[found - nodes.begin()] = capacity;
+}
+
+void Executors::keepActionsOf(const Graph &graph, const Graph &subgraph) {
+  // Actions keep their order in the subgraph, so overrides stay sorted
+  size_t kept{0};
+  for (auto &durationOverride : durationOverrides) {
+    const Id action = subgraph.find(graph.shas[durationOverride.action]);
+    if (action >= 0) {
+      durationOverrides[kept] = durationOverride;
+      durationOverrides[kept].action = action;
+      ++kept;
+    }
+  }
+  durationOverrides.resize(kept);
+}
+
+Id Executors::size() const {
+  return classes.empty() ? 0
+                         : classes.back().firstExecutor + classes.back().count;
+}
+
+bool Executors::isUniform() const {
+  return durationOverrides.empty() &&
+         std::all_of(classes.begin(), classes.end(),
+                     [](auto &executorClass) {
+                       return executorClass.speed == 1.0;
+                     });
+}
+
+Time Executors::cost(const Graph &graph, Id action, size_t classIndex) const {
+  if (!durationOverrides.empty()) {
+    const Id overriddenClass = static_cast<Id>(classIndex);
+    auto found = std::lower_bound(
+        durationOverrides.begin(), durationOverrides.end(),
+        std::pair(action, overriddenClass), [](auto &left, auto &right) {
+          return std::pair(left.action, left.classIndex) < right;
+        });
+    if (found != durationOverrides.end() && found->action == action &&
+        found->classIndex == overriddenClass) {
+      return found->duration;
+    }
+  }
+  const Duration duration = graph.durations[action];
+  // Scaled duration of a non-empty action never becomes zero
+  return duration == 0
+             ? 0
+             : std::max<Time>(
+                   1, std::llround(duration / classes[classIndex].speed));
+}
+
+Time Executors::averageCost(const Graph &graph, Id action) const {
+  double total{0};
+  for (size_t classIndex = 0; classIndex < classes.size(); ++classIndex) {
+    total += static_cast<double>(cost(graph, action, classIndex)) *
+             classes[classIndex].count;
+  }
+  return std::llround(total / size());
+}
+
+bool Executors::hasTransferCosts() const {
+  return intraNodeBandwidth > 0 || (interNodeBandwidth > 0 && nodes.size() > 1);
+}
+
+Time Executors::transferCost(DataSize dataSize, Id fromNode, Id toNode) const {
+  const double bandwidth =
+      fromNode == toNode ? intraNodeBandwidth : interNodeBandwidth;
+  if (dataSize == 0 || bandwidth <= 0) {
+    return 0;
+  }
+  return static_cast<Time>(std::ceil(dataSize / bandwidth));
+}
+
+double Executors::sameNodeProbability() const {
+  std::vector<Id> nodeSizes(nodes.size(), 0);
+  for (auto &executorClass : classes) {
+    nodeSizes[executorClass.node] += executorClass.count;
+  }
+  double sameNode{0};
+  for (Id nodeSize : nodeSizes) {
+    sameNode += static_cast<double>(nodeSize) * nodeSize;
+  }
+  return sameNode / (static_cast<double>(size()) * size());
+}
+
+Time Executors::averageTransferCost(DataSize dataSize, double sameNode) const {
+  if (dataSize == 0) {
+    return 0;
+  }
+  auto cost = [&](double bandwidth) {
+    return bandwidth > 0 ? std::ceil(dataSize / bandwidth) : 0.0;
+  };
+  return std::llround(sameNode * cost(intraNodeBandwidth) +
+                      (1 - sameNode) * cost(interNodeBandwidth));
+}
+
+std::vector<Id> Executors::executorNodes() const {
+  std::vector<Id> executorNodes;
+  executorNodes.reserve(size());
+  for (auto &executorClass : classes) {
+    executorNodes.insert(executorNodes.end(), executorClass.count,
+                         executorClass.node);
+  }
+  return executorNodes;
+}
+
+} // namespace builder
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "action.h"
+#include "graph.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace builder {
+
+/// @brief Class of identical executors
+struct ExecutorClass {
+  std::string name{};  ///< name of the class
+  Id count{0};         ///< number of executors of the class
+  double speed{1.0};   ///< speed factor, durations of actions are divided by it
+  Id firstExecutor{0}; ///< Id of the first executor of the class
+  Id node{0};          ///< index of the node the executors are on
+};
+
+/// @brief Duration of an action on executors of a class, which overrides the
+/// duration derived from the speed factor of the class
+struct DurationOverride {
+  Id action{0};         ///< Id of the action
+  Id classIndex{0};     ///< index of the executors class
+  Duration duration{0}; ///< duration on executors of the class
+};
+
+/// @brief Heterogeneous executors to schedule actions on.
+/// Executors of a class are identical and have consecutive Ids.
+/// Executors are grouped into nodes, outputs of an action are stored on the
+/// node it was executed on and are transferred to other executors with the
+/// intra-node or inter-node bandwidth.
+struct Executors {
+  std::vector<ExecutorClass> classes{}; ///< classes of executors
+  std::vector<std::string> nodes{};     ///< names of nodes
+  double intraNodeBandwidth{0}; ///< data size per time unit, 0 if unlimited
+  double interNodeBandwidth{0}; ///< data size per time unit, 0 if unlimited
+
+  /// Overridden durations of actions on executor classes, sorted by action
+  /// and class index with at most one per pair. Usually only a few actions
+  /// are overridden, so nothing is kept for the rest.
+  std::vector<DurationOverride> durationOverrides{};
+
+  /// Resources of nodes shared by their executors, zero amounts are
+  /// unlimited, indexed by node. Empty if every node is unlimited.
+  std::vector<Resources> capacities{};
+
+  /// @brief Create single class of executors with speed factor 1
+  /// @param number number of executors
+  static Executors identical(Id number);
+
+  /// @brief Add class of executors after already added ones
+  /// @param name name of the class
+  /// @param count number of executors, must be positive
+  /// @param speed speed factor, must be positive
+  /// @param node name of the node the executors are on, which is added if
+  /// it's new
+  void addClass(std::string name, Id count, double speed,
+                std::string_view node = "default");
+
+  /// @brief Set resources of the node, actions running on its executors at
+  /// once hold at most that much
+  /// @param node name of an added node
+  /// @param capacity memory and CPU slots of the node, zero if unlimited
+  void setCapacity(std::string_view node, Resources capacity);
+
+  /// @brief Move duration overrides to Ids of a subgraph of the graph they
+  /// were loaded for, e.g. built by ancestorSubgraph(), overrides of actions
+  /// outside of the subgraph are dropped
+  /// @param graph actions graph the overrides are given for
+  /// @param subgraph graph of some actions of graph in the same order
+  void keepActionsOf(const Graph &graph, const Graph &subgraph);
+
+  /// @brief True if some node has limited resources
+  bool hasCapacities() const { return !capacities.empty(); }
+
+  /// @brief Total number of executors
+  Id size() const;
+
+  /// @brief True if every action takes its duration on every executor
+  bool isUniform() const;
+
+  /// @brief Duration of action on executors of the class
+  /// @param graph actions graph
+  /// @param action Id of action
+  /// @param classIndex index of the executors class
+  /// @return duration from overrides or duration of action divided by speed
+  /// factor of the class, at least 1 for non-zero durations
+  Time cost(const Graph &graph, Id action, size_t classIndex) const;
+
+  /// @brief Average duration of action over all executors, as used by HEFT
+  /// ranks
+  Time averageCost(const Graph &graph, Id action) const;
+
+  /// @brief True if passing data between some executors takes time
+  bool hasTransferCosts() const;
+
+  /// @brief Time to pass data between nodes
+  /// @param dataSize size of data
+  /// @param fromNode index of node the data is on
+  /// @param toNode index of node the data is needed on
+  /// @return data size divided by bandwidth rounded up, 0 for unlimited
+  /// bandwidth
+  Time transferCost(DataSize dataSize, Id fromNode, Id toNode) const;
+
+  /// @brief Probability that two executors taken at random are on the same
+  /// node
+  double sameNodeProbability() const;
+
+  /// @brief Average time to pass data between two executors, as used by HEFT
+  /// ranks
+  /// @param dataSize size of data
+  /// @param sameNode sameNodeProbability(), which is passed to not count it
+  /// for every edge
+  Time averageTransferCost(DataSize dataSize, double sameNode) const;
+
+  /// @brief Nodes of all executors
+  /// @return vector of node indices indexed by executor Id
+  std::vector<Id> executorNodes() const;
+};
+
+} // namespace builder
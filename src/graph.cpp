@@ -0,0 +1,381 @@
+#include "graph.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace builder {
+
+uint64_t ShaIndex::hash(std::string_view sha) {
+  // Multiply-xorshift over 8 byte words, words are read in little-endian
+  // order on every platform to keep the hash stable in files
+  const uint64_t multiplier{0x9E3779B97F4A7C15ull};
+  auto readWord = [&](size_t begin, size_t end) {
+    uint64_t word{0};
+    for (size_t byte = begin; byte < end; ++byte) {
+      word |= uint64_t{static_cast<unsigned char>(sha[byte])}
+              << (8 * (byte - begin));
+    }
+    return word;
+  };
+  uint64_t h{sha.size() * multiplier};
+  size_t i = 0;
+  for (; i + 8 <= sha.size(); i += 8) {
+    h = (h ^ readWord(i, i + 8)) * multiplier;
+    h ^= h >> 29;
+  }
+  h = (h ^ readWord(i, sha.size())) * multiplier;
+  return h ^ (h >> 32);
+}
+
+Id ShaIndex::find(const ShaPool &shas, std::string_view sha) const {
+  if (slots.empty()) {
+    return -1;
+  }
+  const size_t mask = slots.size() - 1;
+  for (size_t slot = hash(sha) & mask;; slot = (slot + 1) & mask) {
+    const Id id = slots[slot];
+    if (id < 0 || shas[id] == sha) {
+      return id;
+    }
+  }
+}
+
+void ShaIndex::insertLast(const ShaPool &shas) {
+  const Id id = shas.size() - 1;
+  if (2 * static_cast<size_t>(shas.size()) > slots.size()) {
+    rehash(shas, 2 * static_cast<size_t>(shas.size()));
+    return;
+  }
+  const size_t mask = slots.size() - 1;
+  size_t slot = hash(shas[id]) & mask;
+  while (slots[slot] >= 0) {
+    slot = (slot + 1) & mask;
+  }
+  slots[slot] = id;
+}
+
+void ShaIndex::rehash(const ShaPool &shas, size_t actionsNumber) {
+  count(Counter::ShaIndexRehashes);
+  size_t capacity{16};
+  while (capacity < 2 * std::max<size_t>(actionsNumber, shas.size())) {
+    capacity *= 2;
+  }
+  slots.assign(capacity, -1);
+  const size_t mask = capacity - 1;
+  for (Id id = 0; id < shas.size(); ++id) {
+    size_t slot = hash(shas[id]) & mask;
+    while (slots[slot] >= 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = id;
+  }
+}
+
+Id Graph::at(std::string_view sha) const {
+  const Id id = find(sha);
+  if (id < 0) {
+    throw std::out_of_range("There's no action " + std::string(sha));
+  }
+  return id;
+}
+
+Id Graph::addAction(std::string_view sha, Duration duration,
+                    std::vector<Id> &actionDependencies) {
+  std::vector<DataSize> noDataSizes;
+  return addAction(sha, duration, actionDependencies, noDataSizes);
+}
+
+Id Graph::addAction(std::string_view sha, Duration duration,
+                    std::vector<Id> &actionDependencies,
+                    std::vector<DataSize> &dataSizes) {
+  if (dataSizes.empty()) {
+    std::sort(actionDependencies.begin(), actionDependencies.end());
+    actionDependencies.erase(
+        std::unique(actionDependencies.begin(), actionDependencies.end()),
+        actionDependencies.end());
+  } else {
+    // Reused by every action, so adding actions allocates nothing
+    thread_local std::vector<std::pair<Id, DataSize>> edges;
+    edges.clear();
+    for (size_t i = 0; i < actionDependencies.size(); ++i) {
+      edges.emplace_back(actionDependencies[i], dataSizes[i]);
+    }
+    // Sorted by Id and then by size, so the last of duplicates is the largest
+    std::sort(edges.begin(), edges.end());
+    actionDependencies.clear();
+    dataSizes.clear();
+    for (size_t i = 0; i < edges.size(); ++i) {
+      if (i + 1 == edges.size() || edges[i].first != edges[i + 1].first) {
+        actionDependencies.push_back(edges[i].first);
+        dataSizes.push_back(edges[i].second);
+      }
+    }
+    if (dependencies.dataSizes.empty()) {
+      dependencies.dataSizes.assign(dependencies.targets.size(), 0);
+    }
+  }
+
+  const Id id = size();
+  shas.push_back(sha);
+  shaIndex.insertLast(shas);
+  durations.push_back(duration);
+  if (!memoryDemands.empty()) {
+    memoryDemands.push_back(defaultDemand.memory);
+    slotDemands.push_back(defaultDemand.slots);
+  }
+  if (!deviations.empty()) {
+    deviations.push_back(0);
+  }
+  dependencies.targets.insert(dependencies.targets.end(),
+                              actionDependencies.begin(),
+                              actionDependencies.end());
+  if (!dependencies.dataSizes.empty()) {
+    dependencies.dataSizes.insert(dependencies.dataSizes.end(),
+                                  dataSizes.begin(), dataSizes.end());
+    dependencies.dataSizes.resize(dependencies.targets.size(), 0);
+  }
+  dependencies.offsets.push_back(dependencies.targets.size());
+  return id;
+}
+
+void Graph::setDemand(Id id, Resources demand) {
+  if (memoryDemands.empty()) {
+    if (demand.memory == defaultDemand.memory &&
+        demand.slots == defaultDemand.slots) {
+      return;
+    }
+    memoryDemands.assign(size(), defaultDemand.memory);
+    slotDemands.assign(size(), defaultDemand.slots);
+  }
+  memoryDemands[id] = demand.memory;
+  slotDemands[id] = demand.slots;
+}
+
+void Graph::setDeviation(Id id, Duration deviation) {
+  if (deviations.empty()) {
+    if (deviation == 0) {
+      return;
+    }
+    deviations.assign(size(), 0);
+  }
+  deviations[id] = deviation;
+}
+
+void Graph::finalize() {
+  // Counting sort of edges by dependency, so every dependents list is ordered
+  // by Id of the dependent action
+  dependents.offsets.assign(size() + 1, 0);
+  for (Id dependency : dependencies.targets) {
+    ++dependents.offsets[dependency + 1];
+  }
+  std::partial_sum(dependents.offsets.begin(), dependents.offsets.end(),
+                   dependents.offsets.begin());
+  dependents.targets.resize(dependencies.targets.size());
+  dependents.dataSizes.resize(dependencies.dataSizes.size());
+  std::vector<Offset> position(dependents.offsets.begin(),
+                               dependents.offsets.end() - 1);
+  for (Id node = 0; node < size(); ++node) {
+    for (Offset edge = dependencies.offsets[node];
+         edge < dependencies.offsets[node + 1]; ++edge) {
+      const Offset reverseEdge = position[dependencies.targets[edge]]++;
+      dependents.targets[reverseEdge] = node;
+      if (!dependencies.dataSizes.empty()) {
+        dependents.dataSizes[reverseEdge] = dependencies.dataSizes[edge];
+      }
+    }
+  }
+  resetSchedule();
+}
+
+void Graph::resetSchedule() {
+  ranks.assign(size(), 0);
+  startTimes.assign(size(), 0);
+  endTimes.assign(size(), 0);
+  executorIds.assign(size(), -1);
+  predecessors.assign(size(), -1);
+  longestPaths.assign(size(), 0);
+  ranksCalculated = false;
+}
+
+size_t Graph::storageBytes() const {
+  auto bytesOf = [](auto &vector) {
+    return vector.capacity() * sizeof(vector[0]);
+  };
+  auto adjacencyBytes = [&](const Adjacency &adjacency) {
+    return bytesOf(adjacency.offsets) + bytesOf(adjacency.targets) +
+           bytesOf(adjacency.dataSizes);
+  };
+  return shas.bytes.capacity() + bytesOf(shas.offsets) +
+         bytesOf(shaIndex.slots) + bytesOf(durations) +
+         bytesOf(memoryDemands) + bytesOf(slotDemands) + bytesOf(deviations) +
+         adjacencyBytes(dependencies) + adjacencyBytes(dependents) +
+         bytesOf(ranks) + bytesOf(startTimes) + bytesOf(endTimes) +
+         bytesOf(executorIds) + bytesOf(predecessors) + bytesOf(longestPaths);
+}
+
+Graph toGraph(const Actions &actions) {
+  // Kahn's algorithm: an action gets its Id after all its dependencies did
+  std::unordered_map<SHA, std::vector<const Action *>> dependentsOfSha;
+  std::unordered_map<SHA, size_t> unresolvedDependencies;
+  std::vector<const Action *> ready;
+  for (auto &[sha, action] : actions) {
+    unresolvedDependencies[sha] = action.dependencies.size();
+    if (action.dependencies.empty()) {
+      ready.push_back(&action);
+    }
+    for (auto &dependencySha : action.dependencies) {
+      dependentsOfSha[dependencySha].push_back(&action);
+    }
+  }
+
+  Graph graph;
+  std::vector<Id> dependencies;
+  while (!ready.empty()) {
+    const Action *action = ready.back();
+    ready.pop_back();
+
+    dependencies.clear();
+    for (auto &dependencySha : action->dependencies) {
+      dependencies.push_back(graph.at(dependencySha));
+    }
+    const Id id = graph.addAction(action->sha1, action->duration, dependencies);
+    graph.setDemand(id, {action->memory, action->slots});
+    graph.setDeviation(id, action->deviation);
+
+    auto dependents = dependentsOfSha.find(action->sha1);
+    if (dependents != dependentsOfSha.end()) {
+      for (auto dependent : dependents->second) {
+        if (--unresolvedDependencies.at(dependent->sha1) == 0) {
+          ready.push_back(dependent);
+        }
+      }
+    }
+  }
+
+  if (static_cast<size_t>(graph.size()) != actions.size() ||
+      graph.shas[graph.startId()] != Start.sha1 ||
+      graph.shas[graph.endId()] != End.sha1) {
+    throw std::runtime_error("Actions must form a direct acyclic graph "
+                             "between single phony Start and End actions.");
+  }
+  graph.finalize();
+  return graph;
+}
+
+Graph ancestorSubgraph(const Graph &graph, const std::vector<Id> &targets) {
+  std::vector<uint64_t> marked((graph.size() + 63) / 64, 0);
+  auto mark = [&](Id id) { marked[id / 64] |= uint64_t{1} << (id % 64); };
+  auto isMarked = [&](Id id) { return (marked[id / 64] >> (id % 64)) & 1; };
+  Id last{graph.startId()};
+  for (Id target : targets) {
+    if (target <= graph.startId() || target >= graph.endId()) {
+      throw std::runtime_error("Target must not be phony Start or End.");
+    }
+    mark(target);
+    last = std::max(last, target);
+  }
+  // Dependencies have smaller Ids than their dependents, so one sweep down
+  // from the last target marks the whole cone, words of 64 actions without
+  // marked ones are skipped at once
+  for (Id word = last / 64; word >= 0; --word) {
+    if (marked[word] == 0) {
+      continue;
+    }
+    for (Id id = std::min(last, word * 64 + 63); id >= word * 64; --id) {
+      if (isMarked(id)) {
+        for (auto dependency = graph.dependencies.begin(id);
+             dependency != graph.dependencies.end(id); ++dependency) {
+          mark(*dependency);
+        }
+      }
+    }
+  }
+  // Ids of the cone in increasing order, starting with Start, new Id of an
+  // action is its index, so nothing of the size of the graph is allocated
+  std::vector<Id> coneIds;
+  for (Id word = 0; word <= last / 64; ++word) {
+    if (marked[word] == 0) {
+      continue;
+    }
+    for (Id id = word * 64; id <= std::min(last, word * 64 + 63); ++id) {
+      if (isMarked(id)) {
+        coneIds.push_back(id);
+      }
+    }
+  }
+  const Id coneSize = static_cast<Id>(coneIds.size());
+  auto newId = [&](Id id) {
+    return static_cast<Id>(
+        std::lower_bound(coneIds.begin(), coneIds.end(), id) -
+        coneIds.begin());
+  };
+
+  const bool withDataSizes = !graph.dependencies.dataSizes.empty();
+  Graph subgraph;
+  // The cone includes Start, End is added
+  subgraph.shas.offsets.reserve(coneSize + 2);
+  subgraph.shaIndex.rehash(subgraph.shas, coneSize + 1);
+  subgraph.durations.reserve(coneSize + 1);
+  subgraph.dependencies.offsets.reserve(coneSize + 2);
+  std::vector<bool> hasDependents(coneSize, false);
+  std::vector<Id> dependencies;
+  std::vector<DataSize> dataSizes;
+  subgraph.addAction(Start.sha1, Start.duration, dependencies);
+  for (Id index = 1; index < coneSize; ++index) {
+    const Id id = coneIds[index];
+    dependencies.clear();
+    dataSizes.clear();
+    for (Offset edge = graph.dependencies.offsets[id];
+         edge < graph.dependencies.offsets[id + 1]; ++edge) {
+      const Id dependency = newId(graph.dependencies.targets[edge]);
+      hasDependents[dependency] = true;
+      dependencies.push_back(dependency);
+      if (withDataSizes) {
+        dataSizes.push_back(graph.dependencies.dataSizes[edge]);
+      }
+    }
+    subgraph.addAction(graph.shas[id], graph.durations[id], dependencies,
+                       dataSizes);
+    subgraph.setDemand(index, graph.demand(id));
+    subgraph.setDeviation(index, graph.deviation(id));
+  }
+  dependencies.clear();
+  for (Id id = subgraph.startId() + 1; id < subgraph.size(); ++id) {
+    if (!hasDependents[id]) {
+      dependencies.push_back(id);
+    }
+  }
+  subgraph.addAction(End.sha1, End.duration, dependencies);
+  subgraph.finalize();
+  return subgraph;
+}
+
+Actions toActions(const Graph &graph) {
+  Actions actions;
+  actions.reserve(graph.size());
+  for (Id id = 0; id < graph.size(); ++id) {
+    Action action{SHA(graph.shas[id]), graph.durations[id], {}};
+    action.memory = graph.demand(id).memory;
+    action.slots = graph.demand(id).slots;
+    action.deviation = graph.deviation(id);
+    for (auto dependency = graph.dependencies.begin(id);
+         dependency != graph.dependencies.end(id); ++dependency) {
+      action.dependencies.emplace(graph.shas[*dependency]);
+    }
+    action.rank = graph.ranks[id];
+    action.startTime = graph.startTimes[id];
+    action.endTime = graph.endTimes[id];
+    action.executorId = graph.executorIds[id];
+    if (graph.predecessors[id] >= 0) {
+      action.predecessor = SHA(graph.shas[graph.predecessors[id]]);
+    }
+    action.longestPath = graph.longestPaths[id];
+    actions.emplace(action.sha1, std::move(action));
+  }
+  return actions;
+}
+
+} // namespace builder
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "action.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace builder {
+
+using Offset = int64_t;
+using DataSize = int64_t;
+
+/// @brief Compressed sparse row (CSR) adjacency lists.
+/// Edges of node i are targets[offsets[i]] ... targets[offsets[i + 1] - 1]
+struct Adjacency {
+  std::vector<Offset> offsets{0}; ///< size is number of nodes + 1
+  std::vector<Id> targets{};      ///< concatenated edge lists of all nodes
+  /// size of data passed along edges, parallel to targets, empty if no edge
+  /// has data
+  std::vector<DataSize> dataSizes{};
+
+  const Id *begin(Id node) const { return targets.data() + offsets[node]; }
+  const Id *end(Id node) const { return targets.data() + offsets[node + 1]; }
+  Offset size(Id node) const { return offsets[node + 1] - offsets[node]; }
+};
+
+/// @brief Amounts of resources, which an action holds on the node of its
+/// executor while it runs, or which a node has
+struct Resources {
+  int64_t memory{0}; ///< memory, in units of the input
+  int32_t slots{0};  ///< CPU slots
+};
+
+/// @brief SHAs of actions stored back to back in a single buffer.
+/// SHA of action i is bytes[offsets[i]] ... bytes[offsets[i + 1] - 1]
+struct ShaPool {
+  std::string bytes{};            ///< concatenated SHAs of all actions
+  std::vector<Offset> offsets{0}; ///< size is number of actions + 1
+
+  Id size() const { return static_cast<Id>(offsets.size() - 1); }
+  std::string_view operator[](Id id) const {
+    return {bytes.data() + offsets[id],
+            static_cast<size_t>(offsets[id + 1] - offsets[id])};
+  }
+  void push_back(std::string_view sha) {
+    bytes.append(sha);
+    offsets.push_back(bytes.size());
+  }
+};
+
+/// @brief Open addressing hash table of Ids of actions keyed by their SHAs in
+/// a ShaPool. The hash function is fixed, so the table can be stored in files.
+struct ShaIndex {
+  std::vector<Id> slots{}; ///< Id of action or -1, size is a power of two
+
+  /// @brief Stable hash of SHA
+  static uint64_t hash(std::string_view sha);
+
+  /// @brief Find Id of action by SHA
+  /// @return Id of action or -1 if there's no such action
+  Id find(const ShaPool &shas, std::string_view sha) const;
+
+  /// @brief Add the last action of the pool to the index, the index grows to
+  /// keep load factor at most 1/2
+  void insertLast(const ShaPool &shas);
+
+  /// @brief Rebuild the index for all actions of the pool with room for
+  /// actionsNumber actions
+  void rehash(const ShaPool &shas, size_t actionsNumber);
+};
+
+/// @brief Compact actions DAG with SHAs interned into dense Ids.
+/// Node Ids are a topological order: every dependency has a smaller Id than
+/// its dependent, phony Start is always Id 0 and phony End is the last Id.
+struct Graph {
+  ShaPool shas{};                    ///< Id to SHA of action
+  ShaIndex shaIndex{};               ///< SHA of action to Id
+  std::vector<Duration> durations{}; ///< duration of action
+  Adjacency dependencies{};          ///< edges to actions depended on
+  Adjacency dependents{};            ///< reverse edges, see finalize()
+  /// memory demand of action, empty if every action has the default demand
+  std::vector<int64_t> memoryDemands{};
+  /// CPU slots demand of action, empty as memoryDemands
+  std::vector<int32_t> slotDemands{};
+  /// standard deviation of duration of action, empty if every duration is
+  /// exact
+  std::vector<Duration> deviations{};
+
+  // Heterogenious Earliest-Finish-Time (HEFT) parameters, see Action
+  std::vector<Time> ranks{};      ///< HEFT rank
+  std::vector<Time> startTimes{}; ///< HEFT scheduled start time
+  std::vector<Time> endTimes{};   ///< HEFT scheduled finish time
+  std::vector<Id> executorIds{};  ///< HEFT executor Id, -1 if not scheduled
+
+  // Critical path parameters, see Action
+  std::vector<Id> predecessors{};   ///< next node on longest path or -1
+  std::vector<Time> longestPaths{}; ///< longest path to the End action
+
+  bool ranksCalculated{false}; ///< ranks, paths and predecessors are valid
+
+  Id size() const { return shas.size(); }
+  Id startId() const { return 0; }
+  Id endId() const { return size() - 1; }
+
+  /// @brief Find Id of action by SHA
+  /// @return Id of action or -1 if there's no such action
+  Id find(std::string_view sha) const { return shaIndex.find(shas, sha); }
+
+  /// @brief Get Id of existing action by SHA
+  /// @return Id of action, throws std::out_of_range if there's no such action
+  Id at(std::string_view sha) const;
+
+  /// @brief Demand of actions which don't give one: no memory, one CPU slot
+  static constexpr Resources defaultDemand{0, 1};
+
+  /// @brief Resources the action holds while it runs
+  Resources demand(Id id) const {
+    return memoryDemands.empty()
+               ? defaultDemand
+               : Resources{memoryDemands[id], slotDemands[id]};
+  }
+
+  /// @brief Set resources the action holds while it runs, demands of all
+  /// actions are allocated when the first one differs from the default
+  void setDemand(Id id, Resources demand);
+
+  /// @brief Standard deviation of duration of the action, 0 if it's exact
+  Duration deviation(Id id) const {
+    return deviations.empty() ? 0 : deviations[id];
+  }
+
+  /// @brief Set standard deviation of duration of the action, deviations of
+  /// all actions are allocated when the first one is not zero
+  void setDeviation(Id id, Duration deviation);
+
+  /// @brief Append action to the graph, all its dependencies must be
+  /// already added. Duplicate dependencies are dropped.
+  /// @param sha SHA of the action, must not be already added
+  /// @param duration duration of the action
+  /// @param actionDependencies [in, out] Ids of dependencies, gets sorted
+  /// @return Id of the added action
+  Id addAction(std::string_view sha, Duration duration,
+               std::vector<Id> &actionDependencies);
+
+  /// @brief Same as addAction() above, but dependencies pass data of given
+  /// sizes to the action. The largest size of duplicate dependencies is kept.
+  /// @param dataSizes [in, out] sizes of data of every dependency, gets
+  /// ordered as actionDependencies, empty if dependencies pass no data
+  Id addAction(std::string_view sha, Duration duration,
+               std::vector<Id> &actionDependencies,
+               std::vector<DataSize> &dataSizes);
+
+  /// @brief Build reverse edges and allocate HEFT parameters,
+  /// must be called after the last addAction()
+  void finalize();
+
+  /// @brief Reset HEFT and critical path parameters to initial values
+  void resetSchedule();
+
+  /// @brief Heap memory held by the graph, including unused capacity
+  /// @return size in bytes
+  size_t storageBytes() const;
+};
+
+/// @brief Build graph from a map of actions, that has phony Start and End
+/// actions, e.g. returned by load_actions()
+/// @param actions map of sha to Action
+/// @return graph with topologically ordered Ids
+Graph toGraph(const Actions &actions);
+
+/// @brief Build graph of target actions and all actions they depend on,
+/// directly or not. Phony End depends on the targets which no other action of
+/// the subgraph depends on. Actions keep their order, resource demands and
+/// deviations, ranks are not calculated.
+/// @param graph actions graph
+/// @param targets Ids of target actions, throws std::runtime_error for the
+/// phony Start or End
+/// @return graph of the ancestor cone of the targets
+Graph ancestorSubgraph(const Graph &graph, const std::vector<Id> &targets);
+
+/// @brief Create map of actions from graph, including HEFT parameters
+/// @param graph graph to convert
+/// @return map of sha to Action
+Actions toActions(const Graph &graph);
+
+} // namespace builder
@@ -1,45 +1,253 @@
 #include "heft.h"
 #include "action.h"
+#include "eft.h"
+#include "idle_gaps.h"
+#include "resource_timeline.h"
+#include "stats.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 
 namespace builder {
 
-void calculateRanks(Actions &actions) {
-  // Dijkstra's wave set, start with end node
-  std::unordered_set<SHA> activeNodesSha{End.sha1};
-  std::unordered_set<SHA> nextActiveNodesSha{};
-
-  // By HEFT algorithm set rank of end node to its duration
-  // This will make all ranks +End.duration, but ordering will be the same
-  actions.at(End.sha1).rank += actions.at(End.sha1).duration;
-
-  while (!activeNodesSha.empty()) {
-    for (auto &nodeSha : activeNodesSha) {
-      auto &node{actions.at(nodeSha)};
-      for (auto &dependencySha : node.dependencies) {
-        // Rank calculation
-        nextActiveNodesSha.insert(dependencySha);
-        auto &dependencyNode{actions.at(dependencySha)};
-        dependencyNode.rank =
-            std::max(dependencyNode.rank, node.rank + dependencyNode.duration);
-
-        // Separate critical path calculation
-        const Time newLongestPath = node.longestPath + dependencyNode.duration;
-        if (dependencyNode.longestPath < newLongestPath) {
-          dependencyNode.longestPath = newLongestPath;
-          dependencyNode.predecessor = node.sha1;
+namespace {
+
+/// @brief Calculate rank, longest path and predecessor of the node from its
+/// dependents
+/// @param graph [in, out] actions graph
+/// @param node Id of the node, all its dependents must be already calculated
+/// @param cost function of action Id returning its cost
+/// @param edgeCost function of index of the edge in dependents returning its
+/// cost
+template <class Cost, class EdgeCost>
+void calculateNodeRank(Graph &graph, Id node, Cost &cost, EdgeCost &edgeCost) {
+  Time maxDependentRank{0};
+  Time maxDependentLongestPath{-1};
+  Id predecessor{-1};
+  for (Offset edge = graph.dependents.offsets[node];
+       edge < graph.dependents.offsets[node + 1]; ++edge) {
+    const Id dependent = graph.dependents.targets[edge];
+    const Time transfer = edgeCost(edge);
+    maxDependentRank =
+        std::max(maxDependentRank, graph.ranks[dependent] + transfer);
+    // Dependents are sorted by Id, the smallest Id wins on equal paths
+    if (maxDependentLongestPath < graph.longestPaths[dependent] + transfer) {
+      maxDependentLongestPath = graph.longestPaths[dependent] + transfer;
+      predecessor = dependent;
+    }
+  }
+  const Time nodeCost = cost(node);
+  graph.ranks[node] = maxDependentRank + nodeCost;
+  graph.longestPaths[node] =
+      std::max<Time>(maxDependentLongestPath, 0) + nodeCost;
+  graph.predecessors[node] = predecessor;
+}
+
+/// @brief Call function with costs of actions and edges used by ranks on the
+/// executors, as functions of action Id and index of edge in dependents
+template <class Function>
+void withRankCosts(const Graph &graph, const Executors &executors,
+                   Function function) {
+  const bool withTransfers =
+      executors.hasTransferCosts() && !graph.dependents.dataSizes.empty();
+  auto noTransfer = [](Offset) { return Time{0}; };
+  if (executors.isUniform() && !withTransfers) {
+    function([&](Id id) -> Time { return graph.durations[id]; }, noTransfer);
+    return;
+  }
+  // Average costs over all executors, as in the HEFT paper
+  auto averageCost = [&](Id id) { return executors.averageCost(graph, id); };
+  if (!withTransfers) {
+    function(averageCost, noTransfer);
+    return;
+  }
+  const double sameNode = executors.sameNodeProbability();
+  function(averageCost, [&](Offset edge) {
+    return executors.averageTransferCost(graph.dependents.dataSizes[edge],
+                                         sameNode);
+  });
+}
+
+/// @brief Reusable barrier of a fixed number of threads
+class Barrier {
+public:
+  explicit Barrier(unsigned threadsNumber) : threadsNumber_(threadsNumber) {}
+
+  /// @brief Wait until all threads call wait()
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t generation = generation_;
+    if (++waiting_ == threadsNumber_) {
+      waiting_ = 0;
+      ++generation_;
+      passed_.notify_all();
+      return;
+    }
+    passed_.wait(lock, [&]() { return generation_ != generation; });
+  }
+
+private:
+  const unsigned threadsNumber_;
+  unsigned waiting_{0};
+  uint64_t generation_{0};
+  std::mutex mutex_{};
+  std::condition_variable passed_{};
+};
+
+/// @brief Same as the loop of calculateRanks(), but nodes are calculated by
+/// levels: a node gets to the next level when the countdown of its
+/// unfinished dependents drops to zero, and nodes of a level are calculated
+/// concurrently. Every node is calculated from final values of its
+/// dependents in the same way, so results don't depend on the order.
+template <class Cost, class EdgeCost>
+void calculateRanksInParallel(Graph &graph, Cost &cost, EdgeCost &edgeCost,
+                              unsigned threadsNumber) {
+  // Levels narrower than this are calculated by one thread, waking the other
+  // threads up would take longer
+  const size_t minParallelLevel{4096};
+  const size_t chunkSize{256};
+
+  std::unique_ptr<std::atomic<Id>[]> remainingDependents(
+      new std::atomic<Id>[graph.size()]);
+  for (Id node = 0; node < graph.size(); ++node) {
+    remainingDependents[node].store(graph.dependents.size(node),
+                                    std::memory_order_relaxed);
+  }
+  // Add dependencies of the calculated node which got ready to the list.
+  // Alone a thread counts down without atomic instructions, which are much
+  // slower, other threads are waiting on the barrier then.
+  auto release = [&](Id node, std::vector<Id> &ready, bool alone) {
+    for (auto dependency = graph.dependencies.begin(node);
+         dependency != graph.dependencies.end(node); ++dependency) {
+      auto &remaining = remainingDependents[*dependency];
+      const Id left =
+          alone ? remaining.load(std::memory_order_relaxed) - 1
+                : remaining.fetch_sub(1, std::memory_order_acq_rel) - 1;
+      if (alone) {
+        remaining.store(left, std::memory_order_relaxed);
+      }
+      if (left == 0) {
+        ready.push_back(*dependency);
+      }
+    }
+  };
+
+  std::vector<Id> level;
+  std::vector<std::vector<Id>> readyOfThreads(threadsNumber);
+  std::atomic<size_t> nextChunk{0};
+  // Merge ready nodes of threads into the next level. While there are few
+  // ready nodes they are calculated by one thread from a stack, which is
+  // cheaper than going level by level.
+  auto nextLevel = [&]() {
+    level.clear();
+    for (auto &ready : readyOfThreads) {
+      level.insert(level.end(), ready.begin(), ready.end());
+      ready.clear();
+    }
+    while (!level.empty() && level.size() < minParallelLevel) {
+      const Id node = level.back();
+      level.pop_back();
+      calculateNodeRank(graph, node, cost, edgeCost);
+      release(node, level, true);
+    }
+    nextChunk = 0;
+  };
+
+  Barrier barrier(threadsNumber);
+  auto work = [&](unsigned thread) {
+    while (true) {
+      barrier.wait();
+      if (level.empty()) {
+        return;
+      }
+      for (size_t begin = nextChunk.fetch_add(chunkSize); begin < level.size();
+           begin = nextChunk.fetch_add(chunkSize)) {
+        const size_t end = std::min(begin + chunkSize, level.size());
+        for (size_t i = begin; i < end; ++i) {
+          calculateNodeRank(graph, level[i], cost, edgeCost);
+          release(level[i], readyOfThreads[thread], false);
         }
       }
+      barrier.wait();
+      if (thread == 0) {
+        nextLevel();
+      }
+    }
+  };
+
+  release(graph.endId(), readyOfThreads[0], true);
+  nextLevel();
+  std::vector<std::thread> threads;
+  for (unsigned thread = 1; thread < threadsNumber; ++thread) {
+    threads.emplace_back(work, thread);
+  }
+  work(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+} // namespace
+
+void calculateRanks(Graph &graph) {
+  calculateRanks(graph, Executors::identical(1));
+}
+
+void calculateRanks(Graph &graph, const Executors &executors,
+                    unsigned threadsNumber) {
+  if (threadsNumber == 0) {
+    threadsNumber = std::max(1u, std::thread::hardware_concurrency());
+  }
+  withRankCosts(graph, executors, [&](auto cost, auto edgeCost) {
+    // By HEFT algorithm set rank of end node to its duration
+    // This will make all ranks +End.duration, but ordering will be the same
+    graph.ranks[graph.endId()] = cost(graph.endId());
+    graph.longestPaths[graph.endId()] = 0;
+    graph.predecessors[graph.endId()] = -1;
+
+    if (threadsNumber > 1) {
+      calculateRanksInParallel(graph, cost, edgeCost, threadsNumber);
+      return;
+    }
+    // Ids are topologically ordered, so going backwards all dependents of a
+    // node are final before the node itself, and every edge is visited once
+    for (Id node = graph.endId() - 1; node >= graph.startId(); --node) {
+      calculateNodeRank(graph, node, cost, edgeCost);
     }
-    std::swap(nextActiveNodesSha, activeNodesSha);
-    nextActiveNodesSha.clear();
+  });
+  graph.ranksCalculated = true;
+}
+
+void recalculateRanks(Graph &graph, const Executors &executors,
+                      const std::vector<Id> &nodes) {
+  withRankCosts(graph, executors, [&](auto cost, auto edgeCost) {
+    for (Id node : nodes) {
+      calculateNodeRank(graph, node, cost, edgeCost);
+    }
+  });
+}
+
+void calculateRanks(Actions &actions) {
+  auto graph = toGraph(actions);
+  calculateRanks(graph);
+  for (Id id = 0; id < graph.size(); ++id) {
+    auto &action = actions.at(SHA(graph.shas[id]));
+    action.rank = graph.ranks[id];
+    action.longestPath = graph.longestPaths[id];
+    action.predecessor =
+        graph.predecessors[id] < 0 ? SHA{}
+                                   : SHA(graph.shas[graph.predecessors[id]]);
   }
 }
 
@@ -56,39 +264,592 @@ RankShas computeRankShas(const Actions &actions) {
   return rankShas;
 }
 
-void schedule(Id numberOfExecutors, const RankShas &rankShas,
-              Actions &actions) {
-  // Create set of pairs of availableTime and executorId
-  std::set<std::pair<Time, Id>> availableTimeExecutor;
-  for (Id id = 0; id < numberOfExecutors; ++id) {
-    availableTimeExecutor.emplace(0, id);
+RankIds computeRankIds(const Graph &graph) {
+  RankIds rankIds;
+  rankIds.reserve(graph.size());
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    rankIds.emplace_back(graph.ranks[id], id);
+  }
+  // Highest rank first, the earlier declared action first for equal ranks
+  std::sort(rankIds.begin(), rankIds.end(), [](auto &lhs, auto &rhs) {
+    return lhs.first > rhs.first ||
+           (lhs.first == rhs.first && lhs.second < rhs.second);
+  });
+  return rankIds;
+}
+
+namespace {
+
+/// @brief Scheduled times and executors of actions written by schedule(),
+/// either of the graph or of a separate Schedule
+struct ScheduleView {
+  Time *startTimes;
+  Time *endTimes;
+  Id *executorIds;
+};
+
+/// @brief Pinned executor of the action or -1
+Id pinnedExecutor(const PlacementHints *hints, Id id) {
+  return hints && !hints->pinnedExecutors.empty() ? hints->pinnedExecutors[id]
+                                                  : -1;
+}
+
+/// @brief Bias added to finish time of the action on the executor class
+Time classBias(const Executors &executors, const PlacementHints *hints, Id id,
+               size_t classIndex) {
+  return hints && !hints->classBiases.empty()
+             ? hints->classBiases[id * executors.classes.size() + classIndex]
+             : 0;
+}
+
+ScheduleView viewOf(Graph &graph) {
+  return {graph.startTimes.data(), graph.endTimes.data(),
+          graph.executorIds.data()};
+}
+
+/// @brief Latest finish time of dependencies of the action
+Time readyTime(const Graph &graph, const ScheduleView &scheduled, Id id) {
+  Time ready{0};
+  for (auto dependency = graph.dependencies.begin(id);
+       dependency != graph.dependencies.end(id); ++dependency) {
+    ready = std::max(scheduled.endTimes[*dependency], ready);
+  }
+  return ready;
+}
+
+/// @brief Times when the action is ready on every node, outputs of
+/// dependencies are passed from nodes they were executed on
+/// @param executorNodes nodes of executors from Executors::executorNodes()
+/// @param nodeReady [out] ready times indexed by node
+void readyTimesOnNodes(const Executors &executors,
+                       const std::vector<Id> &executorNodes,
+                       const Graph &graph, const ScheduleView &scheduled,
+                       Id id, std::vector<Time> &nodeReady) {
+  std::fill(nodeReady.begin(), nodeReady.end(), 0);
+  for (Offset edge = graph.dependencies.offsets[id];
+       edge < graph.dependencies.offsets[id + 1]; ++edge) {
+    const Id dependency = graph.dependencies.targets[edge];
+    const Id executor = scheduled.executorIds[dependency];
+    // Phony Start is not executed and has no data
+    const Id fromNode = executor < 0 ? -1 : executorNodes[executor];
+    for (Id node = 0; node < static_cast<Id>(nodeReady.size()); ++node) {
+      nodeReady[node] = std::max(
+          nodeReady[node],
+          scheduled.endTimes[dependency] +
+              (fromNode < 0 ? 0
+                            : executors.transferCost(
+                                  graph.dependencies.dataSizes[edge],
+                                  fromNode, node)));
+    }
+  }
+}
+
+/// @brief Resource timelines of nodes, empty if every node has unlimited
+/// resources
+std::vector<ResourceTimeline> nodeTimelines(const Executors &executors) {
+  std::vector<ResourceTimeline> timelines;
+  timelines.reserve(executors.capacities.size());
+  for (auto &capacity : executors.capacities) {
+    timelines.emplace_back(capacity);
+  }
+  return timelines;
+}
+
+std::runtime_error demandError(const Graph &graph, Id id) {
+  return std::runtime_error(
+      "Action " + std::string(graph.shas[id]) +
+      " demands more resources than any node it may run on has.");
+}
+
+/// @brief Insertion based HEFT: every action takes the idle gap long enough
+/// for it among all executors, where it finishes the earliest
+void scheduleWithInsertion(size_t firstPosition, const Executors &executors,
+                           const RankIds &rankIds, const Graph &graph,
+                           const ScheduleView &scheduled,
+                           const PlacementHints *hints = nullptr) {
+  const bool uniform = executors.isUniform();
+  const bool withTransfers =
+      executors.hasTransferCosts() && !graph.dependencies.dataSizes.empty();
+  const auto executorNodes = executors.executorNodes();
+  std::vector<Time> nodeReady(executors.nodes.size(), 0);
+  std::vector<IdleGaps> executorsGaps(executors.size());
+  // Executors of a class are taken into use in order of Ids, executors which
+  // were never used are all the same, so only the first of them is a candidate
+  std::vector<Id> usedExecutors(executors.classes.size(), 0);
+  auto timelines = nodeTimelines(executors);
+
+  int64_t executorScans{0};
+  // Restore executors state after the actions which are already scheduled
+  for (size_t position = 0; position < firstPosition; ++position) {
+    const Id id = rankIds[position].second;
+    const Id executor = scheduled.executorIds[id];
+    executorsGaps[executor].occupy(scheduled.startTimes[id],
+                                   scheduled.endTimes[id] -
+                                       scheduled.startTimes[id]);
+    if (!timelines.empty()) {
+      timelines[executorNodes[executor]].occupy(
+          scheduled.startTimes[id],
+          scheduled.endTimes[id] - scheduled.startTimes[id], graph.demand(id));
+    }
+    for (size_t classIndex = 0; classIndex < executors.classes.size();
+         ++classIndex) {
+      const auto &executorClass = executors.classes[classIndex];
+      if (executor >= executorClass.firstExecutor &&
+          executor < executorClass.firstExecutor + executorClass.count) {
+        usedExecutors[classIndex] =
+            std::max(usedExecutors[classIndex],
+                     executor - executorClass.firstExecutor + 1);
+      }
+    }
+  }
+
+  for (size_t position = firstPosition; position < rankIds.size();
+       ++position) {
+    const Id id = rankIds[position].second;
+    const Time commonReady = readyTime(graph, scheduled, id);
+    if (withTransfers) {
+      readyTimesOnNodes(executors, executorNodes, graph, scheduled, id,
+                        nodeReady);
+    }
+
+    const auto demand = graph.demand(id);
+    Id bestExecutor{-1};
+    size_t bestClass{0};
+    Time bestStart{0};
+    Time bestFinish{0};
+    Time bestScore{0};
+    const Id pinned = pinnedExecutor(hints, id);
+    for (size_t classIndex = 0; classIndex < executors.classes.size();
+         ++classIndex) {
+      const auto &executorClass = executors.classes[classIndex];
+      const Id first = executorClass.firstExecutor;
+      if (pinned >= 0 &&
+          (pinned < first || pinned >= first + executorClass.count)) {
+        continue;
+      }
+      const Time ready =
+          withTransfers ? nodeReady[executorClass.node] : commonReady;
+      const Time cost = uniform ? graph.durations[id]
+                                : executors.cost(graph, id, classIndex);
+      const Time bias = classBias(executors, hints, id, classIndex);
+      auto *timeline =
+          timelines.empty() ? nullptr : &timelines[executorClass.node];
+      if (timeline && !timeline->fits(demand)) {
+        continue;
+      }
+      const Id firstCandidate = pinned >= 0 ? pinned - first : 0;
+      const Id candidates =
+          pinned >= 0 ? firstCandidate + 1
+                      : std::min(usedExecutors[classIndex] + 1,
+                                 executorClass.count);
+      for (Id i = firstCandidate; i < candidates; ++i) {
+        ++executorScans;
+        const Id executor = first + i;
+        auto findStart = [&](Time time) {
+          return i < usedExecutors[classIndex]
+                     ? executorsGaps[executor].findStart(time, cost)
+                     : time;
+        };
+        Time start = findStart(ready);
+        // The executor is idle and the node has free resources from a time
+        // which both searches return
+        while (timeline) {
+          const Time free = timeline->findStart(start, cost, demand);
+          if (free == start) {
+            break;
+          }
+          start = findStart(free);
+        }
+        if (bestExecutor < 0 || start + cost + bias < bestScore) {
+          bestExecutor = executor;
+          bestClass = classIndex;
+          bestStart = start;
+          bestFinish = start + cost;
+          bestScore = bestFinish + bias;
+        }
+        if (start == ready) {
+          // Nothing in the class starts earlier than when the action is ready
+          break;
+        }
+      }
+    }
+    if (bestExecutor < 0) {
+      throw demandError(graph, id);
+    }
+    // Executors before a pinned one are counted as used, they stay empty
+    usedExecutors[bestClass] =
+        std::max(usedExecutors[bestClass],
+                 bestExecutor - executors.classes[bestClass].firstExecutor + 1);
+
+    executorsGaps[bestExecutor].occupy(bestStart, bestFinish - bestStart);
+    if (!timelines.empty()) {
+      timelines[executorNodes[bestExecutor]].occupy(
+          bestStart, bestFinish - bestStart, demand);
+    }
+    scheduled.startTimes[id] = bestStart;
+    scheduled.endTimes[id] = bestFinish;
+    scheduled.executorIds[id] = bestExecutor;
   }
+  count(Counter::ExecutorScans, executorScans);
+}
 
-  for (auto &[_, sha] : rankShas) {
-    auto &action = actions.at(sha);
-    // Select the soonest execution time based on executor availability and
-    // dependecies finish times
+/// @brief HEFT placing every action after the last action of the executor
+/// where it finishes the earliest
+void scheduleWithAppend(size_t firstPosition, const Executors &executors,
+                        const RankIds &rankIds, const Graph &graph,
+                        const ScheduleView &scheduled,
+                        const PlacementHints *hints = nullptr) {
+  const bool uniform = executors.isUniform();
+  const bool withTransfers =
+      executors.hasTransferCosts() && !graph.dependencies.dataSizes.empty();
+  const auto executorNodes = executors.executorNodes();
+  std::vector<Time> nodeReady(executors.nodes.size(), 0);
+  // Times when executors get free, contiguous for the EFT scan
+  std::vector<Time> availableTimes(executors.size(), 0);
+  auto timelines = nodeTimelines(executors);
+  for (size_t position = 0; position < firstPosition; ++position) {
+    const Id id = rankIds[position].second;
+    auto &availableTime = availableTimes[scheduled.executorIds[id]];
+    availableTime = std::max(availableTime, scheduled.endTimes[id]);
+    if (!timelines.empty()) {
+      timelines[executorNodes[scheduled.executorIds[id]]].occupy(
+          scheduled.startTimes[id],
+          scheduled.endTimes[id] - scheduled.startTimes[id], graph.demand(id));
+    }
+  }
 
-    // Find executor that gets free first and extract it from the executors set
-    auto soonestExecutionTimeAndExecutor =
-        availableTimeExecutor.extract(availableTimeExecutor.begin()).value();
+  int64_t executorScans{0};
+  int64_t dependencyStalls{0};
+  Time stallTime{0};
+  for (size_t position = firstPosition; position < rankIds.size();
+       ++position) {
+    const Id id = rankIds[position].second;
+    // Find the last finishing dependency, the action is ready after it and
+    // prefers its executor. With data transfers it is ready later on nodes
+    // which the data must be passed to.
+    if (withTransfers) {
+      readyTimesOnNodes(executors, executorNodes, graph, scheduled, id,
+                        nodeReady);
+    }
+    Time commonReady{0};
+    Id preferredExecutor{-1};
+    for (auto dependency = graph.dependencies.begin(id);
+         dependency != graph.dependencies.end(id); ++dependency) {
+      if (scheduled.endTimes[*dependency] > commonReady) {
+        commonReady = scheduled.endTimes[*dependency];
+        preferredExecutor = scheduled.executorIds[*dependency];
+      }
+    }
 
-    // Check if we need to postpone execution till last dependecy is finished
-    Time soonestExecutionTime = soonestExecutionTimeAndExecutor.first;
-    for (auto &dependencySha : action.dependencies) {
-      auto &dependencyAction = actions.at(dependencySha);
-      soonestExecutionTime =
-          std::max(dependencyAction.endTime, soonestExecutionTime);
+    // Select the soonest finish time on all executors, executors of a class
+    // are identical, so the soonest start in a class gives its soonest finish
+    const auto demand = graph.demand(id);
+    ExecutorChoice best;
+    Time bestFinish{0};
+    Time bestScore{0};
+    const Id pinned = pinnedExecutor(hints, id);
+    for (size_t classIndex = 0; classIndex < executors.classes.size();
+         ++classIndex) {
+      const auto &executorClass = executors.classes[classIndex];
+      const Id first = executorClass.firstExecutor;
+      if (pinned >= 0 &&
+          (pinned < first || pinned >= first + executorClass.count)) {
+        continue;
+      }
+      auto *timeline =
+          timelines.empty() ? nullptr : &timelines[executorClass.node];
+      if (timeline && !timeline->fits(demand)) {
+        continue;
+      }
+      const Time ready =
+          withTransfers ? nodeReady[executorClass.node] : commonReady;
+      const bool isPreferredClass =
+          preferredExecutor >= first &&
+          preferredExecutor < first + executorClass.count;
+      auto choice =
+          pinned >= 0
+              ? ExecutorChoice{pinned, std::max(ready, availableTimes[pinned])}
+              : earliestStartExecutor(
+                    availableTimes.data() + first, executorClass.count, ready,
+                    isPreferredClass ? preferredExecutor - first : -1);
+      if (pinned < 0) {
+        choice.executor += first;
+      }
+      executorScans += pinned >= 0 ? 1 : executorClass.count;
+      const Time cost =
+          uniform ? graph.durations[id] : executors.cost(graph, id, classIndex);
+      if (timeline) {
+        // A later start on an executor never finds free resources earlier,
+        // so the earliest start executor stays the best one of the class
+        choice.start = timeline->findStart(choice.start, cost, demand);
+      }
+      const Time finish = choice.start + cost;
+      const Time score = finish + classBias(executors, hints, id, classIndex);
+      if (best.executor < 0 || score < bestScore ||
+          (score == bestScore && choice.executor == preferredExecutor)) {
+        best = choice;
+        bestFinish = finish;
+        bestScore = score;
+      }
     }
 
+    if (best.executor < 0) {
+      throw demandError(graph, id);
+    }
+    if (!timelines.empty()) {
+      timelines[executorNodes[best.executor]].occupy(
+          best.start, bestFinish - best.start, demand);
+    }
+    // The executor idles if the action waits for its dependencies or for
+    // resources of the node
+    if (best.start > availableTimes[best.executor]) {
+      ++dependencyStalls;
+      stallTime += best.start - availableTimes[best.executor];
+    }
     // Write executor and start/finish times to action
-    action.startTime = soonestExecutionTime;
-    action.endTime = soonestExecutionTime + action.duration;
-    action.executorId = soonestExecutionTimeAndExecutor.second;
+    scheduled.startTimes[id] = best.start;
+    scheduled.endTimes[id] = bestFinish;
+    scheduled.executorIds[id] = best.executor;
+    availableTimes[best.executor] = bestFinish;
+  }
+  count(Counter::ExecutorScans, executorScans);
+  count(Counter::DependencyStalls, dependencyStalls);
+  count(Counter::StallTime, stallTime);
+}
+
+} // namespace
+
+void schedule(Id numberOfExecutors, const RankIds &rankIds, Graph &graph,
+              Placement placement) {
+  schedule(Executors::identical(numberOfExecutors), rankIds, graph, placement);
+}
+
+void schedule(const Executors &executors, const RankIds &rankIds, Graph &graph,
+              Placement placement) {
+  scheduleFrom(0, executors, rankIds, graph, placement);
+}
+
+void scheduleFrom(size_t firstPosition, const Executors &executors,
+                  const RankIds &rankIds, Graph &graph, Placement placement) {
+  if (placement == Placement::Insertion) {
+    scheduleWithInsertion(firstPosition, executors, rankIds, graph,
+                          viewOf(graph));
+  } else {
+    scheduleWithAppend(firstPosition, executors, rankIds, graph,
+                       viewOf(graph));
+  }
+}
+
+void schedule(const Executors &executors, const RankIds &rankIds,
+              const Graph &graph, Schedule &scheduled, Placement placement) {
+  // Only the phony Start action is read before it is scheduled
+  scheduled.startTimes.assign(graph.size(), 0);
+  scheduled.endTimes.assign(graph.size(), 0);
+  scheduled.executorIds.assign(graph.size(), -1);
+  const ScheduleView view{scheduled.startTimes.data(),
+                          scheduled.endTimes.data(),
+                          scheduled.executorIds.data()};
+  if (placement == Placement::Insertion) {
+    scheduleWithInsertion(0, executors, rankIds, graph, view);
+  } else {
+    scheduleWithAppend(0, executors, rankIds, graph, view);
+  }
+}
 
-    // Return the executor to the executors set with updated available time
-    soonestExecutionTimeAndExecutor.first = action.endTime;
-    availableTimeExecutor.insert(soonestExecutionTimeAndExecutor);
+void schedule(const Executors &executors, const RankIds &order, Graph &graph,
+              Placement placement, const PlacementHints &hints) {
+  if (placement == Placement::Insertion) {
+    scheduleWithInsertion(0, executors, order, graph, viewOf(graph), &hints);
+  } else {
+    scheduleWithAppend(0, executors, order, graph, viewOf(graph), &hints);
+  }
+}
+
+void scheduleWithLookahead(const Executors &executors, const RankIds &rankIds,
+                           Graph &graph) {
+  // Executors which finish the action the earliest tried for it
+  const size_t maxCandidates{4};
+
+  const bool uniform = executors.isUniform();
+  const bool withTransfers =
+      executors.hasTransferCosts() && !graph.dependencies.dataSizes.empty();
+  const auto executorNodes = executors.executorNodes();
+  auto cost = [&](Id id, size_t classIndex) -> Time {
+    return uniform ? graph.durations[id]
+                   : executors.cost(graph, id, classIndex);
+  };
+  const size_t classesNumber = executors.classes.size();
+  // Time from which the action is ready on executors of the class by its
+  // scheduled dependencies, id * classesNumber + class, is raised when a
+  // dependency is placed so that wide fan-ins are not walked per candidate
+  std::vector<Time> readyTimes(graph.size() * classesNumber, 0);
+  auto transferCost = [&](Offset edge, Id executor, size_t classIndex) {
+    return withTransfers
+               ? executors.transferCost(graph.dependents.dataSizes[edge],
+                                        executorNodes[executor],
+                                        executors.classes[classIndex].node)
+               : Time{0};
+  };
+
+  struct Candidate {
+    Time finish;
+    Id executor;
+    size_t classIndex;
+  };
+  std::vector<Time> availableTimes(executors.size(), 0);
+  auto timelines = nodeTimelines(executors);
+  std::vector<Time> lookaheadTimes;
+  std::vector<Candidate> candidates;
+  int64_t executorScans{0};
+  int64_t dependencyStalls{0};
+  Time stallTime{0};
+  // Dependents of the action with the edges from it
+  std::vector<std::pair<Id, Offset>> children;
+  for (auto &[_, id] : rankIds) {
+    // Children are placed in order of ranks, the phony End is not placed
+    children.clear();
+    for (Offset edge = graph.dependents.offsets[id];
+         edge < graph.dependents.offsets[id + 1]; ++edge) {
+      if (graph.dependents.targets[edge] != graph.endId()) {
+        children.emplace_back(graph.dependents.targets[edge], edge);
+      }
+    }
+    std::sort(children.begin(), children.end(), [&](auto &lhs, auto &rhs) {
+      return graph.ranks[lhs.first] > graph.ranks[rhs.first] ||
+             (graph.ranks[lhs.first] == graph.ranks[rhs.first] &&
+              lhs.first < rhs.first);
+    });
+
+    // Executors of a class which get free at the same time are the same for
+    // the action, only one of them is a candidate. Resources of nodes are
+    // kept for the action, children are placed by EFT regardless of them.
+    const auto demand = graph.demand(id);
+    candidates.clear();
+    for (size_t classIndex = 0; classIndex < classesNumber; ++classIndex) {
+      const auto &executorClass = executors.classes[classIndex];
+      auto *timeline =
+          timelines.empty() ? nullptr : &timelines[executorClass.node];
+      if (timeline && !timeline->fits(demand)) {
+        continue;
+      }
+      const Time ready = readyTimes[id * classesNumber + classIndex];
+      const Time actionCost = cost(id, classIndex);
+      const size_t classBegin = candidates.size();
+      executorScans += executorClass.count;
+      for (Id executor = executorClass.firstExecutor;
+           executor < executorClass.firstExecutor + executorClass.count;
+           ++executor) {
+        Time start = std::max(ready, availableTimes[executor]);
+        if (timeline) {
+          start = timeline->findStart(start, actionCost, demand);
+        }
+        candidates.push_back({start + actionCost, executor, classIndex});
+      }
+      std::sort(candidates.begin() + classBegin, candidates.end(),
+                [](auto &lhs, auto &rhs) {
+                  return lhs.finish < rhs.finish ||
+                         (lhs.finish == rhs.finish &&
+                          lhs.executor < rhs.executor);
+                });
+      candidates.erase(std::unique(candidates.begin() + classBegin,
+                                   candidates.end(),
+                                   [](auto &lhs, auto &rhs) {
+                                     return lhs.finish == rhs.finish;
+                                   }),
+                       candidates.end());
+    }
+    if (candidates.empty()) {
+      throw demandError(graph, id);
+    }
+    const size_t candidatesNumber = std::min(maxCandidates, candidates.size());
+    std::partial_sort(candidates.begin(),
+                      candidates.begin() + candidatesNumber, candidates.end(),
+                      [](auto &lhs, auto &rhs) {
+                        return lhs.finish < rhs.finish ||
+                               (lhs.finish == rhs.finish &&
+                                lhs.executor < rhs.executor);
+                      });
+
+    // Take the candidate after which children finish the earliest when
+    // placed by EFT, then the one finishing the action the earliest
+    size_t best{0};
+    Time bestChildrenFinish{0};
+    for (size_t index = 0; index < candidatesNumber; ++index) {
+      const auto &candidate = candidates[index];
+      lookaheadTimes = availableTimes;
+      lookaheadTimes[candidate.executor] = candidate.finish;
+      Time childrenFinish{candidate.finish};
+      for (auto [child, edge] : children) {
+        Id childExecutor{-1};
+        Time childFinish{0};
+        for (size_t classIndex = 0; classIndex < classesNumber; ++classIndex) {
+          const auto &executorClass = executors.classes[classIndex];
+          const Time ready = std::max(
+              readyTimes[child * classesNumber + classIndex],
+              candidate.finish +
+                  transferCost(edge, candidate.executor, classIndex));
+          auto choice = earliestStartExecutor(
+              lookaheadTimes.data() + executorClass.firstExecutor,
+              executorClass.count, ready, -1);
+          executorScans += executorClass.count;
+          const Time finish = choice.start + cost(child, classIndex);
+          if (childExecutor < 0 || finish < childFinish) {
+            childExecutor = executorClass.firstExecutor + choice.executor;
+            childFinish = finish;
+          }
+        }
+        lookaheadTimes[childExecutor] = childFinish;
+        childrenFinish = std::max(childrenFinish, childFinish);
+      }
+      if (index == 0 || childrenFinish < bestChildrenFinish) {
+        best = index;
+        bestChildrenFinish = childrenFinish;
+      }
+    }
+
+    const auto &chosen = candidates[best];
+    graph.startTimes[id] = chosen.finish - cost(id, chosen.classIndex);
+    if (!timelines.empty()) {
+      timelines[executorNodes[chosen.executor]].occupy(
+          graph.startTimes[id], chosen.finish - graph.startTimes[id], demand);
+    }
+    if (graph.startTimes[id] > availableTimes[chosen.executor]) {
+      ++dependencyStalls;
+      stallTime += graph.startTimes[id] - availableTimes[chosen.executor];
+    }
+    graph.endTimes[id] = chosen.finish;
+    graph.executorIds[id] = chosen.executor;
+    availableTimes[chosen.executor] = chosen.finish;
+    for (Offset edge = graph.dependents.offsets[id];
+         edge < graph.dependents.offsets[id + 1]; ++edge) {
+      const Id dependent = graph.dependents.targets[edge];
+      for (size_t classIndex = 0; classIndex < classesNumber; ++classIndex) {
+        auto &ready = readyTimes[dependent * classesNumber + classIndex];
+        ready = std::max(ready, chosen.finish + transferCost(edge,
+                                                             chosen.executor,
+                                                             classIndex));
+      }
+    }
+  }
+  count(Counter::ExecutorScans, executorScans);
+  count(Counter::DependencyStalls, dependencyStalls);
+  count(Counter::StallTime, stallTime);
+}
+
+void schedule(Id numberOfExecutors, const RankShas &rankShas,
+              Actions &actions) {
+  auto graph = toGraph(actions);
+  RankIds rankIds;
+  rankIds.reserve(rankShas.size());
+  for (auto &[rank, sha] : rankShas) {
+    rankIds.emplace_back(rank, graph.at(sha));
+  }
+  schedule(numberOfExecutors, rankIds, graph);
+  for (auto &[_, id] : rankIds) {
+    auto &action = actions.at(SHA(graph.shas[id]));
+    action.startTime = graph.startTimes[id];
+    action.endTime = graph.endTimes[id];
+    action.executorId = graph.executorIds[id];
   }
 }
 
@@ -103,6 +864,85 @@ ExecutionPlan getExecutionPlan(const Actions &actions) {
   return plan;
 }
 
+namespace {
+
+/// @brief Ids of actions by non-decreasing start times, then by Ids
+std::vector<Id> executionOrder(const Graph &graph,
+                               const std::vector<Time> &startTimes) {
+  std::vector<Id> order;
+  order.reserve(graph.size());
+  Time maxStartTime{0};
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    maxStartTime = std::max(maxStartTime, startTimes[id]);
+  }
+  if (maxStartTime >= (Time{1} << 32)) {
+    std::vector<std::pair<Time, Id>> timeIds;
+    timeIds.reserve(graph.size());
+    for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+      timeIds.emplace_back(startTimes[id], id);
+    }
+    std::sort(timeIds.begin(), timeIds.end());
+    for (auto &[_, id] : timeIds) {
+      order.push_back(id);
+    }
+    return order;
+  }
+
+  // Start time and Id packed into one word are sorted by LSD radix sort on
+  // digits of the start time only, the sort is stable and keys are filled
+  // in order of Ids, so equal start times stay ordered by Id
+  const int digitBits{11};
+  const size_t digitsNumber{size_t{1} << digitBits};
+  std::vector<uint64_t> keys, sorted;
+  keys.reserve(graph.size());
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    keys.push_back(static_cast<uint64_t>(startTimes[id]) << 32 |
+                   static_cast<uint32_t>(id));
+  }
+  sorted.resize(keys.size());
+  std::vector<size_t> counts(digitsNumber);
+  for (int shift = 32; (maxStartTime >> (shift - 32)) > 0;
+       shift += digitBits) {
+    std::fill(counts.begin(), counts.end(), 0);
+    for (auto key : keys) {
+      ++counts[(key >> shift) & (digitsNumber - 1)];
+    }
+    size_t position{0};
+    for (auto &count : counts) {
+      position += std::exchange(count, position);
+    }
+    for (auto key : keys) {
+      sorted[counts[(key >> shift) & (digitsNumber - 1)]++] = key;
+    }
+    keys.swap(sorted);
+  }
+  for (auto key : keys) {
+    order.push_back(static_cast<Id>(key & 0xFFFFFFFFu));
+  }
+  return order;
+}
+
+} // namespace
+
+std::vector<Id> getExecutionOrder(const Graph &graph) {
+  return executionOrder(graph, graph.startTimes);
+}
+
+std::vector<Id> getExecutionOrder(const Graph &graph,
+                                  const Schedule &scheduled) {
+  return executionOrder(graph, scheduled.startTimes);
+}
+
+ExecutionPlan getExecutionPlan(const Graph &graph) {
+  // SHAs are only materialized for the output
+  ExecutionPlan plan;
+  plan.reserve(graph.size());
+  for (Id id : getExecutionOrder(graph)) {
+    plan.emplace_back(graph.startTimes[id], graph.shas[id]);
+  }
+  return plan;
+}
+
 CriticalPath getCriticalPath(const Actions &actions) {
   CriticalPath path;
   // Start with the phony Start action and follow the predecessor
@@ -123,4 +963,22 @@ CriticalPath getCriticalPath(const Actions &actions) {
   return path;
 }
 
+CriticalPath getCriticalPath(const Graph &graph) {
+  CriticalPath path;
+  // Longest path from the first action to the End, it is made of costs the
+  // ranks were calculated with
+  path.infiniteExecutorsLength =
+      graph.longestPaths[graph.predecessors[graph.startId()]];
+  // Start with the phony Start action and follow the predecessor
+  // till the phony End action
+  Id lastId = graph.startId();
+  for (Id id = graph.predecessors[graph.startId()]; id != graph.endId();
+       id = graph.predecessors[id]) {
+    path.actionsShas.emplace_back(graph.shas[id]);
+    lastId = id;
+  }
+  path.actualExecutorsLength = graph.endTimes[lastId];
+  return path;
+}
+
 } // namespace builder
\ No newline at end of file
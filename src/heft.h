@@ -1,6 +1,8 @@
 #pragma once
 
 #include "action.h"
+#include "executors.h"
+#include "graph.h"
 
 #include <algorithm>
 #include <functional>
@@ -17,7 +19,35 @@ namespace builder {
 /// function
 void calculateRanks(Actions &actions);
 
+/// @brief For every node of the graph find the HEFT upper rank and the
+/// longest path to the End action in a single pass over the reverse
+/// topological order of Ids, on equal paths the predecessor is the dependent
+/// with the smallest Id
+/// @param graph [in, out] actions graph, which is updated by this function
+void calculateRanks(Graph &graph);
+
+/// @brief Same as calculateRanks(Graph &), but for heterogeneous executors
+/// cost of action is its average duration over all executors. With more than
+/// one thread nodes are calculated by topological levels concurrently, the
+/// results are the same as of one thread.
+/// @param graph [in, out] actions graph, which is updated by this function
+/// @param executors [in] executors actions are going to be scheduled on
+/// @param threadsNumber number of threads to calculate with, 0 for all
+/// hardware threads
+void calculateRanks(Graph &graph, const Executors &executors,
+                    unsigned threadsNumber = 1);
+
+/// @brief Recalculate ranks, longest paths and predecessors of given nodes
+/// only, e.g. after their dependents or durations changed
+/// @param graph [in, out] actions graph after calculateRanks()
+/// @param executors [in] executors the ranks were calculated for
+/// @param nodes [in] Ids of nodes in decreasing order, dependents of every
+/// node must be either up to date or listed before it
+void recalculateRanks(Graph &graph, const Executors &executors,
+                      const std::vector<Id> &nodes);
+
 using RankShas = std::vector<std::pair<builder::Time, SHA>>;
+using RankIds = std::vector<std::pair<builder::Time, Id>>;
 
 /// @brief Create vector of shas and ranks and sort it in non-increasing order
 /// of HEFT ranks
@@ -25,6 +55,12 @@ using RankShas = std::vector<std::pair<builder::Time, SHA>>;
 /// @return vector of pair<rank, sha> sorted in non-derceasing order
 RankShas computeRankShas(const Actions &actions);
 
+/// @brief Create vector of Ids and ranks sorted in non-increasing order of HEFT
+/// ranks, actions with equal ranks are ordered by Id
+/// @param graph [in] actions graph after calculateRanks()
+/// @return vector of pair<rank, Id> without phony Start and End actions
+RankIds computeRankIds(const Graph &graph);
+
 /// @brief Simplified HEFT algorithms for tasks planning
 /// @param numberOfExecutors [in] number of identical executors to plan
 /// execution on
@@ -33,6 +69,89 @@ RankShas computeRankShas(const Actions &actions);
 /// @param actions [in, out] map of sha to Action
 void schedule(Id numberOfExecutors, const RankShas &rankShas, Actions &actions);
 
+/// @brief How actions are placed on executors by schedule()
+enum class Placement {
+  Append,   ///< after the last action of the executor with earliest finish
+  Insertion ///< into the earliest idle gap of any executor, as in HEFT paper
+};
+
+/// @brief Simplified HEFT algorithms for tasks planning on graph
+/// @param numberOfExecutors [in] number of identical executors to plan
+/// execution on
+/// @param rankIds [in] vector of pair<rank, Id> from computeRankIds()
+/// @param graph [in, out] actions graph
+/// @param placement [in] how actions are placed on executors
+void schedule(Id numberOfExecutors, const RankIds &rankIds, Graph &graph,
+              Placement placement = Placement::Append);
+
+/// @brief HEFT algorithm for tasks planning on heterogeneous executors, every
+/// action is placed where it finishes the earliest according to its duration
+/// on each executor. Demands of actions running at once on a node are kept
+/// within capacities of the node, std::runtime_error is thrown if an action
+/// does not fit into any node it may run on.
+/// @param executors [in] executors to plan execution on
+/// @param rankIds [in] vector of pair<rank, Id> from computeRankIds()
+/// @param graph [in, out] actions graph
+/// @param placement [in] how actions are placed on executors
+void schedule(const Executors &executors, const RankIds &rankIds, Graph &graph,
+              Placement placement = Placement::Append);
+
+/// @brief Same as schedule() above, but actions before firstPosition of
+/// rankIds are kept as they are, e.g. when only later actions changed
+/// @param firstPosition position in rankIds of the first action to schedule,
+/// actions before it must be scheduled by schedule() with the same executors
+/// and placement
+void scheduleFrom(size_t firstPosition, const Executors &executors,
+                  const RankIds &rankIds, Graph &graph,
+                  Placement placement = Placement::Append);
+
+/// @brief Scheduled times and executors of actions indexed by Id, kept apart
+/// from the graph, e.g. to schedule one graph concurrently
+struct Schedule {
+  std::vector<Time> startTimes{}; ///< scheduled start time
+  std::vector<Time> endTimes{};   ///< scheduled finish time
+  std::vector<Id> executorIds{};  ///< executor Id, -1 if not scheduled
+};
+
+/// @brief Same as schedule() above, but times and executors are written to
+/// the given schedule instead of the graph
+/// @param scheduled [out] schedule of actions, vectors are resized to the
+/// size of the graph
+void schedule(const Executors &executors, const RankIds &rankIds,
+              const Graph &graph, Schedule &scheduled,
+              Placement placement = Placement::Append);
+
+/// @brief Constraints and preferences of placing actions on executors, which
+/// list schedulers other than HEFT add to the EFT placement
+struct PlacementHints {
+  /// executor every action must be placed on, or -1, indexed by Id, empty if
+  /// no action is pinned
+  std::vector<Id> pinnedExecutors{};
+  /// time added to finish time of action on executors of a class when
+  /// executors are compared, indexed by action Id * classes.size() + class
+  /// index, empty if there are no biases
+  std::vector<Time> classBiases{};
+};
+
+/// @brief Same as schedule() above, but actions are taken in the given order
+/// and placed according to hints
+/// @param order pairs of priority and Id of actions in order of scheduling,
+/// every action must come after its dependencies
+/// @param hints pinned executors and biases of executor classes
+void schedule(const Executors &executors, const RankIds &order, Graph &graph,
+              Placement placement, const PlacementHints &hints);
+
+/// @brief One-step lookahead HEFT: for every action a few executors where it
+/// finishes the earliest are tried, and the action is placed where its
+/// children finish the earliest when placed after it by EFT. Children are
+/// not waiting for their dependencies which aren't scheduled yet. Actions are
+/// appended to executors.
+/// @param executors [in] executors to plan execution on
+/// @param rankIds [in] vector of pair<rank, Id> from computeRankIds()
+/// @param graph [in, out] actions graph
+void scheduleWithLookahead(const Executors &executors, const RankIds &rankIds,
+                           Graph &graph);
+
 using ExecutionPlan = std::vector<std::pair<Time, SHA>>;
 
 /// @brief Get Execution Plan from actions after
@@ -42,6 +161,27 @@ using ExecutionPlan = std::vector<std::pair<Time, SHA>>;
 /// action SHA sorted by non-decreasing time
 ExecutionPlan getExecutionPlan(const Actions &actions);
 
+/// @brief Get Ids of actions in order of execution after schedule() function
+/// was called on graph, actions with equal start time are ordered by Id.
+/// Phony Start and End actions are not included.
+/// @param graph actions graph
+/// @return Ids sorted by non-decreasing start time
+std::vector<Id> getExecutionOrder(const Graph &graph);
+
+/// @brief Same as getExecutionOrder() above, but for the schedule kept apart
+/// from the graph
+/// @param graph actions graph
+/// @param scheduled schedule of the graph actions
+/// @return Ids sorted by non-decreasing start time
+std::vector<Id> getExecutionOrder(const Graph &graph,
+                                  const Schedule &scheduled);
+
+/// @brief Get Execution Plan from graph after schedule() function was called
+/// on it, actions with equal start time are ordered by Id
+/// @param graph actions graph
+/// @return vector of pair<Time, SHA> sorted by non-decreasing time
+ExecutionPlan getExecutionPlan(const Graph &graph);
+
 struct CriticalPath {
   Time infiniteExecutorsLength{
       0}; ///< execution time in case of infinite executors
@@ -55,4 +195,10 @@ struct CriticalPath {
 /// @return
 CriticalPath getCriticalPath(const Actions &actions);
 
+/// @brief Get Critical Path from graph after schedule() function was called
+/// on it
+/// @param graph actions graph
+/// @return critical path lengths and SHAs of its actions
+CriticalPath getCriticalPath(const Graph &graph);
+
 } // namespace builder
\ No newline at end of file
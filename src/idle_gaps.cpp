@@ -0,0 +1,140 @@
+#include "idle_gaps.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace builder {
+
+namespace {
+const Time infinity{std::numeric_limits<Time>::max()};
+} // namespace
+
+IdleGaps::IdleGaps() { root_ = newNode(0, infinity); }
+
+int32_t IdleGaps::newNode(Time start, Time end) {
+  random_ ^= random_ << 13;
+  random_ ^= random_ >> 17;
+  random_ ^= random_ << 5;
+  const Node node{start, end, end - start, random_};
+  if (!freeNodes_.empty()) {
+    const int32_t index = freeNodes_.back();
+    freeNodes_.pop_back();
+    nodes_[index] = node;
+    return index;
+  }
+  nodes_.push_back(node);
+  return static_cast<int32_t>(nodes_.size() - 1);
+}
+
+void IdleGaps::update(int32_t node) {
+  auto &n = nodes_[node];
+  n.maxLength = n.end - n.start;
+  if (n.left >= 0) {
+    n.maxLength = std::max(n.maxLength, nodes_[n.left].maxLength);
+  }
+  if (n.right >= 0) {
+    n.maxLength = std::max(n.maxLength, nodes_[n.right].maxLength);
+  }
+}
+
+void IdleGaps::split(int32_t node, Time key, int32_t &less,
+                     int32_t &notLess) {
+  if (node < 0) {
+    less = notLess = -1;
+    return;
+  }
+  if (nodes_[node].start < key) {
+    split(nodes_[node].right, key, nodes_[node].right, notLess);
+    less = node;
+  } else {
+    split(nodes_[node].left, key, less, nodes_[node].left);
+    notLess = node;
+  }
+  update(node);
+}
+
+int32_t IdleGaps::merge(int32_t left, int32_t right) {
+  if (left < 0 || right < 0) {
+    return left < 0 ? right : left;
+  }
+  if (nodes_[left].priority > nodes_[right].priority) {
+    nodes_[left].right = merge(nodes_[left].right, right);
+    update(left);
+    return left;
+  }
+  nodes_[right].left = merge(left, nodes_[right].left);
+  update(right);
+  return right;
+}
+
+int32_t IdleGaps::findContaining(Time time) const {
+  int32_t found{-1};
+  for (int32_t node = root_; node >= 0;) {
+    if (nodes_[node].start <= time) {
+      found = node;
+      node = nodes_[node].right;
+    } else {
+      node = nodes_[node].left;
+    }
+  }
+  return found;
+}
+
+int32_t IdleGaps::findFirstAfter(int32_t node, Time time,
+                                 Time duration) const {
+  if (node < 0 || nodes_[node].maxLength < duration) {
+    return -1;
+  }
+  const auto &n = nodes_[node];
+  if (n.start <= time) {
+    return findFirstAfter(n.right, time, duration);
+  }
+  const int32_t found = findFirstAfter(n.left, time, duration);
+  if (found >= 0) {
+    return found;
+  }
+  if (n.end - n.start >= duration) {
+    return node;
+  }
+  return findFirstAfter(n.right, time, duration);
+}
+
+Time IdleGaps::findStart(Time readyTime, Time duration) const {
+  // Either the interval which the action can start in right when it is ready
+  const int32_t containing = findContaining(readyTime);
+  if (containing >= 0 && nodes_[containing].end - readyTime >= duration) {
+    return readyTime;
+  }
+  // or the earliest long enough interval after it, the last interval is
+  // infinite, so it always exists
+  return nodes_[findFirstAfter(root_, readyTime, duration)].start;
+}
+
+void IdleGaps::occupy(Time start, Time duration) {
+  const int32_t gap = findContaining(start);
+  const Time gapStart = nodes_[gap].start;
+  const Time gapEnd = nodes_[gap].end;
+
+  // Cut the gap out of the tree and put back what is left of it
+  int32_t less, notLess, rest;
+  split(root_, gapStart, less, notLess);
+  split(notLess, gapStart + 1, notLess, rest);
+  freeNodes_.push_back(notLess);
+  if (gapStart < start) {
+    less = merge(less, newNode(gapStart, start));
+  }
+  if (start + duration < gapEnd) {
+    less = merge(less, newNode(start + duration, gapEnd));
+  }
+  root_ = merge(less, rest);
+}
+
+Time IdleGaps::availableTime() const {
+  int32_t node = root_;
+  while (nodes_[node].right >= 0) {
+    node = nodes_[node].right;
+  }
+  return nodes_[node].start;
+}
+
+} // namespace builder
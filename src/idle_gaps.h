@@ -0,0 +1,61 @@
+#pragma once
+
+#include "action.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace builder {
+
+/// @brief Idle time intervals of a single executor, used by insertion based
+/// HEFT scheduling. Intervals are kept in a treap ordered by start time and
+/// augmented with maximal interval length of a subtree, so both search of the
+/// earliest fitting interval and its update take logarithmic time.
+class IdleGaps {
+public:
+  /// @brief Create executor idle from time zero to infinity
+  IdleGaps();
+
+  /// @brief Find earliest start time of an action on the executor
+  /// @param readyTime time when all dependencies of the action are finished
+  /// @param duration duration of the action
+  /// @return earliest time not before readyTime, when the executor is idle for
+  /// the whole duration
+  Time findStart(Time readyTime, Time duration) const;
+
+  /// @brief Mark time interval as busy, it must be inside an idle interval,
+  /// e.g. returned by findStart()
+  /// @param start start time of the busy interval
+  /// @param duration length of the busy interval
+  void occupy(Time start, Time duration);
+
+  /// @brief Time when the executor becomes idle forever
+  Time availableTime() const;
+
+private:
+  struct Node {
+    Time start;         ///< start of the idle interval
+    Time end;           ///< end of the idle interval, may be infinite
+    Time maxLength;     ///< maximal length of intervals in the subtree
+    uint32_t priority;  ///< treap heap priority
+    int32_t left{-1};   ///< node with earlier intervals
+    int32_t right{-1};  ///< node with later intervals
+  };
+
+  int32_t newNode(Time start, Time end);
+  void update(int32_t node);
+  /// @brief Split tree to nodes with start < key and the rest
+  void split(int32_t node, Time key, int32_t &less, int32_t &notLess);
+  int32_t merge(int32_t left, int32_t right);
+  /// @brief Node with the latest start not after time, or -1
+  int32_t findContaining(Time time) const;
+  /// @brief Leftmost node with start after time and length at least duration
+  int32_t findFirstAfter(int32_t node, Time time, Time duration) const;
+
+  std::vector<Node> nodes_{};
+  std::vector<int32_t> freeNodes_{};
+  int32_t root_{-1};
+  uint32_t random_{2463534242u}; ///< xorshift state for priorities
+};
+
+} // namespace builder
@@ -0,0 +1,382 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace builder {
+
+namespace {
+
+/// @brief Order of computeRankIds(): highest rank first, then smaller Id
+bool rankOrder(const std::pair<Time, Id> &lhs, const std::pair<Time, Id> &rhs) {
+  return lhs.first > rhs.first ||
+         (lhs.first == rhs.first && lhs.second < rhs.second);
+}
+
+void checkDuration(std::string_view sha, Duration duration) {
+  if (duration <= 0) {
+    throw std::runtime_error("Duration of action " + std::string(sha) +
+                             " must be positive, got " +
+                             std::to_string(duration));
+  }
+}
+
+} // namespace
+
+IncrementalPlan::IncrementalPlan(Graph graph, Executors executors,
+                                 Placement placement)
+    : graph_(std::move(graph)), executors_(std::move(executors)),
+      placement_(placement) {
+  calculateRanks(graph_, executors_);
+  rankIds_ = computeRankIds(graph_);
+  schedule(executors_, rankIds_, graph_, placement_);
+}
+
+Id IncrementalPlan::find(std::string_view sha) const {
+  auto added = addedIds_.find(std::string(sha));
+  Id id = added != addedIds_.end() ? added->second : graph_.find(sha);
+  if (id == graph_.startId() || id == graph_.endId() || removed_.count(id)) {
+    return -1;
+  }
+  return id;
+}
+
+Id IncrementalPlan::at(std::string_view sha) const {
+  const Id id = find(sha);
+  if (id < 0) {
+    throw std::runtime_error("There's no action " + std::string(sha));
+  }
+  return id;
+}
+
+IncrementalPlan::Edges &IncrementalPlan::editedDependencies(Id id) {
+  auto edited = dependencies_.find(id);
+  if (edited != dependencies_.end()) {
+    return edited->second;
+  }
+  Edges edges;
+  for (Offset edge = graph_.dependencies.offsets[id];
+       edge < graph_.dependencies.offsets[id + 1]; ++edge) {
+    if (graph_.dependencies.targets[edge] != graph_.startId()) {
+      edges.emplace_back(graph_.dependencies.targets[edge],
+                         graph_.dependencies.dataSizes.empty()
+                             ? 0
+                             : graph_.dependencies.dataSizes[edge]);
+    }
+  }
+  return dependencies_[id] = std::move(edges);
+}
+
+void IncrementalPlan::addAction(
+    std::string_view sha, Duration duration,
+    const std::vector<std::string_view> &dependencies) {
+  checkDuration(sha, duration);
+  if (find(sha) >= 0 || sha == Start.sha1 || sha == End.sha1) {
+    throw std::runtime_error("Action " + std::string(sha) +
+                             " is already defined, must be defined only once.");
+  }
+  Edges edges;
+  for (auto dependency : dependencies) {
+    edges.emplace_back(at(dependency), 0);
+  }
+  const Id id = graph_.size() + static_cast<Id>(addedShas_.size());
+  addedShas_.emplace_back(sha);
+  addedDurations_.push_back(duration);
+  addedIds_[std::string(sha)] = id;
+  dependencies_[id] = std::move(edges);
+}
+
+void IncrementalPlan::removeAction(std::string_view sha) {
+  const Id id = at(sha);
+  if (id < graph_.size()) {
+    // Dependents which were not edited yet get their own copy of edges
+    for (auto dependent = graph_.dependents.begin(id);
+         dependent != graph_.dependents.end(id); ++dependent) {
+      if (*dependent != graph_.endId() && !removed_.count(*dependent)) {
+        editedDependencies(*dependent);
+      }
+    }
+  }
+  for (auto &[dependent, edges] : dependencies_) {
+    edges.erase(std::remove_if(edges.begin(), edges.end(),
+                               [&](auto &edge) { return edge.first == id; }),
+                edges.end());
+  }
+  removed_.insert(id);
+}
+
+void IncrementalPlan::changeDuration(std::string_view sha, Duration duration) {
+  checkDuration(sha, duration);
+  const Id id = at(sha);
+  if (id >= graph_.size()) {
+    addedDurations_[id - graph_.size()] = duration;
+  } else {
+    durations_[id] = duration;
+  }
+}
+
+void IncrementalPlan::addEdge(std::string_view sha,
+                              std::string_view dependency, DataSize dataSize) {
+  const Id id = at(sha);
+  const Id dependencyId = at(dependency);
+  if (dependencyId >= id) {
+    throw std::runtime_error("Dependency of target " + std::string(sha) +
+                             " called: " + std::string(dependency) +
+                             " must be declared before use.");
+  }
+  auto &edges = editedDependencies(id);
+  auto edge = std::find_if(edges.begin(), edges.end(), [&](auto &edge) {
+    return edge.first == dependencyId;
+  });
+  if (edge == edges.end()) {
+    edges.emplace_back(dependencyId, dataSize);
+  } else {
+    // As for duplicate dependencies in the input the largest size is kept
+    edge->second = std::max(edge->second, dataSize);
+  }
+}
+
+void IncrementalPlan::removeEdge(std::string_view sha,
+                                 std::string_view dependency) {
+  const Id id = at(sha);
+  const Id dependencyId = at(dependency);
+  auto &edges = editedDependencies(id);
+  auto edge = std::find_if(edges.begin(), edges.end(), [&](auto &edge) {
+    return edge.first == dependencyId;
+  });
+  if (edge == edges.end()) {
+    throw std::runtime_error("Action " + std::string(sha) +
+                             " doesn't depend on " + std::string(dependency));
+  }
+  edges.erase(edge);
+}
+
+Graph IncrementalPlan::rebuild(std::vector<Id> &newIds) const {
+  const Id addedNumber = static_cast<Id>(addedShas_.size());
+  bool withDataSizes = !graph_.dependencies.dataSizes.empty();
+  for (auto &[_, edges] : dependencies_) {
+    for (auto &[dependency, dataSize] : edges) {
+      withDataSizes = withDataSizes || dataSize != 0;
+    }
+  }
+
+  Graph graph;
+  const size_t actionsNumber = graph_.size() + addedNumber;
+  graph.shas.bytes.reserve(graph_.shas.bytes.size());
+  graph.shas.offsets.reserve(actionsNumber + 1);
+  graph.shaIndex.rehash(graph.shas, actionsNumber);
+  graph.durations.reserve(actionsNumber);
+  graph.dependencies.offsets.reserve(actionsNumber + 1);
+  graph.dependencies.targets.reserve(graph_.dependencies.targets.size());
+
+  newIds.assign(actionsNumber, -1);
+  std::vector<bool> hasDependents(actionsNumber, false);
+  std::vector<Id> dependencies;
+  std::vector<DataSize> dataSizes;
+  newIds[graph_.startId()] =
+      graph.addAction(Start.sha1, Start.duration, dependencies);
+
+  auto addAction = [&](Id id, std::string_view sha, Duration duration) {
+    dependencies.clear();
+    dataSizes.clear();
+    auto edited = dependencies_.find(id);
+    if (edited != dependencies_.end()) {
+      for (auto &[dependency, dataSize] : edited->second) {
+        dependencies.push_back(newIds[dependency]);
+        dataSizes.push_back(dataSize);
+      }
+    } else {
+      for (Offset edge = graph_.dependencies.offsets[id];
+           edge < graph_.dependencies.offsets[id + 1]; ++edge) {
+        if (graph_.dependencies.targets[edge] != graph_.startId()) {
+          dependencies.push_back(newIds[graph_.dependencies.targets[edge]]);
+          dataSizes.push_back(graph_.dependencies.dataSizes.empty()
+                                  ? 0
+                                  : graph_.dependencies.dataSizes[edge]);
+        }
+      }
+    }
+    for (Id dependency : dependencies) {
+      hasDependents[dependency] = true;
+    }
+    // Make nodes virtually dependent on the single start node
+    if (dependencies.empty()) {
+      dependencies.push_back(graph.startId());
+      dataSizes.push_back(0);
+    }
+    if (!withDataSizes) {
+      dataSizes.clear();
+    }
+    newIds[id] = graph.addAction(sha, duration, dependencies, dataSizes);
+    if (id < graph_.size()) {
+      graph.setDemand(newIds[id], graph_.demand(id));
+      graph.setDeviation(newIds[id], graph_.deviation(id));
+    }
+  };
+
+  for (Id id = graph_.startId() + 1; id < graph_.endId(); ++id) {
+    if (!removed_.count(id)) {
+      auto duration = durations_.find(id);
+      addAction(id, graph_.shas[id],
+                duration != durations_.end() ? duration->second
+                                             : graph_.durations[id]);
+    }
+  }
+  for (Id i = 0; i < addedNumber; ++i) {
+    if (!removed_.count(graph_.size() + i)) {
+      addAction(graph_.size() + i, addedShas_[i], addedDurations_[i]);
+    }
+  }
+  dependencies.clear();
+  for (Id id = graph.startId() + 1; id < graph.size(); ++id) {
+    if (!hasDependents[id]) {
+      dependencies.push_back(id);
+    }
+  }
+  newIds[graph_.endId()] =
+      graph.addAction(End.sha1, End.duration, dependencies);
+  graph.finalize();
+
+  // Ranks and schedule of unchanged actions are kept
+  for (Id id = 0; id < graph_.size(); ++id) {
+    const Id newId = newIds[id];
+    if (newId < 0) {
+      continue;
+    }
+    graph.ranks[newId] = graph_.ranks[id];
+    graph.longestPaths[newId] = graph_.longestPaths[id];
+    const Id predecessor = graph_.predecessors[id];
+    graph.predecessors[newId] = predecessor < 0 ? -1 : newIds[predecessor];
+    graph.startTimes[newId] = graph_.startTimes[id];
+    graph.endTimes[newId] = graph_.endTimes[id];
+    graph.executorIds[newId] = graph_.executorIds[id];
+  }
+  graph.ranksCalculated = true;
+  return graph;
+}
+
+ReplanStats IncrementalPlan::replan() {
+  // Ranks of changed actions and dependencies of changed edges depend on the
+  // edits, and so do ranks of all their ancestors
+  std::vector<Id> seeds;
+  std::vector<Id> changed;
+  auto addOldDependencies = [&](Id id) {
+    if (id < graph_.size()) {
+      seeds.insert(seeds.end(), graph_.dependencies.begin(id),
+                   graph_.dependencies.end(id));
+    }
+  };
+  for (auto &[id, duration] : durations_) {
+    seeds.push_back(id);
+    changed.push_back(id);
+  }
+  for (auto &[id, edges] : dependencies_) {
+    seeds.push_back(id);
+    changed.push_back(id);
+    for (auto &[dependency, _] : edges) {
+      seeds.push_back(dependency);
+    }
+    addOldDependencies(id);
+  }
+  for (Id id : removed_) {
+    addOldDependencies(id);
+  }
+  if (seeds.empty()) {
+    return ReplanStats{0, rankIds_.size()};
+  }
+
+  std::vector<Id> newIds;
+  if (addedShas_.empty() && removed_.empty() && dependencies_.empty()) {
+    // Only durations changed, the graph is kept
+    for (auto &[id, duration] : durations_) {
+      graph_.durations[id] = duration;
+    }
+    newIds.resize(graph_.size());
+    std::iota(newIds.begin(), newIds.end(), 0);
+  } else {
+    Graph graph = rebuild(newIds);
+    // Kept actions keep their order, so overrides stay sorted
+    auto &overrides = executors_.durationOverrides;
+    size_t kept{0};
+    for (auto durationOverride : overrides) {
+      durationOverride.action = newIds[durationOverride.action];
+      if (durationOverride.action >= 0) {
+        overrides[kept++] = durationOverride;
+      }
+    }
+    overrides.resize(kept);
+    graph_ = std::move(graph);
+  }
+  addedShas_.clear();
+  addedDurations_.clear();
+  addedIds_.clear();
+  removed_.clear();
+  durations_.clear();
+  dependencies_.clear();
+
+  // Ancestor cone of the seeds, ranks of other actions don't change
+  std::vector<bool> inCone(graph_.size(), false);
+  std::vector<Id> cone;
+  for (Id seed : seeds) {
+    const Id id = newIds[seed];
+    if (id >= 0 && !inCone[id]) {
+      inCone[id] = true;
+      cone.push_back(id);
+    }
+  }
+  for (size_t i = 0; i < cone.size(); ++i) {
+    for (auto dependency = graph_.dependencies.begin(cone[i]);
+         dependency != graph_.dependencies.end(cone[i]); ++dependency) {
+      if (!inCone[*dependency]) {
+        inCone[*dependency] = true;
+        cone.push_back(*dependency);
+      }
+    }
+  }
+  std::sort(cone.begin(), cone.end(), std::greater<>());
+  recalculateRanks(graph_, executors_, cone);
+
+  // Merge actions with unchanged ranks, which are still in order, with
+  // actions of the cone
+  RankIds kept;
+  kept.reserve(rankIds_.size());
+  std::vector<Id> oldOrder;
+  oldOrder.reserve(rankIds_.size());
+  for (auto &[rank, id] : rankIds_) {
+    const Id newId = newIds[id];
+    oldOrder.push_back(newId);
+    if (newId >= 0 && !inCone[newId]) {
+      kept.emplace_back(rank, newId);
+    }
+  }
+  RankIds recalculated;
+  for (Id id : cone) {
+    if (id != graph_.startId() && id != graph_.endId()) {
+      recalculated.emplace_back(graph_.ranks[id], id);
+    }
+  }
+  std::sort(recalculated.begin(), recalculated.end(), rankOrder);
+  rankIds_.clear();
+  rankIds_.reserve(kept.size() + recalculated.size());
+  std::merge(kept.begin(), kept.end(), recalculated.begin(),
+             recalculated.end(), std::back_inserter(rankIds_), rankOrder);
+
+  // Actions before the first changed one in the order are scheduled the same
+  std::vector<bool> isChanged(graph_.size(), false);
+  for (Id id : changed) {
+    if (newIds[id] >= 0) {
+      isChanged[newIds[id]] = true;
+    }
+  }
+  size_t first{0};
+  while (first < rankIds_.size() && first < oldOrder.size() &&
+         rankIds_[first].second == oldOrder[first] &&
+         !isChanged[rankIds_[first].second]) {
+    ++first;
+  }
+  scheduleFrom(first, executors_, rankIds_, graph_, placement_);
+  return ReplanStats{static_cast<Id>(cone.size()), first};
+}
+
+} // namespace builder
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "action.h"
+#include "executors.h"
+#include "graph.h"
+#include "heft.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace builder {
+
+/// @brief Work done by IncrementalPlan::replan()
+struct ReplanStats {
+  Id recalculatedRanks{0};            ///< actions with recalculated ranks
+  size_t firstRescheduledPosition{0}; ///< position in rankIds scheduled from
+};
+
+/// @brief Planned actions graph, which is replanned incrementally after
+/// edits. Edits are collected and applied together by replan(), which
+/// recalculates ranks of the ancestor cone of changed actions only and
+/// schedules again from the earliest changed position in the rank order.
+/// The result is the same as planning the edited graph from scratch, as if
+/// added actions were appended to the input file and removed ones with their
+/// edges were deleted from it.
+class IncrementalPlan {
+public:
+  /// @brief Plan the graph from scratch
+  /// @param graph actions graph
+  /// @param executors executors to plan execution on
+  /// @param placement how actions are placed on executors
+  IncrementalPlan(Graph graph, Executors executors,
+                  Placement placement = Placement::Append);
+
+  /// @brief Add action after all actions of the graph
+  /// @param sha SHA of the action, must not be already defined
+  /// @param duration positive duration of the action
+  /// @param dependencies SHAs of existing actions
+  void addAction(std::string_view sha, Duration duration,
+                 const std::vector<std::string_view> &dependencies);
+
+  /// @brief Remove action together with edges to its dependencies and
+  /// dependents
+  void removeAction(std::string_view sha);
+
+  /// @brief Change duration of action to a positive duration
+  void changeDuration(std::string_view sha, Duration duration);
+
+  /// @brief Make action depend on another one
+  /// @param sha SHA of the dependent action
+  /// @param dependency SHA of the dependency, it must be declared before the
+  /// action as in the input file
+  /// @param dataSize size of data passed along the edge
+  void addEdge(std::string_view sha, std::string_view dependency,
+               DataSize dataSize = 0);
+
+  /// @brief Remove dependency of action, which must exist
+  void removeEdge(std::string_view sha, std::string_view dependency);
+
+  /// @brief Apply all edits since the previous replan() and update the plan
+  ReplanStats replan();
+
+  /// @brief Planned graph, it's valid after replan()
+  const Graph &graph() const { return graph_; }
+
+  /// @brief Rank order of actions the graph is scheduled in
+  const RankIds &rankIds() const { return rankIds_; }
+
+private:
+  using Edges = std::vector<std::pair<Id, DataSize>>;
+
+  /// @brief Id of existing action or -1. Added actions get Ids after all Ids
+  /// of the graph in order of addition.
+  Id find(std::string_view sha) const;
+  /// @brief Id of existing action, throws if there's no such action
+  Id at(std::string_view sha) const;
+  /// @brief Dependencies of action without phony Start, which can be edited
+  Edges &editedDependencies(Id id);
+  /// @brief Build graph with edits applied and its data copied from the
+  /// current graph
+  /// @param newIds [out] new Ids of actions, -1 for removed ones
+  Graph rebuild(std::vector<Id> &newIds) const;
+
+  Graph graph_;
+  Executors executors_;
+  Placement placement_;
+  RankIds rankIds_{};
+
+  // Edits since the last replan()
+  std::vector<std::string> addedShas_{};
+  std::vector<Duration> addedDurations_{};
+  std::unordered_map<std::string, Id> addedIds_{};
+  std::unordered_set<Id> removed_{};
+  std::unordered_map<Id, Duration> durations_{};
+  std::unordered_map<Id, Edges> dependencies_{};
+};
+
+} // namespace builder
@@ -1,102 +1,715 @@
 #include "input.h"
+#include "binary_graph.h"
+#include "mapped_file.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <fstream>
-#include <regex>
+#include <future>
+#include <iterator>
+#include <limits>
 #include <sstream>
-
-#include <iostream>
+#include <thread>
 
 namespace builder {
 
-Actions load_actions(std::istream &fi) {
-  std::unordered_map<std::string, Action> actions;
-  // Line in the format:
-  // sha1 duration [dependency1 dependency2...]
-  // sha 123 sha1   sha2 sha3
-  static std::regex r("\\s*(\\w+)\\s+(\\d+)((\\s+\\w+)*)\\s*");
-  static std::regex emptyLineRegex("\\s*");
+namespace {
 
-  // Dependencies of start node are nodes with no real dependencies
-  auto start = Start;
-  // Dependencies of end node are nodes with no real dependencies
-  auto end = End;
+// Line in the format:
+// sha1 duration [dependency1[:data_size] dependency2[:data_size]...]
+// sha 123 sha1   sha2:4096 sha3
+// which is the same as the regex "\s*(\w+)\s+(\d+)((\s+\w+(:\d+)?)*)\s*"
 
-  std::unordered_set<std::string> nodesWithNoDependencies;
-  std::unordered_set<std::string> nodesWhichNoNodeDependsOn;
+enum CharClass : uint8_t { Other, Space, Word };
 
-  std::string s{};
-  while (std::getline(fi, s)) {
-    if (std::regex_match(s, emptyLineRegex)) {
+/// @brief Character classes of the line format, same as \s and \w of regex
+constexpr std::array<CharClass, 256> charClasses = []() {
+  std::array<CharClass, 256> classes{};
+  for (auto c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+    classes[static_cast<unsigned char>(c)] = Space;
+  }
+  for (int c = '0'; c <= '9'; ++c) {
+    classes[c] = Word;
+  }
+  for (int c = 'a'; c <= 'z'; ++c) {
+    classes[c] = Word;
+    classes[c - 'a' + 'A'] = Word;
+  }
+  classes['_'] = Word;
+  return classes;
+}();
+
+inline CharClass charClass(char c) {
+  return charClasses[static_cast<unsigned char>(c)];
+}
+
+/// @brief Chunks are at most this large, so that SHAs are referred to by
+/// 32-bit offsets, which halves the memory taken by parsed dependencies
+constexpr size_t maxChunkSize{std::numeric_limits<uint32_t>::max()};
+
+/// @brief Actions of a line-aligned chunk of the input, which are parsed
+/// independently of other chunks. Checks which need all previous actions are
+/// left for mergeChunks().
+struct ParsedChunk {
+  /// @brief Word of the chunk text
+  struct Token {
+    uint32_t offset; ///< offset of the word in the chunk text
+    uint32_t size;   ///< size of the word
+  };
+
+  struct Line {
+    Token sha;                ///< SHA of action
+    Duration duration;        ///< duration of action
+    uint32_t dependenciesEnd; ///< end of the action dependencies in chunk
+    uint32_t lineNumber;      ///< number of the line in chunk starting with 1
+  };
+
+  std::string_view text{};           ///< text of the chunk
+  std::vector<Line> lines{};         ///< actions of the chunk
+  std::vector<Token> dependencies{}; ///< dependencies of actions
+  /// data sizes parallel to dependencies, empty until some dependency of the
+  /// chunk has data size
+  std::vector<DataSize> dataSizes{};
+  bool hasDataSizes{false};   ///< some dependency has data size
+  /// resource demands of the actions which give them, with index of line
+  std::vector<std::pair<uint32_t, Resources>> demands{};
+  /// deviations of durations of the actions which give them, with index of
+  /// line
+  std::vector<std::pair<uint32_t, Duration>> deviations{};
+  size_t shasSize{0};         ///< total size of SHAs of actions
+  int64_t linesCount{0};      ///< lines in the chunk
+  std::string error{};        ///< first error in the chunk, empty if none
+  int64_t errorLineNumber{0}; ///< number of the line with the error
+
+  Token tokenOf(std::string_view word) const {
+    return {static_cast<uint32_t>(word.data() - text.data()),
+            static_cast<uint32_t>(word.size())};
+  }
+  std::string_view operator[](Token token) const {
+    return text.substr(token.offset, token.size);
+  }
+};
+
+/// @brief Parse single line to the chunk
+/// @param line line without the new line character
+/// @param lineNumber number of the line in chunk
+/// @param chunk [in, out] chunk to add parsed action to
+/// @return error message, empty if there's no error
+std::string parseLine(std::string_view line, int64_t lineNumber,
+                      ParsedChunk &chunk) {
+  size_t i = 0;
+  auto skipSpaces = [&]() {
+    while (i < line.size() && charClass(line[i]) == Space) {
+      ++i;
+    }
+  };
+  auto scanWord = [&]() {
+    const size_t begin = i;
+    while (i < line.size() && charClass(line[i]) == Word) {
+      ++i;
+    }
+    return line.substr(begin, i - begin);
+  };
+  // Every token must be followed by a space or the end of line
+  auto isTokenEnd = [&]() {
+    return i == line.size() || charClass(line[i]) == Space;
+  };
+  auto formatError = [&]() {
+    chunk.dependencies.resize(chunk.lines.empty()
+                                  ? 0
+                                  : chunk.lines.back().dependenciesEnd);
+    if (chunk.hasDataSizes) {
+      chunk.dataSizes.resize(chunk.dependencies.size());
+    }
+    return "Input file format error, faulty input line = '" +
+           std::string(line) + "'";
+  };
+
+  skipSpaces();
+  if (i == line.size()) {
+    // Empty lines with only whitespaces are discarded
+    return {};
+  }
+  const auto sha = scanWord();
+  if (sha.empty() || i == line.size() || !isTokenEnd()) {
+    return formatError();
+  }
+  skipSpaces();
+  const size_t durationBegin = i;
+  while (i < line.size() && line[i] >= '0' && line[i] <= '9') {
+    ++i;
+  }
+  const auto durationStr = line.substr(durationBegin, i - durationBegin);
+  if (durationStr.empty() || !isTokenEnd()) {
+    return formatError();
+  }
+  Resources demand{Graph::defaultDemand};
+  bool hasDemand{false};
+  Duration deviation{0};
+  while (true) {
+    skipSpaces();
+    if (i == line.size()) {
+      break;
+    }
+    const auto dependency = scanWord();
+    if (dependency.empty()) {
+      return formatError();
+    }
+    if (i < line.size() && line[i] == '=') {
+      // Resource demand or deviation of the action rather than a dependency
+      ++i;
+      const size_t amountBegin = i;
+      int64_t amount{0};
+      for (; i < line.size() && line[i] >= '0' && line[i] <= '9'; ++i) {
+        if (amount > (std::numeric_limits<int64_t>::max() - 9) / 10) {
+          return "Amount of " + std::string(dependency) + " of action " +
+                 std::string(sha) + " is too large.";
+        }
+        amount = amount * 10 + (line[i] - '0');
+      }
+      if (i == amountBegin || !isTokenEnd()) {
+        return formatError();
+      }
+      if (dependency == "memory") {
+        demand.memory = amount;
+        hasDemand = true;
+      } else if (dependency == "slots" &&
+                 amount <= std::numeric_limits<int32_t>::max()) {
+        demand.slots = static_cast<int32_t>(amount);
+        hasDemand = true;
+      } else if (dependency == "deviation" &&
+                 amount <= std::numeric_limits<Duration>::max()) {
+        deviation = static_cast<Duration>(amount);
+      } else {
+        return formatError();
+      }
       continue;
     }
+    DataSize dataSize{0};
+    if (i < line.size() && line[i] == ':') {
+      ++i;
+      const size_t dataSizeBegin = i;
+      for (; i < line.size() && line[i] >= '0' && line[i] <= '9'; ++i) {
+        if (dataSize > (std::numeric_limits<DataSize>::max() - 9) / 10) {
+          return "Data size of dependency " + std::string(dependency) +
+                 " of action " + std::string(sha) + " is too large.";
+        }
+        dataSize = dataSize * 10 + (line[i] - '0');
+      }
+      if (i == dataSizeBegin) {
+        return formatError();
+      }
+      if (!chunk.hasDataSizes) {
+        chunk.dataSizes.assign(chunk.dependencies.size(), 0);
+        chunk.hasDataSizes = true;
+      }
+    }
+    if (!isTokenEnd()) {
+      return formatError();
+    }
+    chunk.dependencies.push_back(chunk.tokenOf(dependency));
+    if (chunk.hasDataSizes) {
+      chunk.dataSizes.push_back(dataSize);
+    }
+  }
+
+  int64_t duration{0};
+  for (char digit : durationStr) {
+    duration = std::min<int64_t>(duration * 10 + (digit - '0'),
+                                 std::numeric_limits<Duration>::max() + 1LL);
+  }
+  const auto durationValue = static_cast<Duration>(
+      std::min<int64_t>(duration, std::numeric_limits<Duration>::max()));
+  if (duration <= 0) {
+    return "Duration of action " + std::string(sha) +
+           " is negative or zero " + std::to_string(durationValue) +
+           ", must be positive parsed from string: " + std::string(durationStr);
+  }
+  if (duration > std::numeric_limits<Duration>::max() ||
+      durationStr != std::to_string(duration)) {
+    return "Duration of action " + std::string(sha) +
+           " was incorrectly parsed + " + std::to_string(durationValue) +
+           ", parsed from string: " + std::string(durationStr);
+  }
+  if (hasDemand) {
+    chunk.demands.emplace_back(static_cast<uint32_t>(chunk.lines.size()),
+                               demand);
+  }
+  if (deviation != 0) {
+    chunk.deviations.emplace_back(static_cast<uint32_t>(chunk.lines.size()),
+                                  deviation);
+  }
+  chunk.lines.push_back(ParsedChunk::Line{
+      chunk.tokenOf(sha), durationValue,
+      static_cast<uint32_t>(chunk.dependencies.size()),
+      static_cast<uint32_t>(lineNumber)});
+  chunk.shasSize += sha.size();
+  return {};
+}
+
+/// @brief Parse lines of the chunk till the end or the first error
+void parseChunk(std::string_view text, ParsedChunk &chunk) {
+  chunk.text = text;
+  size_t lineBegin = 0;
+  while (lineBegin < text.size()) {
+    // memchr() is vectorized by the C library, so lines are found fast
+    const auto *newLine = static_cast<const char *>(
+        std::memchr(text.data() + lineBegin, '\n', text.size() - lineBegin));
+    const size_t lineEnd = newLine ? newLine - text.data() : text.size();
+    ++chunk.linesCount;
+    chunk.error = parseLine(text.substr(lineBegin, lineEnd - lineBegin),
+                            chunk.linesCount, chunk);
+    if (!chunk.error.empty()) {
+      chunk.errorLineNumber = chunk.linesCount;
+      return;
+    }
+    lineBegin = lineEnd + 1;
+  }
+}
+
+/// @brief Split text into at most chunksNumber chunks ending with a new line
+std::vector<std::string_view> splitToChunks(std::string_view text,
+                                            size_t chunksNumber) {
+  std::vector<std::string_view> chunks;
+  size_t chunkBegin = 0;
+  for (size_t i = 1; i <= chunksNumber && chunkBegin < text.size(); ++i) {
+    size_t chunkEnd = std::max(chunkBegin, text.size() / chunksNumber * i);
+    if (i == chunksNumber) {
+      chunkEnd = text.size();
+    } else {
+      const auto newLine = text.find('\n', chunkEnd);
+      chunkEnd = newLine == std::string_view::npos ? text.size() : newLine + 1;
+    }
+    chunks.push_back(text.substr(chunkBegin, chunkEnd - chunkBegin));
+    if (chunks.back().size() > maxChunkSize) {
+      throw std::runtime_error("Input lines must be shorter than " +
+                               std::to_string(maxChunkSize / 2) + " bytes.");
+    }
+    chunkBegin = chunkEnd;
+  }
+  return chunks;
+}
 
-    std::smatch sm;
-    if (std::regex_match(s, sm, r)) {
-      const SHA sha = sm[1];
-      const std::string durationStr = sm[2];
-      const int duration{std::atoi(durationStr.c_str())};
+std::runtime_error lineError(int64_t lineNumber, const std::string &message) {
+  return std::runtime_error("Line " + std::to_string(lineNumber) + ": " +
+                            message);
+}
 
-      if (duration <= 0) {
-        throw std::runtime_error(
-            "Duration of action " + sha + " is negative or zero " +
-            std::to_string(duration) +
-            ", must be positive parsed from string: " + durationStr);
-      }
-      if (durationStr != std::to_string(duration)) {
-        throw std::runtime_error(
-            "Duration of action " + sha + " was incorrectly parsed + " +
-            std::to_string(duration) + ", parsed from string: " + durationStr);
-      }
-      if (actions.count(sha)) {
-        throw std::runtime_error(
-            "Action " + sha +
-            " is already defined, must be defined only once.");
-      }
-
-      builder::Dependencies dependencies;
-      std::stringstream dependenciesStream(sm[3]);
-      std::string dep;
-      while (dependenciesStream >> dep) {
-        if (actions.count(dep) == 0) {
-          throw std::runtime_error("Dependency of target " + sha + " called: " +
-                                   dep + " must be declared before use.");
+/// @brief Build graph from parsed chunks in order of lines, checking that
+/// actions are unique and declared before use. The graph isn't finalized,
+/// so that its reverse edges and schedule are allocated after the chunks
+/// are freed.
+Graph mergeChunks(const std::vector<ParsedChunk> &chunks) {
+  Graph graph;
+  // Every array of the graph is allocated once with its final size
+  size_t actionsNumber{2};
+  size_t dependenciesNumber{0};
+  size_t shasSize{Start.sha1.size() + End.sha1.size()};
+  for (auto &chunk : chunks) {
+    actionsNumber += chunk.lines.size();
+    dependenciesNumber += chunk.dependencies.size();
+    shasSize += chunk.shasSize;
+  }
+  graph.shas.bytes.reserve(shasSize);
+  graph.shas.offsets.reserve(actionsNumber + 1);
+  graph.shaIndex.rehash(graph.shas, actionsNumber);
+  graph.durations.reserve(actionsNumber);
+  graph.dependencies.offsets.reserve(actionsNumber + 1);
+  graph.dependencies.targets.reserve(dependenciesNumber + actionsNumber);
+
+  const bool hasDataSizes =
+      std::any_of(chunks.begin(), chunks.end(),
+                  [](auto &chunk) { return chunk.hasDataSizes; });
+  if (hasDataSizes) {
+    graph.dependencies.dataSizes.reserve(dependenciesNumber + actionsNumber);
+  }
+
+  // Start node gets Id 0, it is the dependency of nodes with no real
+  // dependencies
+  std::vector<Id> dependencies;
+  std::vector<DataSize> dataSizes;
+  graph.addAction(Start.sha1, Start.duration, dependencies);
+
+  // Nodes which no node depends on become dependencies of the end node
+  std::vector<bool> hasDependents(actionsNumber, false);
+
+  const bool hasDemands = std::any_of(
+      chunks.begin(), chunks.end(),
+      [](auto &chunk) { return !chunk.demands.empty(); });
+  if (hasDemands) {
+    graph.memoryDemands.reserve(actionsNumber);
+    graph.slotDemands.reserve(actionsNumber);
+  }
+  if (std::any_of(chunks.begin(), chunks.end(),
+                  [](auto &chunk) { return !chunk.deviations.empty(); })) {
+    graph.deviations.reserve(actionsNumber);
+  }
+
+  int64_t chunkFirstLine{0};
+  for (auto &chunk : chunks) {
+    size_t dependencyIndex{0};
+    auto demand = chunk.demands.begin();
+    auto deviation = chunk.deviations.begin();
+    for (auto &line : chunk.lines) {
+      const auto sha = chunk[line.sha];
+      if (graph.find(sha) >= 0) {
+        throw lineError(chunkFirstLine + line.lineNumber,
+                        "Action " + std::string(sha) +
+                            " is already defined, must be defined only once.");
+      }
+
+      dependencies.clear();
+      dataSizes.clear();
+      for (; dependencyIndex < line.dependenciesEnd; ++dependencyIndex) {
+        const auto dependencySha = chunk[chunk.dependencies[dependencyIndex]];
+        const Id dependency = graph.find(dependencySha);
+        if (dependency < 0) {
+          throw lineError(chunkFirstLine + line.lineNumber,
+                          "Dependency of target " + std::string(sha) +
+                              " called: " + std::string(dependencySha) +
+                              " must be declared before use.");
+        }
+        hasDependents[dependency] = true;
+        dependencies.push_back(dependency);
+        if (hasDataSizes) {
+          dataSizes.push_back(
+              chunk.hasDataSizes ? chunk.dataSizes[dependencyIndex] : 0);
         }
-        nodesWhichNoNodeDependsOn.erase(dep);
-        dependencies.insert(std::move(dep));
       }
 
       // Make nodes virtually dependent on the single start node
       if (dependencies.empty()) {
-        dependencies.insert(start.sha1);
+        dependencies.push_back(graph.startId());
+        if (hasDataSizes) {
+          dataSizes.push_back(0);
+        }
+      }
+      const Id id =
+          graph.addAction(sha, line.duration, dependencies, dataSizes);
+      if (demand != chunk.demands.end() &&
+          demand->first ==
+              static_cast<uint32_t>(&line - chunk.lines.data())) {
+        graph.setDemand(id, demand->second);
+        ++demand;
+      }
+      if (deviation != chunk.deviations.end() &&
+          deviation->first ==
+              static_cast<uint32_t>(&line - chunk.lines.data())) {
+        graph.setDeviation(id, deviation->second);
+        ++deviation;
       }
-      actions[sha] = Action{sha, duration, dependencies};
-      nodesWhichNoNodeDependsOn.insert(sha);
-    } else {
-      throw std::runtime_error(
-          "Input file format error, faulty input line = '" + s + "'");
     }
+    if (!chunk.error.empty()) {
+      throw lineError(chunkFirstLine + chunk.errorLineNumber, chunk.error);
+    }
+    chunkFirstLine += chunk.linesCount;
   }
+
   // Algorithm fails on empty input, and it is easier to fail here
-  if (actions.empty()) {
+  if (graph.size() == 1) {
     throw std::runtime_error(
         "There must be at least one action to schedule, got zero actions.");
   }
-  end.dependencies.insert(nodesWhichNoNodeDependsOn.begin(),
-                          nodesWhichNoNodeDependsOn.end());
-  actions[start.sha1] = std::move(start);
-  actions[end.sha1] = std::move(end);
-  return actions;
+  dependencies.clear();
+  for (Id id = graph.startId() + 1; id < graph.size(); ++id) {
+    if (!hasDependents[id]) {
+      dependencies.push_back(id);
+    }
+  }
+  graph.addAction(End.sha1, End.duration, dependencies);
+  return graph;
+}
+
+} // namespace
+
+Graph parse_graph(std::string_view text, unsigned threadsNumber) {
+  // Small chunks are not worth a thread
+  const size_t minChunkSize{1 << 20};
+  if (threadsNumber == 0) {
+    threadsNumber = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Chunks end at the first new line after their half of maximal size
+  const auto chunksText = splitToChunks(
+      text, std::max(std::min<size_t>(threadsNumber,
+                                      text.size() / minChunkSize + 1),
+                     text.size() / (maxChunkSize / 2) + 1));
+
+  // Threads take the next chunk to parse until all are parsed
+  std::vector<ParsedChunk> chunks(chunksText.size());
+  std::atomic<size_t> nextChunk{0};
+  auto parseChunks = [&]() {
+    for (size_t i = nextChunk++; i < chunksText.size(); i = nextChunk++) {
+      parseChunk(chunksText[i], chunks[i]);
+    }
+  };
+  std::vector<std::future<void>> parsers;
+  for (size_t i = 1; i < std::min<size_t>(threadsNumber, chunksText.size());
+       ++i) {
+    parsers.push_back(std::async(std::launch::async, parseChunks));
+  }
+  parseChunks();
+  for (auto &parser : parsers) {
+    parser.get();
+  }
+
+  // The graph takes as much memory as the parsed chunks, so they are freed
+  // before the graph gets its reverse edges and schedule
+  auto graph = mergeChunks(chunks);
+  chunks = {};
+  graph.finalize();
+  return graph;
+}
+
+Graph load_graph(std::istream &fi, unsigned threadsNumber) {
+  const std::string text(std::istreambuf_iterator<char>(fi), {});
+  if (is_binary_graph(text)) {
+    return load_binary_graph(text);
+  }
+  return parse_graph(text, threadsNumber);
+}
+
+Graph load_graph(std::filesystem::path file, unsigned threadsNumber) try {
+  if (!std::filesystem::exists(file)) {
+    throw std::runtime_error("File '" + file.string() + "' does not exist.");
+  }
+  MappedFile mappedFile(file);
+  if (is_binary_graph(mappedFile.data())) {
+    return load_binary_graph(mappedFile.data());
+  }
+  return parse_graph(mappedFile.data(), threadsNumber);
+} catch (std::exception &e) {
+  throw std::runtime_error("Error during reading file '" + file.string() +
+                           "'. " + e.what());
+}
+
+Executors load_executors(std::istream &fi, const Graph &graph) {
+  Executors executors;
+  auto &overrides = executors.durationOverrides;
+
+  std::string s{};
+  int64_t lineNumber{0};
+  while (std::getline(fi, s)) {
+    ++lineNumber;
+    std::istringstream line(s);
+    std::string kind, name, rest;
+    if (!(line >> kind)) {
+      // Empty lines with only whitespaces are discarded
+      continue;
+    }
+    auto formatError = [&]() {
+      return lineError(lineNumber,
+                       "Executors file format error, faulty input line = '" +
+                           s + "'");
+    };
+    if (kind == "executor") {
+      Id count{0};
+      double speed{0};
+      std::string node{"default"};
+      if (!(line >> name >> count >> speed) ||
+          (line >> node && line >> rest)) {
+        throw formatError();
+      }
+      for (auto &executorClass : executors.classes) {
+        if (executorClass.name == name) {
+          throw lineError(lineNumber, "Executor class " + name +
+                                          " is already defined, must be "
+                                          "defined only once.");
+        }
+      }
+      try {
+        executors.addClass(name, count, speed, node);
+      } catch (std::exception &e) {
+        throw lineError(lineNumber, e.what());
+      }
+    } else if (kind == "bandwidth") {
+      if (!(line >> executors.intraNodeBandwidth >>
+            executors.interNodeBandwidth) ||
+          line >> rest) {
+        throw formatError();
+      }
+      if (executors.intraNodeBandwidth < 0 ||
+          executors.interNodeBandwidth < 0) {
+        throw lineError(lineNumber, "Bandwidth must not be negative.");
+      }
+    } else if (kind == "capacity") {
+      Resources capacity{};
+      if (!(line >> name >> capacity.memory >> capacity.slots) ||
+          line >> rest) {
+        throw formatError();
+      }
+      try {
+        executors.setCapacity(name, capacity);
+      } catch (std::exception &e) {
+        throw lineError(lineNumber, e.what());
+      }
+    } else if (kind == "duration") {
+      std::string sha;
+      Duration duration{0};
+      if (!(line >> sha >> name >> duration) || line >> rest) {
+        throw formatError();
+      }
+      const Id action = graph.find(sha);
+      if (action < 0) {
+        throw lineError(lineNumber, "Duration is given for unknown action " +
+                                        sha + ".");
+      }
+      auto executorClass = std::find_if(
+          executors.classes.begin(), executors.classes.end(),
+          [&](auto &executorClass) { return executorClass.name == name; });
+      if (executorClass == executors.classes.end()) {
+        throw lineError(lineNumber, "Executor class " + name +
+                                        " must be declared before use.");
+      }
+      if (duration <= 0) {
+        throw lineError(lineNumber, "Duration of action " + sha +
+                                        " must be positive, got " +
+                                        std::to_string(duration));
+      }
+      overrides.push_back(DurationOverride{
+          action, static_cast<Id>(executorClass - executors.classes.begin()),
+          duration});
+    } else {
+      throw formatError();
+    }
+  }
+  if (executors.classes.empty()) {
+    throw std::runtime_error(
+        "There must be at least one executor class, got zero classes.");
+  }
+  // The last duration given for an action and class is kept
+  auto byActionAndClass = [](auto &left, auto &right) {
+    return std::pair(left.action, left.classIndex) <
+           std::pair(right.action, right.classIndex);
+  };
+  std::stable_sort(overrides.begin(), overrides.end(), byActionAndClass);
+  auto last = std::unique(
+      overrides.rbegin(), overrides.rend(), [&](auto &left, auto &right) {
+        return !byActionAndClass(left, right) &&
+               !byActionAndClass(right, left);
+      });
+  overrides.erase(overrides.begin(), last.base());
+  return executors;
+}
+
+Executors load_executors(std::filesystem::path file, const Graph &graph) try {
+  if (!std::filesystem::exists(file)) {
+    throw std::runtime_error("File '" + file.string() + "' does not exist.");
+  }
+  std::ifstream fi(file);
+  return load_executors(fi, graph);
+} catch (std::exception &e) {
+  throw std::runtime_error("Error during reading file '" + file.string() +
+                           "'. " + e.what());
+}
+
+std::vector<std::string> load_commands(std::istream &fi, const Graph &graph) {
+  std::vector<std::string> commands(graph.size());
+  std::string s{};
+  int64_t lineNumber{0};
+  while (std::getline(fi, s)) {
+    ++lineNumber;
+    std::istringstream line(s);
+    std::string sha;
+    if (!(line >> sha)) {
+      // Empty lines with only whitespaces are discarded
+      continue;
+    }
+    line >> std::ws;
+    std::string command(std::istreambuf_iterator<char>(line), {});
+    const Id action = graph.find(sha);
+    if (action <= graph.startId() || action >= graph.endId()) {
+      throw lineError(lineNumber,
+                      "Command is given for unknown action " + sha + ".");
+    }
+    if (command.empty()) {
+      throw lineError(lineNumber, "Command of action " + sha + " is empty.");
+    }
+    if (!commands[action].empty()) {
+      throw lineError(lineNumber, "Command of action " + sha +
+                                      " is already defined, must be defined "
+                                      "only once.");
+    }
+    commands[action] = std::move(command);
+  }
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    if (commands[id].empty()) {
+      throw std::runtime_error("There's no command for action " +
+                               std::string(graph.shas[id]) + ".");
+    }
+  }
+  return commands;
 }
 
-Actions load_actions(std::filesystem::path file) try {
+std::vector<std::string> load_commands(std::filesystem::path file,
+                                       const Graph &graph) try {
   if (!std::filesystem::exists(file)) {
     throw std::runtime_error("File '" + file.string() + "' does not exist.");
   }
   std::ifstream fi(file);
-  return load_actions(fi);
+  return load_commands(fi, graph);
 } catch (std::exception &e) {
   throw std::runtime_error("Error during reading file '" + file.string() +
                            "'. " + e.what());
 }
 
-} // namespace builder
\ No newline at end of file
+void save_graph(const Graph &graph, std::ostream &fo) {
+  std::string line;
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    line.assign(graph.shas[id]);
+    line += ' ';
+    line += std::to_string(graph.durations[id]);
+    const auto demand = graph.demand(id);
+    if (demand.memory != Graph::defaultDemand.memory) {
+      line += " memory=";
+      line += std::to_string(demand.memory);
+    }
+    if (demand.slots != Graph::defaultDemand.slots) {
+      line += " slots=";
+      line += std::to_string(demand.slots);
+    }
+    if (graph.deviation(id) != 0) {
+      line += " deviation=";
+      line += std::to_string(graph.deviation(id));
+    }
+    for (Offset edge = graph.dependencies.offsets[id];
+         edge < graph.dependencies.offsets[id + 1]; ++edge) {
+      const Id dependency = graph.dependencies.targets[edge];
+      if (dependency == graph.startId()) {
+        continue;
+      }
+      line += ' ';
+      line += graph.shas[dependency];
+      if (!graph.dependencies.dataSizes.empty() &&
+          graph.dependencies.dataSizes[edge] != 0) {
+        line += ':';
+        line += std::to_string(graph.dependencies.dataSizes[edge]);
+      }
+    }
+    line += '\n';
+    fo << line;
+  }
+}
+
+void save_graph(const Graph &graph, std::filesystem::path file) {
+  std::ofstream fo(file, std::ofstream::out | std::ofstream::trunc);
+  if (!fo) {
+    throw std::runtime_error("Couldn't open output file '" + file.string() +
+                             "'");
+  }
+  save_graph(graph, fo);
+  fo.close();
+  if (!fo) {
+    throw std::runtime_error("Error writing graph to '" + file.string() +
+                             "'");
+  }
+}
+
+Actions load_actions(std::istream &fi) { return toActions(load_graph(fi)); }
+
+Actions load_actions(std::filesystem::path file) {
+  return toActions(load_graph(file));
+}
+
+} // namespace builder
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "action.h"
+#include "executors.h"
+#include "graph.h"
 
 #include <filesystem>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace builder {
 
@@ -17,4 +22,87 @@ Actions load_actions(std::istream &fi);
 /// @return map from Action.sha to Action object
 Actions load_actions(std::filesystem::path file);
 
+/// @brief Loads actions graph from given input stream, format and
+/// validation are the same as of load_actions(), binary graph format of
+/// save_binary_graph() is detected and loaded as well. Dependencies may be
+/// given with size of data they pass as dependency_sha:data_size, and
+/// actions may be given resources they hold while running as memory=amount
+/// and slots=number tokens among dependencies, one CPU slot by default, and
+/// standard deviation of their duration as deviation=time.
+/// @param fi input stream to load data from
+/// @param threadsNumber number of threads to parse with, 0 for all hardware
+/// threads
+/// @return graph with phony Start and End actions
+Graph load_graph(std::istream &fi, unsigned threadsNumber = 0);
+
+/// @brief Loads actions graph from given input file, which is memory mapped,
+/// the file is either in text or binary graph format
+/// @param file Path to file to load
+/// @param threadsNumber number of threads to parse with, 0 for all hardware
+/// threads
+/// @return graph with phony Start and End actions
+Graph load_graph(std::filesystem::path file, unsigned threadsNumber = 0);
+
+/// @brief Parses actions graph from text in the input file format.
+/// Text is split into line-aligned chunks parsed in parallel, then actions
+/// are merged in order of lines. Errors are reported with line numbers.
+/// @param text content of input file
+/// @param threadsNumber number of threads to parse with, 0 for all hardware
+/// threads
+/// @return graph with phony Start and End actions
+Graph parse_graph(std::string_view text, unsigned threadsNumber = 0);
+
+/// @brief Loads executors description from given input stream.
+/// Each line is either a class of identical executors on a node, "default"
+/// if node is not given:
+///   executor class_name count speed_factor [node_name]
+/// or bandwidths of passing data between executors of the same node and of
+/// different nodes, 0 for unlimited, which is the default:
+///   bandwidth intra_node inter_node
+/// or duration of an action on executors of a class, which overrides the
+/// duration of action divided by the speed factor of the class:
+///   duration action_sha class_name duration
+/// or resources of a node, which actions running on its executors at once
+/// share, 0 for unlimited, which is the default:
+///   capacity node_name memory slots
+/// Classes must be defined before mentioned in durations, nodes before
+/// mentioned in capacities.
+/// @param fi input stream to load data from
+/// @param graph actions graph durations are given for
+/// @return executors with consecutive Ids in order of classes definition
+Executors load_executors(std::istream &fi, const Graph &graph);
+
+/// @brief Loads executors description from given input file.
+/// @param file Path to file to load
+/// @param graph actions graph durations are given for
+/// @return executors with consecutive Ids in order of classes definition
+Executors load_executors(std::filesystem::path file, const Graph &graph);
+
+/// @brief Loads commands of actions from given input stream.
+/// Each line is a command of an action:
+///   action_sha command with arguments
+/// Every action of the graph must have exactly one command.
+/// @param fi input stream to load data from
+/// @param graph actions graph commands are given for
+/// @return commands indexed by Id of action, empty for phony actions
+std::vector<std::string> load_commands(std::istream &fi, const Graph &graph);
+
+/// @brief Loads commands of actions from given input file.
+/// @param file Path to file to load
+/// @param graph actions graph commands are given for
+/// @return commands indexed by Id of action, empty for phony actions
+std::vector<std::string> load_commands(std::filesystem::path file,
+                                       const Graph &graph);
+
+/// @brief Save actions graph in the input file format, actions in order of
+/// Ids, data sizes of dependencies are written if they aren't zero
+/// @param graph actions graph
+/// @param fo output stream
+void save_graph(const Graph &graph, std::ostream &fo);
+
+/// @brief Save actions graph to given file in the input file format
+/// @param graph actions graph
+/// @param file Path to file to write to
+void save_graph(const Graph &graph, std::filesystem::path file);
+
 } // namespace builder
\ No newline at end of file
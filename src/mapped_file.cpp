@@ -0,0 +1,67 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace builder {
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::filesystem::path &file) {
+  std::ifstream fi(file, std::ios::binary);
+  if (!fi) {
+    throw std::runtime_error("Couldn't open file '" + file.string() + "'");
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(fi), {});
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path &file) {
+  const int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Couldn't open file '" + file.string() + "'");
+  }
+  struct stat fileStat {};
+  if (::fstat(fd, &fileStat) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Couldn't get size of file '" + file.string() +
+                             "'");
+  }
+  size_ = static_cast<size_t>(fileStat.st_size);
+  // Mapping of zero bytes is an error, empty files have empty content
+  if (size_ > 0) {
+    void *mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("Couldn't map file '" + file.string() +
+                               "' into memory");
+    }
+    ::madvise(mapped, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char *>(mapped);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (size_ > 0) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+}
+
+#endif
+
+} // namespace builder
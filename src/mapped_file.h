@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace builder {
+
+/// @brief Read-only memory mapping of a whole file, the file content is read
+/// into memory on platforms without mmap()
+class MappedFile {
+public:
+  /// @brief Map given file into memory
+  /// @param file path to file to map, throws std::runtime_error on failure
+  explicit MappedFile(const std::filesystem::path &file);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /// @brief Content of the mapped file, valid while the object lives
+  std::string_view data() const { return {data_, size_}; }
+
+private:
+  const char *data_{nullptr}; ///< beginning of the mapped content
+  size_t size_{0};            ///< size of the mapped content in bytes
+  std::string buffer_{};      ///< file content if mmap() is not available
+};
+
+} // namespace builder
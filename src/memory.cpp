@@ -0,0 +1,112 @@
+#include "memory.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+/// @brief Allocations are prefixed with their size, the prefix keeps the
+/// alignment of malloc()
+constexpr size_t allocationHeader{alignof(std::max_align_t)};
+
+std::atomic<int64_t> allocationsNumber{0}; ///< allocations since start
+std::atomic<int64_t> allocatedBytes{0};    ///< bytes allocated since start
+std::atomic<int64_t> heapBytes{0};         ///< currently allocated bytes
+std::atomic<int64_t> peakHeapBytes{0};     ///< highest heapBytes since reset
+
+void *allocate(size_t size) noexcept {
+  auto *block = static_cast<char *>(std::malloc(size + allocationHeader));
+  if (block == nullptr) {
+    return nullptr;
+  }
+  std::memcpy(block, &size, sizeof(size));
+  allocationsNumber.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  const int64_t bytes =
+      heapBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  int64_t peak = peakHeapBytes.load(std::memory_order_relaxed);
+  while (bytes > peak && !peakHeapBytes.compare_exchange_weak(
+                             peak, bytes, std::memory_order_relaxed)) {
+  }
+  return block + allocationHeader;
+}
+
+void deallocate(void *pointer) noexcept {
+  if (pointer == nullptr) {
+    return;
+  }
+  auto *block = static_cast<char *>(pointer) - allocationHeader;
+  size_t size{0};
+  std::memcpy(&size, block, sizeof(size));
+  heapBytes.fetch_sub(size, std::memory_order_relaxed);
+  std::free(block);
+}
+
+void *allocateOrThrow(size_t size) {
+  void *pointer = allocate(size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+} // namespace
+
+void *operator new(size_t size) { return allocateOrThrow(size); }
+void *operator new[](size_t size) { return allocateOrThrow(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+void operator delete(void *pointer) noexcept { deallocate(pointer); }
+void operator delete[](void *pointer) noexcept { deallocate(pointer); }
+void operator delete(void *pointer, size_t) noexcept { deallocate(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { deallocate(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+  deallocate(pointer);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+  deallocate(pointer);
+}
+
+namespace builder {
+
+HeapUsage heapUsage() {
+  return {allocationsNumber.load(std::memory_order_relaxed),
+          allocatedBytes.load(std::memory_order_relaxed),
+          heapBytes.load(std::memory_order_relaxed),
+          peakHeapBytes.load(std::memory_order_relaxed)};
+}
+
+void resetPeakHeapBytes() {
+  peakHeapBytes.store(heapBytes.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+}
+
+int64_t peakResidentBytes() {
+#if defined(_WIN32)
+  return 0;
+#else
+  struct rusage usage {};
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  // Bytes on macOS, kilobytes elsewhere
+  return usage.ru_maxrss;
+#else
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+} // namespace builder
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace builder {
+
+/// @brief Heap usage counted by the global operator new and delete, which
+/// are replaced by memory.cpp in every binary linking it
+struct HeapUsage {
+  int64_t allocations{0};    ///< number of allocations since the start
+  int64_t allocatedBytes{0}; ///< bytes of all allocations since the start
+  int64_t bytes{0};          ///< bytes currently allocated
+  int64_t peakBytes{0};      ///< highest bytes since resetPeakHeapBytes()
+};
+
+/// @brief Current heap usage of the process
+HeapUsage heapUsage();
+
+/// @brief Start tracking the peak of heap usage from the current usage
+void resetPeakHeapBytes();
+
+/// @brief Peak resident set size of the process
+/// @return bytes, 0 if the platform doesn't report it
+int64_t peakResidentBytes();
+
+} // namespace builder
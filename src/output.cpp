@@ -0,0 +1,206 @@
+#include "output.h"
+#include "heft.h"
+
+#include <charconv>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace builder {
+
+namespace {
+
+/// @brief Formats output into a block of memory and writes whole blocks to
+/// the stream, so that the stream is called once per block rather than per
+/// field
+class BufferedWriter {
+public:
+  explicit BufferedWriter(std::ostream &fo) : fo_(fo) {
+    buffer_.reserve(blockSize + blockSize / 4);
+  }
+
+  BufferedWriter &operator<<(std::string_view text) {
+    buffer_.append(text);
+    return *this;
+  }
+
+  BufferedWriter &operator<<(char c) {
+    buffer_.push_back(c);
+    return *this;
+  }
+
+  BufferedWriter &operator<<(int64_t number) {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    buffer_.append(digits, result.ptr);
+    return *this;
+  }
+
+  /// @brief Write the block if it is full, called after every record
+  void endRecord() {
+    if (buffer_.size() >= blockSize) {
+      writeBlock();
+    }
+  }
+
+  /// @brief Write the rest of the block and check the stream
+  void finish() {
+    writeBlock();
+    fo_.flush();
+    if (!fo_) {
+      throw std::runtime_error("Error outputting execution plan.");
+    }
+  }
+
+private:
+  static constexpr size_t blockSize{1 << 20};
+
+  void writeBlock() {
+    fo_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    if (!fo_) {
+      throw std::runtime_error("Error outputting execution plan.");
+    }
+    buffer_.clear();
+  }
+
+  std::ostream &fo_;
+  std::string buffer_{};
+};
+
+/// @brief Scheduled action written to the plan
+struct PlanRecord {
+  std::string_view sha;
+  Id executor;
+  Time start;
+  Time end;
+};
+
+/// @brief Call function with every scheduled action in order of start times.
+/// Reading fields of actions in that order would miss caches on every field,
+/// so records are gathered by windows of consecutive positions in the plan,
+/// and the actions of a window are read in order of Ids, which goes forward
+/// through every array of the graph.
+template <typename Function>
+void forEachRecord(const Graph &graph, Function function) {
+  const size_t windowSize{1 << 16};
+  const auto order = getExecutionOrder(graph);
+  std::vector<uint32_t> positions(graph.size());
+  for (size_t position = 0; position < order.size(); ++position) {
+    positions[order[position]] = static_cast<uint32_t>(position);
+  }
+
+  // Counting sort of Ids by window, Ids of a window stay ascending
+  const size_t windowsNumber = (order.size() + windowSize - 1) / windowSize;
+  std::vector<size_t> windowBegins(windowsNumber + 1, 0);
+  for (Id id : order) {
+    ++windowBegins[positions[id] / windowSize + 1];
+  }
+  std::partial_sum(windowBegins.begin(), windowBegins.end(),
+                   windowBegins.begin());
+  std::vector<Id> windowIds(order.size());
+  std::vector<size_t> nextIds(windowBegins.begin(), windowBegins.end() - 1);
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    windowIds[nextIds[positions[id] / windowSize]++] = id;
+  }
+
+  std::vector<PlanRecord> records(windowSize);
+  std::string shas;
+  std::vector<size_t> shaBegins(windowSize);
+  for (size_t window = 0; window < windowsNumber; ++window) {
+    shas.clear();
+    for (size_t index = windowBegins[window]; index < windowBegins[window + 1];
+         ++index) {
+      const Id id = windowIds[index];
+      const size_t slot = positions[id] - window * windowSize;
+      records[slot] = {{}, graph.executorIds[id], graph.startTimes[id],
+                       graph.endTimes[id]};
+      const auto sha = graph.shas[id];
+      shaBegins[slot] = shas.size();
+      records[slot].sha = {nullptr, sha.size()};
+      shas.append(sha);
+    }
+    // Views of SHAs are made when the buffer isn't reallocated any more
+    const size_t recordsNumber =
+        windowBegins[window + 1] - windowBegins[window];
+    for (size_t slot = 0; slot < recordsNumber; ++slot) {
+      auto &record = records[slot];
+      record.sha = {shas.data() + shaBegins[slot], record.sha.size()};
+      function(record);
+    }
+  }
+}
+
+} // namespace
+
+PlanFormat parse_plan_format(std::string_view name) {
+  if (name == "tsv") {
+    return PlanFormat::Tsv;
+  }
+  if (name == "ndjson") {
+    return PlanFormat::Ndjson;
+  }
+  if (name == "trace") {
+    return PlanFormat::ChromeTrace;
+  }
+  throw std::runtime_error("Unknown plan format '" + std::string(name) +
+                           "', must be tsv, ndjson or trace.");
+}
+
+void save_plan(const Graph &graph, PlanFormat format, std::ostream &fo) {
+  // SHAs consist of word characters only, so they need no escaping in JSON
+  BufferedWriter out(fo);
+  switch (format) {
+  case PlanFormat::Tsv:
+    forEachRecord(graph, [&](const PlanRecord &record) {
+      out << record.sha << '\t' << record.start << '\n';
+      out.endRecord();
+    });
+    break;
+  case PlanFormat::Ndjson:
+    forEachRecord(graph, [&](const PlanRecord &record) {
+      out << "{\"sha\":\"" << record.sha << "\",\"executor\":"
+          << int64_t{record.executor} << ",\"start\":" << record.start
+          << ",\"end\":" << record.end << "}\n";
+      out.endRecord();
+    });
+    break;
+  case PlanFormat::ChromeTrace: {
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    std::string_view separator{""};
+    forEachRecord(graph, [&](const PlanRecord &record) {
+      out << separator << "{\"name\":\"" << record.sha
+          << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << int64_t{record.executor}
+          << ",\"ts\":" << record.start
+          << ",\"dur\":" << record.end - record.start << '}';
+      out.endRecord();
+      separator = ",\n";
+    });
+    out << "\n]}\n";
+    break;
+  }
+  }
+  out.finish();
+}
+
+void save_plan(const Graph &graph, PlanFormat format,
+               const std::filesystem::path &file) {
+  std::ofstream fo(file, std::ofstream::out | std::ofstream::trunc |
+                             std::ofstream::binary);
+  if (!fo) {
+    throw std::runtime_error("Couldn't open output file '" + file.string() +
+                             "'");
+  }
+  try {
+    save_plan(graph, format, fo);
+  } catch (std::runtime_error &) {
+    fo.setstate(std::ios::failbit);
+  }
+  fo.close();
+  if (!fo) {
+    throw std::runtime_error("Error outputting execution plan to '" +
+                             file.string() + "'");
+  }
+}
+
+} // namespace builder
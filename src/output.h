@@ -0,0 +1,41 @@
+#pragma once
+
+#include "graph.h"
+
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+
+namespace builder {
+
+/// @brief Formats of the scheduled execution plan
+enum class PlanFormat {
+  Tsv,        ///< 'sha<TAB>start_time' lines
+  Ndjson,     ///< JSON object of sha, executor, start and end per line
+  ChromeTrace ///< trace event JSON of Chrome tracing and Perfetto UI
+};
+
+/// @brief Parse name of plan format
+/// @param name 'tsv', 'ndjson' or 'trace'
+/// @return plan format, throws std::runtime_error on unknown name
+PlanFormat parse_plan_format(std::string_view name);
+
+/// @brief Save scheduled execution plan of actions in order of start times,
+/// phony Start and End actions are not written. Output is formatted into
+/// large blocks which are written at once.
+/// In the trace format every executor is a thread of one process and every
+/// action is a complete event lasting from its start to its end time, time
+/// units of the plan are written as microseconds.
+/// @param graph actions graph after schedule()
+/// @param format format of the plan
+/// @param fo output stream, throws std::runtime_error if writing fails
+void save_plan(const Graph &graph, PlanFormat format, std::ostream &fo);
+
+/// @brief Save scheduled execution plan to given file
+/// @param graph actions graph after schedule()
+/// @param format format of the plan
+/// @param file Path to file to write to
+void save_plan(const Graph &graph, PlanFormat format,
+               const std::filesystem::path &file);
+
+} // namespace builder
@@ -0,0 +1,318 @@
+#include "plan_cache.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace builder {
+
+namespace {
+
+const char signature[8] = {'B', 'L', 'D', 'P', 'L', 'A', 'N', 'C'};
+/// Version of the entries format, it must change when plans of the same
+/// inputs change, so that plans of previous versions are never found
+const uint64_t formatVersion{1};
+const uint64_t byteOrderMark{0x0102030405060708ull};
+const std::string_view formatName{"Plan cache"};
+const std::string_view entryExtension{".plan"};
+
+/// @brief Bytes hashed as one task of hashGraph()
+const size_t hashBlock{size_t{1} << 18};
+
+/// @brief Cache entry header, it is followed by arrays of the plan, each
+/// padded to 8 bytes
+struct Header {
+  char signature[8];            ///< plan cache format signature
+  uint64_t version;             ///< format version
+  uint64_t byteOrder;           ///< byteOrderMark in byte order of the writer
+  PlanKey key;                  ///< key of the plan
+  PlanKey checksum;             ///< digest of the arrays after the header
+  int64_t actionsNumber;        ///< number of actions of the graph
+  int64_t criticalPathSize;     ///< number of actions on the critical path
+  Time infiniteExecutorsLength; ///< see CriticalPath
+  Time actualExecutorsLength;   ///< see CriticalPath
+};
+
+/// @brief Two lane multiply-xorshift hash of bytes in native byte order
+PlanKey hashBytes(const char *data, size_t size, PlanKey seed = {}) {
+  const uint64_t lowMultiplier{0x9E3779B97F4A7C15ull};
+  const uint64_t highMultiplier{0xC2B2AE3D27D4EB4Full};
+  uint64_t low = seed.low ^ (size * lowMultiplier);
+  uint64_t high = seed.high ^ (size * highMultiplier);
+  auto add = [&](uint64_t word) {
+    low = (low ^ word) * lowMultiplier;
+    low ^= low >> 29;
+    high = (high ^ word) * highMultiplier;
+    high ^= high >> 32;
+  };
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    add(word);
+  }
+  uint64_t tail{0};
+  if (i < size) {
+    std::memcpy(&tail, data + i, size - i);
+  }
+  add(tail);
+  return {low ^ (high >> 31), high ^ (low >> 27)};
+}
+
+/// @brief Appends values to bytes hashed by makePlanKey()
+struct KeyBytes {
+  std::string bytes{};
+
+  template <class T> void add(const T &value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  void add(std::string_view text) {
+    add(text.size());
+    bytes.append(text);
+  }
+  template <class T> void add(const std::vector<T> &array) {
+    add(array.size());
+    bytes.append(reinterpret_cast<const char *>(array.data()),
+                 array.size() * sizeof(T));
+  }
+};
+
+std::filesystem::path entryPath(const std::filesystem::path &directory,
+                                const PlanKey &key) {
+  return directory / (key.hex() + std::string(entryExtension));
+}
+
+/// @brief Remove the least recently used entries while the cache is larger
+/// than maxBytes, entries removed by other processes meanwhile are skipped
+void evict(const std::filesystem::path &directory, const PlanKey &kept,
+           uint64_t maxBytes) {
+  const auto keptPath = entryPath(directory, kept);
+  std::vector<std::tuple<std::filesystem::file_time_type, uintmax_t,
+                         std::filesystem::path>>
+      entries;
+  uint64_t totalBytes{0};
+  std::error_code error;
+  for (auto &entry : std::filesystem::directory_iterator(directory, error)) {
+    if (entry.path().extension() != entryExtension) {
+      continue;
+    }
+    const auto size = entry.file_size(error);
+    const auto time = entry.last_write_time(error);
+    if (error) {
+      continue;
+    }
+    totalBytes += size;
+    if (entry.path() != keptPath) {
+      entries.emplace_back(time, size, entry.path());
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  for (auto &[time, size, path] : entries) {
+    if (totalBytes <= maxBytes) {
+      break;
+    }
+    std::filesystem::remove(path, error);
+    totalBytes -= size;
+  }
+}
+
+} // namespace
+
+std::string PlanKey::hex() const {
+  const char digits[] = "0123456789abcdef";
+  std::string text(32, '0');
+  for (int digit = 0; digit < 16; ++digit) {
+    text[15 - digit] = digits[(high >> (4 * digit)) & 15];
+    text[31 - digit] = digits[(low >> (4 * digit)) & 15];
+  }
+  return text;
+}
+
+PlanKey hashGraph(const Graph &graph, unsigned threadsNumber) {
+  struct Array {
+    const char *data;
+    size_t size;
+  };
+  auto array = [](const auto &vector) {
+    return Array{reinterpret_cast<const char *>(vector.data()),
+                 vector.size() * sizeof(vector[0])};
+  };
+  const Array arrays[] = {array(graph.shas.offsets),
+                          array(graph.shas.bytes),
+                          array(graph.durations),
+                          array(graph.memoryDemands),
+                          array(graph.slotDemands),
+                          array(graph.dependencies.offsets),
+                          array(graph.dependencies.targets),
+                          array(graph.dependencies.dataSizes)};
+  std::vector<Array> blocks;
+  std::vector<uint64_t> sizes;
+  for (auto &whole : arrays) {
+    sizes.push_back(whole.size);
+    for (size_t begin = 0; begin < whole.size; begin += hashBlock) {
+      blocks.push_back(
+          {whole.data + begin, std::min(hashBlock, whole.size - begin)});
+    }
+  }
+
+  if (threadsNumber == 0) {
+    threadsNumber = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadsNumber = static_cast<unsigned>(
+      std::max<size_t>(1, std::min<size_t>(threadsNumber, blocks.size())));
+  std::vector<PlanKey> digests(blocks.size());
+  std::atomic<size_t> nextBlock{0};
+  auto work = [&]() {
+    for (size_t block = nextBlock++; block < blocks.size();
+         block = nextBlock++) {
+      digests[block] = hashBytes(blocks[block].data, blocks[block].size);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned thread = 1; thread < threadsNumber; ++thread) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Sizes of arrays tell where every array begins among the blocks
+  const auto sizesDigest = hashBytes(
+      reinterpret_cast<const char *>(sizes.data()), sizes.size() * 8);
+  return hashBytes(reinterpret_cast<const char *>(digests.data()),
+                   digests.size() * sizeof(PlanKey), sizesDigest);
+}
+
+PlanKey makePlanKey(const PlanKey &graphHash, const Executors &executors,
+                    std::string_view scheduler, Placement placement) {
+  KeyBytes key;
+  key.add(formatVersion);
+  key.add(graphHash);
+  key.add(scheduler);
+  key.add(static_cast<int32_t>(placement));
+  key.add(executors.classes.size());
+  for (auto &executorClass : executors.classes) {
+    key.add(std::string_view(executorClass.name));
+    key.add(executorClass.count);
+    key.add(executorClass.speed);
+    key.add(executorClass.firstExecutor);
+    key.add(executorClass.node);
+  }
+  key.add(executors.nodes.size());
+  for (auto &node : executors.nodes) {
+    key.add(std::string_view(node));
+  }
+  key.add(executors.intraNodeBandwidth);
+  key.add(executors.interNodeBandwidth);
+  key.add(executors.durationOverrides);
+  // Resources are added by fields, their padding bytes are undefined
+  key.add(executors.capacities.size());
+  for (auto &capacity : executors.capacities) {
+    key.add(capacity.memory);
+    key.add(capacity.slots);
+  }
+  return hashBytes(key.bytes.data(), key.bytes.size());
+}
+
+bool load_cached_plan(const std::filesystem::path &directory,
+                      const PlanKey &key, Graph &graph,
+                      CriticalPath &criticalPath) {
+  const auto file = entryPath(directory, key);
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(file, error)) {
+    return false;
+  }
+  Schedule scheduled;
+  std::vector<Id> criticalIds;
+  Header header;
+  try {
+    MappedFile mappedFile(file);
+    auto data = mappedFile.data();
+    if (data.size() < sizeof(Header) ||
+        std::memcmp(data.data(), signature, sizeof(signature)) != 0) {
+      throw std::runtime_error("Not a plan cache entry.");
+    }
+    std::memcpy(&header,
+                binary_io::readBytes(data, sizeof(Header), formatName),
+                sizeof(Header));
+    if (header.version != formatVersion || header.byteOrder != byteOrderMark ||
+        header.key != key || header.actionsNumber != graph.size() ||
+        hashBytes(data.data(), data.size()) != header.checksum) {
+      throw std::runtime_error("Plan cache entry is damaged.");
+    }
+    auto read = [&](int64_t count, auto &array) {
+      binary_io::readArray(data, count, array, formatName);
+    };
+    read(header.actionsNumber, scheduled.startTimes);
+    read(header.actionsNumber, scheduled.endTimes);
+    read(header.actionsNumber, scheduled.executorIds);
+    read(header.criticalPathSize, criticalIds);
+    for (Id id : criticalIds) {
+      if (id <= graph.startId() || id >= graph.endId()) {
+        throw std::runtime_error("Plan cache entry is damaged.");
+      }
+    }
+  } catch (const std::runtime_error &) {
+    std::filesystem::remove(file, error);
+    return false;
+  }
+  // The entry becomes the most recently used for eviction
+  std::filesystem::last_write_time(
+      file, std::filesystem::file_time_type::clock::now(), error);
+
+  graph.startTimes = std::move(scheduled.startTimes);
+  graph.endTimes = std::move(scheduled.endTimes);
+  graph.executorIds = std::move(scheduled.executorIds);
+  criticalPath.infiniteExecutorsLength = header.infiniteExecutorsLength;
+  criticalPath.actualExecutorsLength = header.actualExecutorsLength;
+  criticalPath.actionsShas.clear();
+  criticalPath.actionsShas.reserve(criticalIds.size());
+  for (Id id : criticalIds) {
+    criticalPath.actionsShas.emplace_back(graph.shas[id]);
+  }
+  return true;
+}
+
+void save_cached_plan(const std::filesystem::path &directory,
+                      const PlanKey &key, const Graph &graph,
+                      const CriticalPath &criticalPath, uint64_t maxBytes) {
+  std::vector<Id> criticalIds;
+  criticalIds.reserve(criticalPath.actionsShas.size());
+  for (auto &sha : criticalPath.actionsShas) {
+    criticalIds.push_back(graph.at(sha));
+  }
+  // Arrays are laid out in memory as in the file to take their checksum
+  std::string arrays;
+  binary_io::appendArray(arrays, graph.startTimes);
+  binary_io::appendArray(arrays, graph.endTimes);
+  binary_io::appendArray(arrays, graph.executorIds);
+  binary_io::appendArray(arrays, criticalIds);
+
+  Header header{};
+  std::memcpy(header.signature, signature, sizeof(signature));
+  header.version = formatVersion;
+  header.byteOrder = byteOrderMark;
+  header.key = key;
+  header.checksum = hashBytes(arrays.data(), arrays.size());
+  header.actionsNumber = graph.size();
+  header.criticalPathSize = criticalIds.size();
+  header.infiniteExecutorsLength = criticalPath.infiniteExecutorsLength;
+  header.actualExecutorsLength = criticalPath.actualExecutorsLength;
+
+  std::filesystem::create_directories(directory);
+  binary_io::replaceFile(
+      entryPath(directory, key),
+      {{reinterpret_cast<const char *>(&header), sizeof(header)}, arrays},
+      formatName);
+  evict(directory, key, maxBytes);
+}
+
+} // namespace builder
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "action.h"
+#include "executors.h"
+#include "graph.h"
+#include "heft.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace builder {
+
+/// @brief 128-bit digest of everything a plan depends on
+struct PlanKey {
+  uint64_t low{0};
+  uint64_t high{0};
+
+  bool operator==(const PlanKey &other) const {
+    return low == other.low && high == other.high;
+  }
+  bool operator!=(const PlanKey &other) const { return !(*this == other); }
+
+  /// @brief 32 hex digits, the name of the cache entry
+  std::string hex() const;
+};
+
+/// @brief Hash everything of the graph a plan depends on: SHAs, durations,
+/// resource demands and dependencies with their data sizes. The arrays are
+/// cut into blocks hashed by several threads, digests of the blocks are
+/// combined in order, so the hash doesn't depend on the number of threads.
+/// Deviations and ranks are not hashed, ranks are made of the rest.
+/// @param graph actions graph
+/// @param threadsNumber number of threads to hash with, 0 for all hardware
+/// threads
+/// @return digest of the graph
+PlanKey hashGraph(const Graph &graph, unsigned threadsNumber = 0);
+
+/// @brief Key of the plan of a graph made with given parameters
+/// @param graphHash digest from hashGraph()
+/// @param executors executors the graph is scheduled on
+/// @param scheduler name of the scheduler, see makeScheduler()
+/// @param placement placement of actions on executors
+/// @return digest of the graph, the parameters and the cache format version
+PlanKey makePlanKey(const PlanKey &graphHash, const Executors &executors,
+                    std::string_view scheduler, Placement placement);
+
+/// @brief Load plan from a cache directory into the graph. Entries which are
+/// truncated, damaged or don't fit the graph are removed and count as
+/// missing. The found entry becomes the most recently used.
+/// @param directory cache directory
+/// @param key key of the plan from makePlanKey()
+/// @param graph [in, out] actions graph the key was made of, gets start and
+/// end times and executors of the plan
+/// @param criticalPath [out] critical path of the plan
+/// @return true if the plan was found
+bool load_cached_plan(const std::filesystem::path &directory,
+                      const PlanKey &key, Graph &graph,
+                      CriticalPath &criticalPath);
+
+/// @brief Save plan of the graph to a cache directory, which is created if
+/// it doesn't exist. The entry is written aside and renamed into place, so
+/// that readers never see it half written. Then the least recently used
+/// entries are removed while the cache is larger than maxBytes, the new
+/// entry is always kept.
+/// @param directory cache directory
+/// @param key key of the plan from makePlanKey()
+/// @param graph actions graph after schedule()
+/// @param criticalPath critical path of the plan from getCriticalPath()
+/// @param maxBytes largest total size of cache entries. Throws
+/// std::runtime_error or std::filesystem::filesystem_error if the entry can't
+/// be written, its temporary file is removed then.
+void save_cached_plan(const std::filesystem::path &directory,
+                      const PlanKey &key, const Graph &graph,
+                      const CriticalPath &criticalPath, uint64_t maxBytes);
+
+} // namespace builder
@@ -0,0 +1,64 @@
+#include "resource_timeline.h"
+
+#include <iterator>
+
+namespace builder {
+
+ResourceTimeline::ResourceTimeline(Resources capacity) : capacity_(capacity) {
+  usage_.emplace(0, Resources{});
+}
+
+bool ResourceTimeline::fitsWith(const Resources &used,
+                                Resources demand) const {
+  return (capacity_.memory <= 0 ||
+          used.memory + demand.memory <= capacity_.memory) &&
+         (capacity_.slots <= 0 ||
+          used.slots + demand.slots <= capacity_.slots);
+}
+
+bool ResourceTimeline::fits(Resources demand) const {
+  return fitsWith(Resources{}, demand);
+}
+
+Time ResourceTimeline::findStart(Time readyTime, Time duration,
+                                 Resources demand) const {
+  if (duration <= 0) {
+    return readyTime;
+  }
+  // Step containing the start, the first step is at time zero
+  auto step = std::prev(usage_.upper_bound(readyTime));
+  Time start = readyTime;
+  // Usage after the last step is zero, so the demand fits there
+  for (auto next = std::next(step); next != usage_.end();
+       step = next, ++next) {
+    if (step->first >= start + duration) {
+      break;
+    }
+    if (!fitsWith(step->second, demand)) {
+      // Nothing starting within this step fits, try from its end
+      start = next->first;
+    }
+  }
+  return start;
+}
+
+void ResourceTimeline::occupy(Time start, Time duration, Resources demand) {
+  if (duration <= 0) {
+    return;
+  }
+  // Steps begin at the start and at the end of the interval
+  auto stepAt = [&](Time time) {
+    auto step = std::prev(usage_.upper_bound(time));
+    if (step->first == time) {
+      return step;
+    }
+    return usage_.emplace_hint(std::next(step), time, step->second);
+  };
+  const auto end = stepAt(start + duration);
+  for (auto step = stepAt(start); step != end; ++step) {
+    step->second.memory += demand.memory;
+    step->second.slots += demand.slots;
+  }
+}
+
+} // namespace builder
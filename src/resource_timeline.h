@@ -0,0 +1,45 @@
+#pragma once
+
+#include "action.h"
+#include "graph.h"
+
+#include <map>
+
+namespace builder {
+
+/// @brief Resources in use on a node over time, used to keep actions running
+/// at once on the node within its capacity. Usage is a step function kept in
+/// an ordered map from the time it changes to the usage from that time on,
+/// so a search or an update takes logarithmic time plus the number of steps
+/// within the action.
+class ResourceTimeline {
+public:
+  /// @brief Create timeline of a node with nothing in use
+  /// @param capacity resources of the node, zero amounts are unlimited
+  explicit ResourceTimeline(Resources capacity);
+
+  /// @brief Check if the demand fits into the capacity of an idle node
+  bool fits(Resources demand) const;
+
+  /// @brief Find earliest start time of an action on the node
+  /// @param readyTime earliest time the action can start at
+  /// @param duration duration of the action
+  /// @param demand resources of the action, they must fit()
+  /// @return earliest time not before readyTime, when the demand fits into
+  /// the free resources for the whole duration
+  Time findStart(Time readyTime, Time duration, Resources demand) const;
+
+  /// @brief Take resources for a time interval, e.g. returned by findStart()
+  /// @param start start time of the interval
+  /// @param duration length of the interval
+  /// @param demand resources taken
+  void occupy(Time start, Time duration, Resources demand);
+
+private:
+  bool fitsWith(const Resources &used, Resources demand) const;
+
+  Resources capacity_;
+  std::map<Time, Resources> usage_{}; ///< usage from the key time on
+};
+
+} // namespace builder
@@ -0,0 +1,277 @@
+#include "schedulers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace builder {
+
+namespace {
+
+/// @brief Average cost of action over all executors as used by ranks
+Time averageCost(const Executors &executors, const Graph &graph, Id id) {
+  return executors.isUniform() ? graph.durations[id]
+                               : executors.averageCost(graph, id);
+}
+
+/// @brief Order actions by priority, at every step the ready action with the
+/// highest priority is taken, the earlier declared one for equal priorities
+/// @param priorities priorities of actions indexed by Id
+/// @return pairs of priority and Id without phony Start and End actions
+RankIds listOrder(const Graph &graph, const std::vector<Time> &priorities) {
+  auto lower = [](const std::pair<Time, Id> &lhs,
+                  const std::pair<Time, Id> &rhs) {
+    return lhs.first < rhs.first ||
+           (lhs.first == rhs.first && lhs.second > rhs.second);
+  };
+  std::priority_queue<std::pair<Time, Id>, std::vector<std::pair<Time, Id>>,
+                      decltype(lower)>
+      ready(lower);
+  std::vector<Id> remainingDependencies(graph.size());
+  for (Id id = 0; id < graph.size(); ++id) {
+    remainingDependencies[id] = graph.dependencies.size(id);
+  }
+  RankIds order;
+  order.reserve(graph.size());
+  ready.emplace(priorities[graph.startId()], graph.startId());
+  while (!ready.empty()) {
+    const auto [priority, id] = ready.top();
+    ready.pop();
+    if (id != graph.startId()) {
+      order.emplace_back(priority, id);
+    }
+    for (auto dependent = graph.dependents.begin(id);
+         dependent != graph.dependents.end(id); ++dependent) {
+      if (--remainingDependencies[*dependent] == 0 &&
+          *dependent != graph.endId()) {
+        ready.emplace(priorities[*dependent], *dependent);
+      }
+    }
+  }
+  return order;
+}
+
+class HeftScheduler : public Scheduler {
+public:
+  std::string_view name() const override { return "heft"; }
+
+  std::string_view schedule(const Executors &executors, Graph &graph,
+                            Placement placement) const override {
+    builder::schedule(executors, computeRankIds(graph), graph, placement);
+    return name();
+  }
+};
+
+class CpopScheduler : public Scheduler {
+public:
+  std::string_view name() const override { return "cpop"; }
+
+  std::string_view schedule(const Executors &executors, Graph &graph,
+                            Placement placement) const override {
+    // Downward rank is the longest path from the Start to the action without
+    // the action itself, priority is the length of the longest path through
+    // the action
+    const bool withTransfers =
+        executors.hasTransferCosts() && !graph.dependencies.dataSizes.empty();
+    const double sameNode = executors.sameNodeProbability();
+    std::vector<Time> priorities(graph.size(), 0);
+    for (Id id = graph.startId() + 1; id < graph.size(); ++id) {
+      Time downwardRank{0};
+      for (Offset edge = graph.dependencies.offsets[id];
+           edge < graph.dependencies.offsets[id + 1]; ++edge) {
+        const Id dependency = graph.dependencies.targets[edge];
+        downwardRank = std::max(
+            downwardRank,
+            priorities[dependency] + averageCost(executors, graph, dependency) +
+                (withTransfers ? executors.averageTransferCost(
+                                     graph.dependencies.dataSizes[edge],
+                                     sameNode)
+                               : 0));
+      }
+      priorities[id] = downwardRank;
+    }
+    for (Id id = 0; id < graph.size(); ++id) {
+      priorities[id] += graph.ranks[id];
+    }
+
+    // Critical path goes from the Start through dependents of the highest
+    // priority, it's run on the executor class running it the fastest
+    std::vector<Id> criticalPath;
+    for (Id id = graph.startId(); id != graph.endId();) {
+      Id next{-1};
+      for (auto dependent = graph.dependents.begin(id);
+           dependent != graph.dependents.end(id); ++dependent) {
+        if (next < 0 || priorities[*dependent] > priorities[next]) {
+          next = *dependent;
+        }
+      }
+      if (next != graph.endId()) {
+        criticalPath.push_back(next);
+      }
+      id = next;
+    }
+    size_t bestClass{0};
+    Time bestCost{0};
+    for (size_t classIndex = 0; classIndex < executors.classes.size();
+         ++classIndex) {
+      Time pathCost{0};
+      for (Id id : criticalPath) {
+        pathCost += executors.cost(graph, id, classIndex);
+      }
+      if (classIndex == 0 || pathCost < bestCost) {
+        bestClass = classIndex;
+        bestCost = pathCost;
+      }
+    }
+    PlacementHints hints;
+    hints.pinnedExecutors.assign(graph.size(), -1);
+    for (Id id : criticalPath) {
+      hints.pinnedExecutors[id] = executors.classes[bestClass].firstExecutor;
+    }
+    builder::schedule(executors, listOrder(graph, priorities), graph,
+                      placement, hints);
+    return name();
+  }
+};
+
+class PeftScheduler : public Scheduler {
+public:
+  std::string_view name() const override { return "peft"; }
+
+  std::string_view schedule(const Executors &executors, Graph &graph,
+                            Placement placement) const override {
+    // Optimistic cost table: the longest of the shortest paths from
+    // dependents of the action to the End when the action runs on a class,
+    // passing data to another class takes the average transfer time
+    const size_t classesNumber = executors.classes.size();
+    const bool withTransfers =
+        executors.hasTransferCosts() && !graph.dependents.dataSizes.empty();
+    const double sameNode = executors.sameNodeProbability();
+    auto cost = [&](Id id, size_t classIndex) -> Time {
+      // The phony End is not run
+      return id == graph.endId() ? 0 : executors.cost(graph, id, classIndex);
+    };
+    std::vector<Time> table(graph.size() * classesNumber, 0);
+    std::vector<Time> priorities(graph.size(), 0);
+    for (Id id = graph.endId() - 1; id >= graph.startId(); --id) {
+      Time *row = table.data() + id * classesNumber;
+      for (Offset edge = graph.dependents.offsets[id];
+           edge < graph.dependents.offsets[id + 1]; ++edge) {
+        const Id dependent = graph.dependents.targets[edge];
+        const Time *dependentRow = table.data() + dependent * classesNumber;
+        Time shortest{0};
+        for (size_t classIndex = 0; classIndex < classesNumber; ++classIndex) {
+          const Time length =
+              dependentRow[classIndex] + cost(dependent, classIndex);
+          shortest = classIndex == 0 ? length : std::min(shortest, length);
+        }
+        const Time transfer =
+            withTransfers
+                ? executors.averageTransferCost(
+                      graph.dependents.dataSizes[edge], sameNode)
+                : 0;
+        for (size_t classIndex = 0; classIndex < classesNumber; ++classIndex) {
+          row[classIndex] = std::max(
+              row[classIndex],
+              std::min(shortest + transfer,
+                       dependentRow[classIndex] + cost(dependent, classIndex)));
+        }
+      }
+      // Rank is the average over all executors
+      double rank{0};
+      for (size_t classIndex = 0; classIndex < classesNumber; ++classIndex) {
+        rank += static_cast<double>(row[classIndex]) *
+                executors.classes[classIndex].count;
+      }
+      priorities[id] = std::llround(rank / executors.size());
+    }
+
+    PlacementHints hints;
+    hints.classBiases = std::move(table);
+    builder::schedule(executors, listOrder(graph, priorities), graph,
+                      placement, hints);
+    return name();
+  }
+};
+
+class LookaheadScheduler : public Scheduler {
+public:
+  std::string_view name() const override { return "lookahead"; }
+
+  std::string_view schedule(const Executors &executors, Graph &graph,
+                            Placement) const override {
+    scheduleWithLookahead(executors, computeRankIds(graph), graph);
+    return name();
+  }
+};
+
+class BestScheduler : public Scheduler {
+public:
+  std::string_view name() const override { return "best"; }
+
+  std::string_view schedule(const Executors &executors, Graph &graph,
+                            Placement placement) const override {
+    std::string_view bestName{};
+    Time bestMakespan{0};
+    std::vector<Time> startTimes, endTimes;
+    std::vector<Id> executorIds;
+    for (auto schedulerName : schedulerNames()) {
+      if (schedulerName == name()) {
+        continue;
+      }
+      makeScheduler(schedulerName)->schedule(executors, graph, placement);
+      const Time length = makespan(graph);
+      if (bestName.empty() || length < bestMakespan) {
+        bestName = schedulerName;
+        bestMakespan = length;
+        startTimes = graph.startTimes;
+        endTimes = graph.endTimes;
+        executorIds = graph.executorIds;
+      }
+    }
+    graph.startTimes = std::move(startTimes);
+    graph.endTimes = std::move(endTimes);
+    graph.executorIds = std::move(executorIds);
+    return bestName;
+  }
+};
+
+} // namespace
+
+const std::vector<std::string_view> &schedulerNames() {
+  static const std::vector<std::string_view> names{"heft", "cpop", "peft",
+                                                   "lookahead", "best"};
+  return names;
+}
+
+std::unique_ptr<Scheduler> makeScheduler(std::string_view name) {
+  if (name == "heft") {
+    return std::make_unique<HeftScheduler>();
+  }
+  if (name == "cpop") {
+    return std::make_unique<CpopScheduler>();
+  }
+  if (name == "peft") {
+    return std::make_unique<PeftScheduler>();
+  }
+  if (name == "lookahead") {
+    return std::make_unique<LookaheadScheduler>();
+  }
+  if (name == "best") {
+    return std::make_unique<BestScheduler>();
+  }
+  throw std::runtime_error("Unknown scheduler '" + std::string(name) +
+                           "', must be heft, cpop, peft, lookahead or best.");
+}
+
+Time makespan(const Graph &graph) {
+  return graph.size() ? *std::max_element(graph.endTimes.begin(),
+                                          graph.endTimes.end())
+                      : 0;
+}
+
+} // namespace builder
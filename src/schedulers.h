@@ -0,0 +1,55 @@
+#pragma once
+
+#include "action.h"
+#include "executors.h"
+#include "graph.h"
+#include "heft.h"
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace builder {
+
+/// @brief List scheduling algorithm planning actions of a graph on executors
+class Scheduler {
+public:
+  virtual ~Scheduler() = default;
+
+  /// @brief Name the scheduler is selected by
+  virtual std::string_view name() const = 0;
+
+  /// @brief Schedule actions, start and finish times and executors of
+  /// actions are written to the graph
+  /// @param executors [in] executors to plan execution on
+  /// @param graph [in, out] actions graph after calculateRanks() for the
+  /// executors, ranks and critical path are not changed
+  /// @param placement [in] how actions are placed on executors, if the
+  /// algorithm supports it
+  /// @return name of the algorithm which made the plan
+  virtual std::string_view schedule(const Executors &executors, Graph &graph,
+                                    Placement placement) const = 0;
+};
+
+/// @brief Names of all schedulers in order of makeScheduler():
+///   heft - HEFT with upward ranks, the default
+///   cpop - Critical Path On a Processor, actions of the critical path by
+///     upward plus downward ranks are pinned to the executor which runs them
+///     the fastest
+///   peft - Predict Earliest Finish Time, ranks and placement use the
+///     optimistic cost table of remaining path lengths on every executor
+///     class
+///   lookahead - HEFT placing actions where their children finish the
+///     earliest, always appends
+///   best - all of the above, the plan with the shortest makespan is kept
+const std::vector<std::string_view> &schedulerNames();
+
+/// @brief Create scheduler by name
+/// @param name one of schedulerNames()
+/// @return scheduler, throws std::runtime_error for unknown name
+std::unique_ptr<Scheduler> makeScheduler(std::string_view name);
+
+/// @brief Finish time of the last action of the scheduled graph
+Time makespan(const Graph &graph);
+
+} // namespace builder
@@ -0,0 +1,475 @@
+#include "server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace builder {
+
+namespace {
+
+bool rankOrder(const std::pair<Time, Id> &lhs, const std::pair<Time, Id> &rhs) {
+  return lhs.first > rhs.first ||
+         (lhs.first == rhs.first && lhs.second < rhs.second);
+}
+
+/// @brief Split arguments of request by spaces and tabs
+std::vector<std::string_view> splitArguments(std::string_view arguments) {
+  std::vector<std::string_view> words;
+  size_t position{0};
+  while (true) {
+    position = arguments.find_first_not_of(" \t\r", position);
+    if (position == std::string_view::npos) {
+      return words;
+    }
+    const size_t end = std::min(arguments.find_first_of(" \t\r", position),
+                                arguments.size());
+    words.push_back(arguments.substr(position, end - position));
+    position = end;
+  }
+}
+
+template <typename Number>
+Number parseNumber(std::string_view word, const char *what) {
+  Number number{0};
+  const auto result =
+      std::from_chars(word.data(), word.data() + word.size(), number);
+  if (result.ec != std::errc() || result.ptr != word.data() + word.size()) {
+    throw std::runtime_error(std::string(what) + " must be an integer, got '" +
+                             std::string(word) + "'");
+  }
+  return number;
+}
+
+void appendNumber(std::string &response, int64_t number) {
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+  response.append(digits, result.ptr);
+}
+
+void appendOk(std::string &response, int64_t number) {
+  response.append("ok ");
+  appendNumber(response, number);
+  response.push_back('\n');
+}
+
+Time makespanOf(const Schedule &scheduled) {
+  return scheduled.endTimes.empty() ? 0
+                                    : *std::max_element(
+                                          scheduled.endTimes.begin(),
+                                          scheduled.endTimes.end());
+}
+
+} // namespace
+
+PlanningServer::PlanningServer(Graph graph, Placement placement,
+                               unsigned threadsNumber)
+    : graph_(std::move(graph)), placement_(placement) {
+  if (!graph_.ranksCalculated) {
+    // Ranks of identical executors don't depend on their number
+    calculateRanks(graph_, Executors::identical(1), threadsNumber);
+  }
+  rankIds_ = computeRankIds(graph_);
+}
+
+void PlanningServer::handle(std::string_view request, std::string &response) {
+  const auto words = request.find_first_not_of(" \t\r");
+  if (words == std::string_view::npos) {
+    response.append("error empty request\n");
+    return;
+  }
+  request.remove_prefix(words);
+  const auto kind = request.substr(0, request.find_first_of(" \t\r"));
+  const auto arguments = request.substr(kind.size());
+  const size_t responseSize = response.size();
+  try {
+    if (kind == "schedule") {
+      schedule(arguments, response);
+    } else if (kind == "makespan") {
+      makespan(arguments, response);
+    } else if (kind == "critical-path") {
+      criticalPath(arguments, response);
+    } else if (kind == "update") {
+      update(arguments, response);
+    } else {
+      throw std::runtime_error("unknown request '" + std::string(kind) +
+                               "', must be schedule, makespan, "
+                               "critical-path or update");
+    }
+  } catch (std::exception &e) {
+    // Lines of a partial response are discarded
+    response.resize(responseSize);
+    response.append("error ").append(e.what()).push_back('\n');
+  }
+}
+
+namespace {
+
+/// @brief Parse number of executors, more executors than actions are never
+/// used, so the number is limited by the number of actions
+Id parseExecutorsNumber(std::string_view word, const Graph &graph) {
+  const auto number = parseNumber<int64_t>(word, "Number of executors");
+  if (number < 1) {
+    throw std::runtime_error("Number of executors must be positive, got " +
+                             std::to_string(number));
+  }
+  return static_cast<Id>(std::min<int64_t>(number, std::max(1, graph.size())));
+}
+
+} // namespace
+
+void PlanningServer::schedule(std::string_view arguments,
+                              std::string &response) const {
+  const auto words = splitArguments(arguments);
+  if (words.size() != 1) {
+    throw std::runtime_error("schedule expects number of executors");
+  }
+  std::shared_lock lock(mutex_);
+  const Id executorsNumber = parseExecutorsNumber(words[0], graph_);
+  Schedule scheduled;
+  builder::schedule(Executors::identical(executorsNumber), rankIds_, graph_,
+                    scheduled, placement_);
+  for (Id id : getExecutionOrder(graph_, scheduled)) {
+    response.append(graph_.shas[id]).push_back(' ');
+    appendNumber(response, scheduled.startTimes[id]);
+    response.push_back(' ');
+    appendNumber(response, scheduled.executorIds[id]);
+    response.push_back('\n');
+  }
+  appendOk(response, makespanOf(scheduled));
+}
+
+void PlanningServer::makespan(std::string_view arguments,
+                              std::string &response) const {
+  const auto words = splitArguments(arguments);
+  if (words.empty()) {
+    throw std::runtime_error("makespan expects number of executors");
+  }
+  std::shared_lock lock(mutex_);
+  const Id executorsNumber = parseExecutorsNumber(words[0], graph_);
+  Schedule scheduled;
+  if (words.size() == 1) {
+    builder::schedule(Executors::identical(executorsNumber), rankIds_, graph_,
+                      scheduled, placement_);
+    appendOk(response, makespanOf(scheduled));
+    return;
+  }
+
+  // Only the targets and actions they depend on are scheduled, in the order
+  // of ranks of the whole graph
+  std::vector<bool> inCone(graph_.size(), false);
+  std::vector<Id> cone;
+  for (size_t i = 1; i < words.size(); ++i) {
+    const Id id = graph_.at(words[i]);
+    if (!inCone[id]) {
+      inCone[id] = true;
+      cone.push_back(id);
+    }
+  }
+  for (size_t i = 0; i < cone.size(); ++i) {
+    for (auto dependency = graph_.dependencies.begin(cone[i]);
+         dependency != graph_.dependencies.end(cone[i]); ++dependency) {
+      if (!inCone[*dependency]) {
+        inCone[*dependency] = true;
+        cone.push_back(*dependency);
+      }
+    }
+  }
+  RankIds coneRankIds;
+  coneRankIds.reserve(cone.size());
+  for (auto &rankId : rankIds_) {
+    if (inCone[rankId.second]) {
+      coneRankIds.push_back(rankId);
+    }
+  }
+  builder::schedule(Executors::identical(executorsNumber), coneRankIds, graph_,
+                    scheduled, placement_);
+  appendOk(response, makespanOf(scheduled));
+}
+
+void PlanningServer::criticalPath(std::string_view arguments,
+                                  std::string &response) const {
+  if (!splitArguments(arguments).empty()) {
+    throw std::runtime_error("critical-path expects no arguments");
+  }
+  std::shared_lock lock(mutex_);
+  Time length{0};
+  if (graph_.size() > 2) {
+    const Id first = graph_.predecessors[graph_.startId()];
+    length = graph_.longestPaths[first];
+    for (Id id = first; id != graph_.endId(); id = graph_.predecessors[id]) {
+      response.append(graph_.shas[id]).push_back('\n');
+    }
+  }
+  appendOk(response, length);
+}
+
+void PlanningServer::update(std::string_view arguments,
+                            std::string &response) {
+  const auto words = splitArguments(arguments);
+  if (words.empty() || words.size() % 2 != 0) {
+    throw std::runtime_error("update expects pairs of action SHA and duration");
+  }
+  std::unique_lock lock(mutex_);
+  // All durations are checked before any of them is changed
+  std::vector<std::pair<Id, Duration>> changes;
+  for (size_t i = 0; i < words.size(); i += 2) {
+    const Id id = graph_.at(words[i]);
+    if (id == graph_.startId() || id == graph_.endId()) {
+      throw std::runtime_error("Duration of phony action " +
+                               std::string(words[i]) + " can't be changed");
+    }
+    const auto duration = parseNumber<Duration>(words[i + 1], "Duration");
+    if (duration <= 0) {
+      throw std::runtime_error("Duration of action " + std::string(words[i]) +
+                               " must be positive, got " +
+                               std::to_string(duration));
+    }
+    changes.emplace_back(id, duration);
+  }
+
+  // Ancestor cone of the changed actions, ranks of other actions don't change
+  std::vector<bool> inCone(graph_.size(), false);
+  std::vector<Id> cone;
+  for (auto [id, duration] : changes) {
+    graph_.durations[id] = duration;
+    if (!inCone[id]) {
+      inCone[id] = true;
+      cone.push_back(id);
+    }
+  }
+  const auto changedNumber = static_cast<int64_t>(cone.size());
+  for (size_t i = 0; i < cone.size(); ++i) {
+    for (auto dependency = graph_.dependencies.begin(cone[i]);
+         dependency != graph_.dependencies.end(cone[i]); ++dependency) {
+      if (!inCone[*dependency]) {
+        inCone[*dependency] = true;
+        cone.push_back(*dependency);
+      }
+    }
+  }
+  std::sort(cone.begin(), cone.end(), std::greater<>());
+  recalculateRanks(graph_, Executors::identical(1), cone);
+
+  // Merge actions with unchanged ranks, which are still in order, with
+  // actions of the cone
+  RankIds rankIds;
+  rankIds.reserve(rankIds_.size());
+  RankIds recalculated;
+  for (Id id : cone) {
+    if (id != graph_.startId() && id != graph_.endId()) {
+      recalculated.emplace_back(graph_.ranks[id], id);
+    }
+  }
+  std::sort(recalculated.begin(), recalculated.end(), rankOrder);
+  auto kept = rankIds_.begin();
+  for (auto &rankId : rankIds_) {
+    if (!inCone[rankId.second]) {
+      *kept++ = rankId;
+    }
+  }
+  std::merge(rankIds_.begin(), kept, recalculated.begin(), recalculated.end(),
+             std::back_inserter(rankIds), rankOrder);
+  rankIds_ = std::move(rankIds);
+  appendOk(response, changedNumber);
+}
+
+namespace {
+
+/// @brief Request of a client which isn't answered by the server
+enum class Control { None, Quit, Shutdown };
+
+Control controlOf(std::string_view request) {
+  const auto begin = request.find_first_not_of(" \t\r");
+  if (begin == std::string_view::npos) {
+    return Control::None;
+  }
+  const auto end = request.find_last_not_of(" \t\r");
+  const auto word = request.substr(begin, end - begin + 1);
+  if (word == "quit") {
+    return Control::Quit;
+  }
+  if (word == "shutdown") {
+    return Control::Shutdown;
+  }
+  return Control::None;
+}
+
+} // namespace
+
+void run_server(PlanningServer &server, std::istream &requests,
+                std::ostream &responses) {
+  std::string request{};
+  std::string response{};
+  while (std::getline(requests, request)) {
+    if (controlOf(request) != Control::None) {
+      return;
+    }
+    if (request.find_first_not_of(" \t\r") == std::string::npos) {
+      // Empty lines with only whitespaces are discarded
+      continue;
+    }
+    response.clear();
+    server.handle(request, response);
+    responses << response;
+    responses.flush();
+  }
+}
+
+#if defined(_WIN32)
+
+void serve_unix_socket(PlanningServer &, const std::filesystem::path &) {
+  throw std::runtime_error(
+      "Unix domain sockets are not supported on this platform, serve on "
+      "standard input and output instead.");
+}
+
+#else
+
+namespace {
+
+std::runtime_error socketError(const std::string &message) {
+  return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+bool sendAll(int connection, std::string_view data) {
+#if defined(MSG_NOSIGNAL)
+  const int flags{MSG_NOSIGNAL};
+#else
+  const int flags{0};
+#endif
+  while (!data.empty()) {
+    const auto sent = ::send(connection, data.data(), data.size(), flags);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(sent));
+  }
+  return true;
+}
+
+/// @brief Answer requests of one client till it disconnects or quits
+/// @return true if the client requested shutdown of the server
+bool serveConnection(PlanningServer &server, int connection) {
+  std::string received{};
+  std::string response{};
+  char buffer[1 << 16];
+  while (true) {
+    const auto size = ::recv(connection, buffer, sizeof(buffer), 0);
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size <= 0) {
+      return false;
+    }
+    received.append(buffer, static_cast<size_t>(size));
+    size_t begin{0};
+    response.clear();
+    for (size_t end = received.find('\n'); end != std::string::npos;
+         begin = end + 1, end = received.find('\n', begin)) {
+      const std::string_view request(received.data() + begin, end - begin);
+      const auto control = controlOf(request);
+      if (control != Control::None) {
+        sendAll(connection, response);
+        return control == Control::Shutdown;
+      }
+      if (request.find_first_not_of(" \t\r") != std::string_view::npos) {
+        server.handle(request, response);
+      }
+    }
+    received.erase(0, begin);
+    if (!sendAll(connection, response)) {
+      return false;
+    }
+  }
+}
+
+} // namespace
+
+void serve_unix_socket(PlanningServer &server,
+                       const std::filesystem::path &path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const auto &name = path.native();
+  if (name.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path '" + path.string() +
+                             "' is too long.");
+  }
+  std::memcpy(address.sun_path, name.c_str(), name.size() + 1);
+
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw socketError("Couldn't create socket");
+  }
+  ::unlink(name.c_str());
+  if (::bind(listener, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listener, SOMAXCONN) != 0) {
+    const auto error =
+        socketError("Couldn't listen on '" + path.string() + "'");
+    ::close(listener);
+    throw error;
+  }
+
+  // Connections are served by detached threads, which are counted so that
+  // the server returns when the last of them is finished
+  std::mutex mutex;
+  std::condition_variable finished;
+  size_t connectionsNumber{0};
+  std::atomic<bool> stopping{false};
+  while (true) {
+    const int connection = ::accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+      if (stopping) {
+        break;
+      }
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      const auto error = socketError("Couldn't accept connection");
+      std::unique_lock lock(mutex);
+      finished.wait(lock, [&] { return connectionsNumber == 0; });
+      ::close(listener);
+      throw error;
+    }
+    {
+      std::lock_guard lock(mutex);
+      ++connectionsNumber;
+    }
+    std::thread([&, connection]() {
+      if (serveConnection(server, connection) && !stopping.exchange(true)) {
+        // Wakes accept() up
+        ::shutdown(listener, SHUT_RDWR);
+      }
+      ::close(connection);
+      std::lock_guard lock(mutex);
+      --connectionsNumber;
+      finished.notify_all();
+    }).detach();
+  }
+  std::unique_lock lock(mutex);
+  finished.wait(lock, [&] { return connectionsNumber == 0; });
+  ::close(listener);
+  ::unlink(name.c_str());
+}
+
+#endif
+
+} // namespace builder
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "action.h"
+#include "graph.h"
+#include "heft.h"
+
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace builder {
+
+/// @brief Resident planner which keeps the graph with its ranks in memory
+/// and answers queries on it. Every request is a line, the response is zero
+/// or more lines followed by a line starting with "ok" or "error":
+///   schedule executors
+///     plan lines 'action_sha start_time executor' in order of start times,
+///     then 'ok makespan'
+///   makespan executors [target_sha...]
+///     'ok makespan' of the plan of all actions, or of the actions the
+///     targets depend on only
+///   critical-path
+///     SHAs of the critical path in order of execution, then 'ok length'
+///   update action_sha duration [action_sha duration...]
+///     changes durations and ranks, then 'ok number_of_changed_actions'
+/// Queries on identical executors are served concurrently, updates wait for
+/// running queries and queries wait for a running update.
+class PlanningServer {
+public:
+  /// @brief Create server for the graph, ranks are calculated if they aren't
+  /// @param graph actions graph
+  /// @param placement how actions are placed on executors
+  /// @param threadsNumber number of threads to calculate ranks with, 0 for
+  /// all hardware threads
+  PlanningServer(Graph graph, Placement placement, unsigned threadsNumber);
+
+  /// @brief Answer request, it can be called from several threads at once
+  /// @param request request line without the new line character
+  /// @param response [out] response lines ending with a new line, the
+  /// response of a wrong request is 'error message'
+  void handle(std::string_view request, std::string &response);
+
+private:
+  void schedule(std::string_view arguments, std::string &response) const;
+  void makespan(std::string_view arguments, std::string &response) const;
+  void criticalPath(std::string_view arguments, std::string &response) const;
+  void update(std::string_view arguments, std::string &response);
+
+  mutable std::shared_mutex mutex_{}; ///< shared by queries, unique by updates
+  Graph graph_;
+  RankIds rankIds_{};
+  Placement placement_;
+};
+
+/// @brief Serve requests read line by line from the input stream, responses
+/// are flushed after every request. Returns at the end of input or on 'quit'
+/// request.
+/// @param server server to answer requests
+/// @param requests input stream of requests
+/// @param responses output stream of responses
+void run_server(PlanningServer &server, std::istream &requests,
+                std::ostream &responses);
+
+/// @brief Serve requests over a Unix domain socket, every connection is
+/// served by its own thread as run_server() does. Returns after a 'shutdown'
+/// request when all connections are closed. Throws std::runtime_error if the
+/// socket can't be created or the platform has no Unix domain sockets.
+/// @param server server to answer requests
+/// @param path path of the socket, an existing file is replaced
+void serve_unix_socket(PlanningServer &server,
+                       const std::filesystem::path &path);
+
+} // namespace builder
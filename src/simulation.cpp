@@ -0,0 +1,214 @@
+#include "simulation.h"
+#include "heft.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace builder {
+
+namespace {
+
+/// @brief Samples taken by a thread at once
+const size_t samplesBlock{16};
+
+/// @brief SplitMix64 finalizer, the generator of uniform words from counters
+uint64_t mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+/// @brief Plan laid out in order of planned start times, actions are
+/// referred to by positions in that order
+struct FlatPlan {
+  std::vector<Id> ids{};       ///< Id of action at the position
+  std::vector<Time> costs{};   ///< planned duration of action
+  std::vector<Id> previous{};  ///< previous action of the executor or -1
+  std::vector<Offset> dependencyOffsets{0};
+  std::vector<Id> dependencies{}; ///< dependencies without the phony Start
+  /// planned transfer times parallel to dependencies, empty if there are no
+  /// transfers
+  std::vector<Time> delays{};
+  // Parameters of log-normal factors of durations of varying actions
+  std::vector<Id> varying{};     ///< positions of actions with deviations
+  std::vector<double> mus{};     ///< mean of logarithm of the factor
+  std::vector<double> sigmas{};  ///< deviation of logarithm of the factor
+};
+
+FlatPlan flatten(const Graph &graph, const Executors &executors) {
+  const bool withTransfers =
+      executors.hasTransferCosts() && !graph.dependencies.dataSizes.empty();
+  const auto executorNodes = executors.executorNodes();
+  FlatPlan plan;
+  plan.ids = getExecutionOrder(graph);
+  const Id actionsNumber = static_cast<Id>(plan.ids.size());
+  std::vector<Id> positions(graph.size(), -1);
+  for (Id position = 0; position < actionsNumber; ++position) {
+    positions[plan.ids[position]] = position;
+  }
+  std::vector<Id> lastOfExecutor(executors.size(), -1);
+  plan.costs.reserve(actionsNumber);
+  plan.previous.reserve(actionsNumber);
+  plan.dependencyOffsets.reserve(actionsNumber + 1);
+  for (Id position = 0; position < actionsNumber; ++position) {
+    const Id id = plan.ids[position];
+    const Id executor = graph.executorIds[id];
+    plan.costs.push_back(graph.endTimes[id] - graph.startTimes[id]);
+    plan.previous.push_back(lastOfExecutor[executor]);
+    lastOfExecutor[executor] = position;
+    for (Offset edge = graph.dependencies.offsets[id];
+         edge < graph.dependencies.offsets[id + 1]; ++edge) {
+      const Id dependency = graph.dependencies.targets[edge];
+      if (dependency == graph.startId()) {
+        continue;
+      }
+      plan.dependencies.push_back(positions[dependency]);
+      if (withTransfers) {
+        plan.delays.push_back(executors.transferCost(
+            graph.dependencies.dataSizes[edge],
+            executorNodes[graph.executorIds[dependency]],
+            executorNodes[executor]));
+      }
+    }
+    plan.dependencyOffsets.push_back(plan.dependencies.size());
+    // Durations on executors are scaled by a factor with mean 1 and the
+    // relative deviation of the action
+    if (graph.deviation(id) > 0 && plan.costs.back() > 0) {
+      const double variation =
+          static_cast<double>(graph.deviation(id)) / graph.durations[id];
+      const double variance = std::log1p(variation * variation);
+      plan.varying.push_back(position);
+      plan.mus.push_back(-variance / 2);
+      plan.sigmas.push_back(std::sqrt(variance));
+    }
+  }
+  return plan;
+}
+
+} // namespace
+
+Time MakespanDistribution::percentile(double fraction) const {
+  if (makespans.empty()) {
+    return 0;
+  }
+  const auto rank = static_cast<size_t>(
+      std::max(1.0, std::ceil(fraction * makespans.size())));
+  return makespans[std::min(rank, makespans.size()) - 1];
+}
+
+double MakespanDistribution::mean() const {
+  double sum{0};
+  for (auto makespan : makespans) {
+    sum += static_cast<double>(makespan);
+  }
+  return makespans.empty() ? 0 : sum / makespans.size();
+}
+
+MakespanDistribution simulateMakespans(const Graph &graph,
+                                       const Executors &executors,
+                                       size_t samplesNumber, uint64_t seed,
+                                       unsigned threadsNumber) {
+  if (threadsNumber == 0) {
+    threadsNumber = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const size_t blocksNumber = (samplesNumber + samplesBlock - 1) / samplesBlock;
+  threadsNumber = static_cast<unsigned>(
+      std::max<size_t>(1, std::min<size_t>(threadsNumber, blocksNumber)));
+
+  const auto plan = flatten(graph, executors);
+  const Id actionsNumber = static_cast<Id>(plan.ids.size());
+  MakespanDistribution distribution;
+  for (Id id : plan.ids) {
+    distribution.planned = std::max(distribution.planned, graph.endTimes[id]);
+  }
+  distribution.makespans.resize(samplesNumber);
+
+  std::vector<std::vector<int64_t>> threadCounts(threadsNumber);
+  std::atomic<size_t> nextBlock{0};
+  auto work = [&](unsigned thread) {
+    auto &counts = threadCounts[thread];
+    counts.assign(actionsNumber, 0);
+    std::vector<Time> durations(actionsNumber);
+    std::vector<Time> finishes(actionsNumber);
+    std::vector<Id> criticalPrevious(actionsNumber);
+    std::vector<uint64_t> words(plan.varying.size());
+    for (size_t block = nextBlock++; block < blocksNumber;
+         block = nextBlock++) {
+      const size_t blockEnd =
+          std::min(samplesNumber, (block + 1) * samplesBlock);
+      for (size_t sample = block * samplesBlock; sample < blockEnd;
+           ++sample) {
+        // Words of a sample depend only on the seed, the sample and the
+        // counter, the loop has no dependencies between iterations
+        const uint64_t key = mix(seed ^ mix(sample));
+        for (size_t k = 0; k < words.size(); ++k) {
+          words[k] = mix(key + k);
+        }
+        std::copy(plan.costs.begin(), plan.costs.end(), durations.begin());
+        for (size_t k = 0; k < words.size(); ++k) {
+          // Box-Muller transform of the two halves of the word
+          const double u1 = ((words[k] >> 32) + 1.0) / 4294967296.0;
+          const double u2 = (words[k] & 0xFFFFFFFFu) / 4294967296.0;
+          const double normal = std::sqrt(-2 * std::log(u1)) *
+                                std::cos(6.283185307179586 * u2);
+          const Id position = plan.varying[k];
+          durations[position] = std::max<Time>(
+              1, std::llround(plan.costs[position] *
+                              std::exp(plan.mus[k] + plan.sigmas[k] * normal)));
+        }
+
+        Id last{-1};
+        Time makespan{0};
+        for (Id position = 0; position < actionsNumber; ++position) {
+          Id critical = plan.previous[position];
+          Time ready = critical >= 0 ? finishes[critical] : 0;
+          for (Offset edge = plan.dependencyOffsets[position];
+               edge < plan.dependencyOffsets[position + 1]; ++edge) {
+            const Id dependency = plan.dependencies[edge];
+            const Time finish =
+                finishes[dependency] +
+                (plan.delays.empty() ? 0 : plan.delays[edge]);
+            if (finish > ready) {
+              ready = finish;
+              critical = dependency;
+            }
+          }
+          finishes[position] = ready + durations[position];
+          criticalPrevious[position] = critical;
+          if (finishes[position] > makespan) {
+            makespan = finishes[position];
+            last = position;
+          }
+        }
+        distribution.makespans[sample] = makespan;
+        for (Id position = last; position >= 0;
+             position = criticalPrevious[position]) {
+          ++counts[position];
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned thread = 1; thread < threadsNumber; ++thread) {
+    threads.emplace_back(work, thread);
+  }
+  work(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::sort(distribution.makespans.begin(), distribution.makespans.end());
+  distribution.criticalCounts.assign(graph.size(), 0);
+  for (auto &counts : threadCounts) {
+    for (Id position = 0; position < static_cast<Id>(counts.size());
+         ++position) {
+      distribution.criticalCounts[plan.ids[position]] += counts[position];
+    }
+  }
+  return distribution;
+}
+
+} // namespace builder
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "action.h"
+#include "executors.h"
+#include "graph.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace builder {
+
+/// @brief Makespans of a plan over sampled durations of actions
+struct MakespanDistribution {
+  Time planned{0};               ///< makespan with durations of the graph
+  std::vector<Time> makespans{}; ///< makespans of samples in increasing order
+  /// number of samples in which the action was on the critical path of the
+  /// plan, indexed by Id
+  std::vector<int64_t> criticalCounts{};
+
+  /// @brief Nearest rank percentile of makespans
+  /// @param fraction fraction of samples, e.g. 0.95
+  Time percentile(double fraction) const;
+
+  /// @brief Mean of makespans
+  double mean() const;
+};
+
+/// @brief Run the plan of the graph many times with durations sampled from
+/// log-normal distributions with durations of actions as means and their
+/// deviations. Executors and the order of actions on every executor are kept
+/// as planned, an action starts when its dependencies and the previous
+/// action of its executor finish, its data transfers take as long as
+/// planned. The critical path of a sample is the chain of actions which
+/// started right after the previous one finished, back from the last action.
+///
+/// Actions are laid out in order of planned start times with dependencies as
+/// positions in that order, so a sample is one sequential pass over flat
+/// arrays. Durations of a sample are drawn in a batch from a counter-based
+/// generator, the result does not depend on the number of threads. Capacities
+/// of nodes are not simulated.
+/// @param graph actions graph after schedule()
+/// @param executors executors the graph was scheduled on
+/// @param samplesNumber number of samples
+/// @param seed seed of the random durations
+/// @param threadsNumber number of threads to simulate with, 0 for all
+/// hardware threads
+/// @return makespans of samples and how often actions were critical
+MakespanDistribution simulateMakespans(const Graph &graph,
+                                       const Executors &executors,
+                                       size_t samplesNumber, uint64_t seed = 1,
+                                       unsigned threadsNumber = 0);
+
+} // namespace builder
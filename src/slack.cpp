@@ -0,0 +1,113 @@
+#include "slack.h"
+
+#include <algorithm>
+#include <queue>
+#include <tuple>
+#include <utility>
+
+namespace builder {
+
+namespace {
+
+/// @brief Cost of the action on infinite executors, phony actions are free
+Time actionCost(const Graph &graph, Id id) {
+  return id == graph.startId() || id == graph.endId() ? 0
+                                                      : graph.durations[id];
+}
+
+} // namespace
+
+SlackTimes calculateSlack(const Graph &graph) {
+  SlackTimes slack;
+  slack.earliestStarts.assign(graph.size(), 0);
+  slack.latestStarts.assign(graph.size(), 0);
+  // Dependencies have smaller Ids, so they are calculated before the action
+  for (Id id = 0; id < graph.size(); ++id) {
+    Time start{0};
+    for (auto dependency = graph.dependencies.begin(id);
+         dependency != graph.dependencies.end(id); ++dependency) {
+      start = std::max(start, slack.earliestStarts[*dependency] +
+                                  actionCost(graph, *dependency));
+    }
+    slack.earliestStarts[id] = start;
+  }
+  slack.length = slack.earliestStarts[graph.endId()];
+  for (Id id = graph.endId(); id >= 0; --id) {
+    Time finish{slack.length};
+    for (auto dependent = graph.dependents.begin(id);
+         dependent != graph.dependents.end(id); ++dependent) {
+      finish = std::min(finish, slack.latestStarts[*dependent]);
+    }
+    slack.latestStarts[id] = finish - actionCost(graph, id);
+  }
+  return slack;
+}
+
+std::vector<Id> nearCriticalActions(const Graph &graph,
+                                    const SlackTimes &slack, Time maxSlack) {
+  std::vector<Id> ids;
+  for (Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    if (slack.slack(id) <= maxSlack) {
+      ids.push_back(id);
+    }
+  }
+  std::sort(ids.begin(), ids.end(), [&](Id lhs, Id rhs) {
+    return std::make_tuple(slack.slack(lhs), -graph.durations[lhs], lhs) <
+           std::make_tuple(slack.slack(rhs), -graph.durations[rhs], rhs);
+  });
+  return ids;
+}
+
+std::vector<ActionsPath> longestPaths(const Graph &graph,
+                                      const SlackTimes &slack,
+                                      size_t pathsNumber) {
+  // Prefixes of paths share their beginnings as a tree of last actions
+  struct Prefix {
+    Id id;
+    int64_t parent; ///< index of the prefix without the last action, or -1
+    Time length;    ///< sum of costs of actions before the last one
+  };
+  std::vector<Prefix> prefixes;
+  // Pairs of the longest length of a path with the prefix and of the index
+  // of the prefix, among equal lengths prefixes are taken in order of
+  // indices
+  using Entry = std::pair<Time, int64_t>;
+  auto longer = [](const Entry &lhs, const Entry &rhs) {
+    return lhs.first < rhs.first ||
+           (lhs.first == rhs.first && lhs.second > rhs.second);
+  };
+  std::priority_queue<Entry, std::vector<Entry>, decltype(longer)> queue(
+      longer);
+  // Longest path from the start of the action to the End
+  auto tail = [&](Id id) { return slack.length - slack.latestStarts[id]; };
+
+  std::vector<ActionsPath> paths;
+  prefixes.push_back({graph.startId(), -1, 0});
+  queue.emplace(tail(graph.startId()), 0);
+  while (paths.size() < pathsNumber && !queue.empty()) {
+    const int64_t index = queue.top().second;
+    queue.pop();
+    const Prefix prefix = prefixes[index];
+    if (prefix.id == graph.endId()) {
+      ActionsPath path;
+      path.length = prefix.length;
+      for (int64_t step = prefix.parent; prefixes[step].parent >= 0;
+           step = prefixes[step].parent) {
+        path.ids.push_back(prefixes[step].id);
+      }
+      std::reverse(path.ids.begin(), path.ids.end());
+      paths.push_back(std::move(path));
+      continue;
+    }
+    const Time length = prefix.length + actionCost(graph, prefix.id);
+    for (auto dependent = graph.dependents.begin(prefix.id);
+         dependent != graph.dependents.end(prefix.id); ++dependent) {
+      queue.emplace(length + tail(*dependent),
+                    static_cast<int64_t>(prefixes.size()));
+      prefixes.push_back({*dependent, index, length});
+    }
+  }
+  return paths;
+}
+
+} // namespace builder
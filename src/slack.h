@@ -0,0 +1,61 @@
+#pragma once
+
+#include "action.h"
+#include "graph.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace builder {
+
+/// @brief Earliest and latest start times of actions on infinite executors,
+/// indexed by Id. Phony Start and End actions take no time.
+struct SlackTimes {
+  std::vector<Time> earliestStarts{}; ///< after all dependencies finish
+  /// latest start which does not delay the End
+  std::vector<Time> latestStarts{};
+  Time length{0}; ///< length of the longest path, the shortest makespan
+
+  /// @brief Time the action can be delayed by without delaying the End,
+  /// zero on critical paths
+  Time slack(Id id) const { return latestStarts[id] - earliestStarts[id]; }
+};
+
+/// @brief Calculate earliest start times in one forward pass and latest ones
+/// in one backward pass over the topological order of Ids, with durations of
+/// actions as their costs
+/// @param graph actions graph
+/// @return start times of all actions of the graph
+SlackTimes calculateSlack(const Graph &graph);
+
+/// @brief Actions which are critical or close to it, the ones to make
+/// shorter or to split to shorten the makespan
+/// @param graph actions graph
+/// @param slack start times from calculateSlack()
+/// @param maxSlack largest slack of actions reported, 0 for critical ones
+/// @return Ids of actions by increasing slack, then by decreasing duration
+/// and by Id, without phony Start and End actions
+std::vector<Id> nearCriticalActions(const Graph &graph,
+                                    const SlackTimes &slack, Time maxSlack);
+
+/// @brief Path from the Start to the End action
+struct ActionsPath {
+  Time length{0};        ///< sum of durations of actions of the path
+  std::vector<Id> ids{}; ///< actions in order of execution without phony ones
+};
+
+/// @brief Find paths with the largest lengths. Paths are extended from the
+/// Start one action at a time in best-first order of their length plus the
+/// longest path to the End from their last action, which is exact, so paths
+/// reach the End in non-increasing order of length and only prefixes of the
+/// result paths, and of paths as long as the last one, are ever extended.
+/// @param graph actions graph
+/// @param slack start times from calculateSlack()
+/// @param pathsNumber number of paths to find
+/// @return at most pathsNumber paths by non-increasing length, paths of equal
+/// length in order they were found
+std::vector<ActionsPath> longestPaths(const Graph &graph,
+                                      const SlackTimes &slack,
+                                      size_t pathsNumber);
+
+} // namespace builder
@@ -0,0 +1,195 @@
+#include "stats.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <stdexcept>
+
+namespace builder {
+
+namespace {
+
+constexpr size_t countersNumber{static_cast<size_t>(Counter::CountersNumber)};
+
+std::atomic<int64_t> counters[countersNumber]{};
+
+const std::string_view counterNames[countersNumber]{
+    "sha_index_rehashes", "executor_scans", "dependency_stalls",
+    "stall_time"};
+
+} // namespace
+
+void count(Counter counter, int64_t value) {
+  counters[static_cast<size_t>(counter)].fetch_add(value,
+                                                   std::memory_order_relaxed);
+}
+
+int64_t counterValue(Counter counter) {
+  return counters[static_cast<size_t>(counter)].load(
+      std::memory_order_relaxed);
+}
+
+std::string_view counterName(Counter counter) {
+  return counterNames[static_cast<size_t>(counter)];
+}
+
+void RunStats::begin(std::string name) {
+  end();
+  phases_.emplace_back();
+  phases_.back().name = std::move(name);
+  resetPeakHeapBytes();
+  const auto heap = heapUsage();
+  start_.allocations = heap.allocations;
+  start_.allocatedBytes = heap.allocatedBytes;
+  for (size_t counter = 0; counter < countersNumber; ++counter) {
+    start_.counters[counter] =
+        counters[counter].load(std::memory_order_relaxed);
+  }
+  start_.cpu = std::clock();
+  start_.wall = std::chrono::steady_clock::now();
+  running_ = true;
+}
+
+void RunStats::end(const Graph &graph) {
+  if (!running_) {
+    return;
+  }
+  end();
+  phases_.back().nodes = graph.size();
+  phases_.back().edges =
+      static_cast<int64_t>(graph.dependencies.targets.size());
+}
+
+void RunStats::end() {
+  if (!running_) {
+    return;
+  }
+  const auto wall = std::chrono::steady_clock::now();
+  const auto cpu = std::clock();
+  running_ = false;
+  auto &phase = phases_.back();
+  phase.wallSeconds = std::chrono::duration<double>(wall - start_.wall).count();
+  phase.cpuSeconds = static_cast<double>(cpu - start_.cpu) / CLOCKS_PER_SEC;
+  const auto heap = heapUsage();
+  phase.allocations = heap.allocations - start_.allocations;
+  phase.allocatedBytes = heap.allocatedBytes - start_.allocatedBytes;
+  phase.heapBytes = heap.bytes;
+  phase.peakHeapBytes = heap.peakBytes;
+  for (size_t counter = 0; counter < countersNumber; ++counter) {
+    phase.counters[counter] =
+        counters[counter].load(std::memory_order_relaxed) -
+        start_.counters[counter];
+  }
+}
+
+StatsFormat parse_stats_format(std::string_view name) {
+  if (name == "text") {
+    return StatsFormat::Text;
+  }
+  if (name == "json") {
+    return StatsFormat::Json;
+  }
+  throw std::runtime_error("Unknown stats format '" + std::string(name) +
+                           "', must be text or json.");
+}
+
+namespace {
+
+void saveText(const std::vector<PhaseStats> &phases, const PhaseStats &total,
+              std::ostream &fo) {
+  const auto flags = fo.flags();
+  fo << std::endl;
+  fo << std::left << std::setw(20) << "Phase" << std::right << std::setw(11)
+     << "Wall, s" << std::setw(11) << "CPU, s" << std::setw(12) << "Nodes"
+     << std::setw(12) << "Edges" << std::setw(12) << "Allocs"
+     << std::setw(14) << "Allocated, B" << std::setw(14) << "Peak heap, B"
+     << std::endl;
+  fo << std::fixed << std::setprecision(3);
+  auto row = [&](const PhaseStats &phase) {
+    fo << std::left << std::setw(20) << phase.name << std::right
+       << std::setw(11) << phase.wallSeconds << std::setw(11)
+       << phase.cpuSeconds << std::setw(12) << phase.nodes << std::setw(12)
+       << phase.edges << std::setw(12) << phase.allocations << std::setw(14)
+       << phase.allocatedBytes << std::setw(14) << phase.peakHeapBytes
+       << std::endl;
+  };
+  for (auto &phase : phases) {
+    row(phase);
+  }
+  row(total);
+  for (auto &phase : phases) {
+    for (size_t counter = 0; counter < countersNumber; ++counter) {
+      if (phase.counters[counter] != 0) {
+        fo << "  " << phase.name << ' '
+           << counterName(static_cast<Counter>(counter)) << " = "
+           << phase.counters[counter] << std::endl;
+      }
+    }
+  }
+  fo << "Peak resident set size, B = " << peakResidentBytes() << std::endl;
+  fo << std::endl;
+  fo.flags(flags);
+}
+
+void saveJson(const std::vector<PhaseStats> &phases, const PhaseStats &total,
+              std::ostream &fo) {
+  const auto flags = fo.flags();
+  const auto precision = fo.precision();
+  fo << std::fixed << std::setprecision(6);
+  auto object = [&](const PhaseStats &phase) {
+    // Names of phases are identifiers, they need no escaping
+    fo << "{\"name\":\"" << phase.name
+       << "\",\"wall_seconds\":" << phase.wallSeconds
+       << ",\"cpu_seconds\":" << phase.cpuSeconds
+       << ",\"nodes\":" << phase.nodes << ",\"edges\":" << phase.edges
+       << ",\"allocations\":" << phase.allocations
+       << ",\"allocated_bytes\":" << phase.allocatedBytes
+       << ",\"heap_bytes\":" << phase.heapBytes
+       << ",\"peak_heap_bytes\":" << phase.peakHeapBytes << ",\"counters\":{";
+    for (size_t counter = 0; counter < countersNumber; ++counter) {
+      fo << (counter ? "," : "") << '"'
+         << counterName(static_cast<Counter>(counter))
+         << "\":" << phase.counters[counter];
+    }
+    fo << "}}";
+  };
+  fo << "{\"phases\":[";
+  for (size_t index = 0; index < phases.size(); ++index) {
+    fo << (index ? "," : "");
+    object(phases[index]);
+  }
+  fo << "],\"total\":";
+  object(total);
+  fo << ",\"peak_resident_bytes\":" << peakResidentBytes() << '}'
+     << std::endl;
+  fo.flags(flags);
+  fo.precision(precision);
+}
+
+} // namespace
+
+void save_stats(const RunStats &stats, StatsFormat format, std::ostream &fo) {
+  PhaseStats total;
+  total.name = "total";
+  for (auto &phase : stats.phases()) {
+    total.wallSeconds += phase.wallSeconds;
+    total.cpuSeconds += phase.cpuSeconds;
+    total.nodes = phase.nodes ? phase.nodes : total.nodes;
+    total.edges = phase.nodes ? phase.edges : total.edges;
+    total.allocations += phase.allocations;
+    total.allocatedBytes += phase.allocatedBytes;
+    total.heapBytes = phase.heapBytes;
+    total.peakHeapBytes = std::max(total.peakHeapBytes, phase.peakHeapBytes);
+    for (size_t counter = 0; counter < countersNumber; ++counter) {
+      total.counters[counter] += phase.counters[counter];
+    }
+  }
+  if (format == StatsFormat::Text) {
+    saveText(stats.phases(), total, fo);
+  } else {
+    saveJson(stats.phases(), total, fo);
+  }
+}
+
+} // namespace builder
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "graph.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace builder {
+
+/// @brief Event counters of the planning code, they are process wide and are
+/// added to once per call of a function rather than per event
+enum class Counter {
+  ShaIndexRehashes, ///< rehashes of the SHA index of a graph
+  ExecutorScans,    ///< executors compared to place actions on
+  DependencyStalls, ///< actions an executor idled for waiting dependencies
+                    ///< or resources of its node
+  StallTime,        ///< time executors idled for such actions
+  CountersNumber
+};
+
+/// @brief Add to the counter, it is a relaxed atomic addition
+void count(Counter counter, int64_t value = 1);
+
+/// @brief Current value of the counter
+int64_t counterValue(Counter counter);
+
+/// @brief Name of the counter in reports, e.g. 'executor_scans'
+std::string_view counterName(Counter counter);
+
+/// @brief Measurements of one phase of a run
+struct PhaseStats {
+  std::string name{};
+  double wallSeconds{0};     ///< elapsed real time
+  double cpuSeconds{0};      ///< CPU time of all threads of the process
+  int64_t nodes{0};          ///< actions of the graph after the phase
+  int64_t edges{0};          ///< dependency edges of the graph after it
+  int64_t allocations{0};    ///< heap allocations made
+  int64_t allocatedBytes{0}; ///< bytes of heap allocations made
+  int64_t heapBytes{0};      ///< heap bytes in use after the phase
+  int64_t peakHeapBytes{0};  ///< highest heap bytes in use during the phase
+  /// counters added to during the phase
+  std::array<int64_t, static_cast<size_t>(Counter::CountersNumber)>
+      counters{};
+};
+
+/// @brief Records phases of a run one after another. A phase is measured
+/// from begin() to end(), so that nothing is measured within the phase, and
+/// the peak of heap usage is reset when a phase begins.
+class RunStats {
+public:
+  /// @brief Begin the phase, the current one is ended first
+  void begin(std::string name);
+
+  /// @brief End the current phase, if any
+  /// @param graph graph whose size is recorded for the phase
+  void end(const Graph &graph);
+  void end();
+
+  const std::vector<PhaseStats> &phases() const { return phases_; }
+
+private:
+  struct Start {
+    std::chrono::steady_clock::time_point wall{};
+    std::clock_t cpu{0};
+    int64_t allocations{0};
+    int64_t allocatedBytes{0};
+    std::array<int64_t, static_cast<size_t>(Counter::CountersNumber)>
+        counters{};
+  };
+
+  std::vector<PhaseStats> phases_{};
+  Start start_{};
+  bool running_{false};
+};
+
+/// @brief Formats of the report of run statistics
+enum class StatsFormat {
+  Text, ///< table of phases
+  Json  ///< one line JSON object, e.g. for monitoring
+};
+
+/// @brief Parse name of stats format
+/// @param name 'text' or 'json'
+/// @return stats format, throws std::runtime_error on unknown name
+StatsFormat parse_stats_format(std::string_view name);
+
+/// @brief Save report of phases with totals and peak resident set size
+/// @param stats recorded phases
+/// @param format format of the report
+/// @param fo output stream
+void save_stats(const RunStats &stats, StatsFormat format, std::ostream &fo);
+
+} // namespace builder
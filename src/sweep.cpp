@@ -0,0 +1,144 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace builder {
+
+namespace {
+
+/// @brief Adding executors pays off while makespan decreases by at least
+/// this fraction of the relative increase of executors
+const double minKneeElasticity{0.5};
+
+} // namespace
+
+std::vector<Id> parse_concurrency_sweep(std::string_view range) {
+  auto error = [&]() {
+    return std::runtime_error("Concurrency sweep must be first:last:step of "
+                              "positive numbers, got '" +
+                              std::string(range) + "'");
+  };
+  std::vector<int64_t> numbers;
+  size_t begin{0};
+  while (begin <= range.size()) {
+    const size_t end = std::min(range.find(':', begin), range.size());
+    const auto number = range.substr(begin, end - begin);
+    if (number.empty() || number.size() > 9 ||
+        !std::all_of(number.begin(), number.end(),
+                     [](char c) { return c >= '0' && c <= '9'; })) {
+      throw error();
+    }
+    numbers.push_back(std::stoll(std::string(number)));
+    begin = end + 1;
+  }
+  if (numbers.size() == 2) {
+    numbers.push_back(1);
+  }
+  if (numbers.size() != 3 || numbers[0] < 1 || numbers[1] < numbers[0] ||
+      numbers[2] < 1) {
+    throw error();
+  }
+  std::vector<Id> executorsNumbers;
+  for (int64_t number = numbers[0]; number <= numbers[1];
+       number += numbers[2]) {
+    executorsNumbers.push_back(static_cast<Id>(number));
+  }
+  return executorsNumbers;
+}
+
+ConcurrencySweep sweepConcurrency(const Graph &graph,
+                                  const std::vector<Id> &executorsNumbers,
+                                  Placement placement,
+                                  unsigned threadsNumber) {
+  if (threadsNumber == 0) {
+    threadsNumber = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadsNumber = static_cast<unsigned>(
+      std::min<size_t>(threadsNumber, executorsNumbers.size()));
+
+  const auto rankIds = computeRankIds(graph);
+  Time busyTime{0};
+  for (auto &[_, id] : rankIds) {
+    busyTime += graph.durations[id];
+  }
+  const Time criticalPathLength =
+      graph.longestPaths[graph.predecessors[graph.startId()]];
+
+  ConcurrencySweep sweep;
+  sweep.points.resize(executorsNumbers.size());
+  std::atomic<size_t> nextPoint{0};
+  auto work = [&]() {
+    Schedule scheduled;
+    for (size_t index = nextPoint++; index < executorsNumbers.size();
+         index = nextPoint++) {
+      const Id executorsNumber = executorsNumbers[index];
+      schedule(Executors::identical(executorsNumber), rankIds, graph,
+               scheduled, placement);
+      auto &point = sweep.points[index];
+      point.executorsNumber = executorsNumber;
+      point.makespan = *std::max_element(scheduled.endTimes.begin(),
+                                         scheduled.endTimes.end());
+      if (point.makespan > 0) {
+        point.utilization = static_cast<double>(busyTime) /
+                            (static_cast<double>(point.makespan) *
+                             executorsNumber);
+      }
+      if (criticalPathLength > 0) {
+        point.criticalPathRatio = static_cast<double>(point.makespan) /
+                                  static_cast<double>(criticalPathLength);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned thread = 1; thread < threadsNumber; ++thread) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (sweep.points.empty()) {
+    return sweep;
+  }
+  Time shortest{sweep.points.front().makespan};
+  sweep.saturation = 0;
+  for (size_t index = 0; index < sweep.points.size(); ++index) {
+    if (sweep.points[index].makespan < shortest) {
+      shortest = sweep.points[index].makespan;
+      sweep.saturation = static_cast<int64_t>(index);
+    }
+  }
+
+  sweep.knee = findKnee(sweep.points);
+  return sweep;
+}
+
+int64_t findKnee(const std::vector<SweepPoint> &points) {
+  // Elasticity of makespan is 1 when executors are added with a perfect
+  // speedup, from the knee it stays below a half for every later point
+  auto paysOff = [](const SweepPoint &point, const SweepPoint &later) {
+    const double elasticity =
+        std::log(static_cast<double>(std::max<Time>(point.makespan, 1)) /
+                 std::max<Time>(later.makespan, 1)) /
+        std::log(static_cast<double>(later.executorsNumber) /
+                 point.executorsNumber);
+    return elasticity >= minKneeElasticity;
+  };
+  for (size_t index = 0; index < points.size(); ++index) {
+    if (std::none_of(points.begin() + index + 1, points.end(),
+                     [&](auto &later) {
+                       return paysOff(points[index], later);
+                     })) {
+      return static_cast<int64_t>(index);
+    }
+  }
+  return -1;
+}
+
+} // namespace builder
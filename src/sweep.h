@@ -0,0 +1,64 @@
+#pragma once
+
+#include "action.h"
+#include "graph.h"
+#include "heft.h"
+
+#include <string_view>
+#include <vector>
+
+namespace builder {
+
+/// @brief Plan for one number of executors of a concurrency sweep
+struct SweepPoint {
+  Id executorsNumber{0};       ///< number of identical executors
+  Time makespan{0};            ///< finish time of the last action
+  double utilization{0};       ///< busy time over makespan * executors
+  double criticalPathRatio{0}; ///< makespan over the critical path length
+};
+
+/// @brief Plans for a range of numbers of executors
+struct ConcurrencySweep {
+  std::vector<SweepPoint> points{}; ///< in order of numbers of executors
+  /// index of the knee point, where adding executors stops paying off, or -1
+  /// if there are no points
+  int64_t knee{-1};
+  /// index of the first point with the shortest makespan, or -1 if there are
+  /// no points
+  int64_t saturation{-1};
+};
+
+/// @brief Parse range of numbers of executors given as first:last:step or
+/// first:last, the step is 1 by default
+/// @param range text of the range
+/// @return numbers of executors in increasing order, throws
+/// std::runtime_error if the range is malformed
+std::vector<Id> parse_concurrency_sweep(std::string_view range);
+
+/// @brief Find the knee of a sweep, the first point from which no larger
+/// number of executors pays off: relative decrease of makespan from the point
+/// is less than half of relative increase of executors, e.g. 10% more
+/// executors make the plan shorter by less than 5%. Every later point is
+/// compared with the knee, as makespans of list schedules don't always
+/// decrease with more executors, so a point after a bump can still pay off.
+/// The knee is never after the first point with the shortest makespan.
+/// @param points plans in increasing order of numbers of executors
+/// @return index of the knee, or -1 if there are no points
+int64_t findKnee(const std::vector<SweepPoint> &points);
+
+/// @brief Schedule the graph on every given number of identical executors
+/// with ranks calculated once. Numbers of executors are scheduled
+/// concurrently, every thread into its own Schedule, the graph is not
+/// changed. The knee is found by findKnee().
+/// @param graph actions graph after calculateRanks()
+/// @param executorsNumbers numbers of executors in increasing order
+/// @param placement how actions are placed on executors
+/// @param threadsNumber number of threads to schedule with, 0 for all
+/// hardware threads
+/// @return plans in order of executorsNumbers with the knee
+ConcurrencySweep sweepConcurrency(const Graph &graph,
+                                  const std::vector<Id> &executorsNumbers,
+                                  Placement placement = Placement::Append,
+                                  unsigned threadsNumber = 0);
+
+} // namespace builder
@@ -1,11 +1,37 @@
 // #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <random>
 #include <stdexcept>
+#include <thread>
 
 #include "action.h"
+#include "binary_graph.h"
+#include "dispatch.h"
+#include "duration_model.h"
+#include "execution.h"
+#include "eft.h"
+#include "executors.h"
 #include "heft.h"
+#include "idle_gaps.h"
+#include "incremental.h"
 #include "input.h"
+#include "memory.h"
+#include "output.h"
+#include "plan_cache.h"
+#include "resource_timeline.h"
+#include "schedulers.h"
+#include "server.h"
+#include "simulation.h"
+#include "slack.h"
+#include "stats.h"
+#include "sweep.h"
 
 using ::testing::ElementsAre;
 using ::testing::ElementsAreArray;
@@ -287,4 +313,2049 @@ TEST_P(ScheduleTests2, HugeConcurrentDAG) {
 }
 
 INSTANTIATE_TEST_SUITE_P(InstantiationName, ScheduleTests2,
-                         ::testing::Values(1, 2, 3, 4, 5));
\ No newline at end of file
+                         ::testing::Values(1, 2, 3, 4, 5));
+
+TEST(GraphTests, LoadGraphInternsShasInDeclarationOrder) {
+  std::string testInput = R"(
+    a 3
+    b 2  a
+    c 1  a  b  a)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+
+  std::vector<builder::SHA> shas;
+  for (builder::Id id = 0; id < graph.size(); ++id) {
+    shas.emplace_back(graph.shas[id]);
+  }
+  EXPECT_THAT(shas, ElementsAre(builder::Start.sha1, "a", "b", "c",
+                                builder::End.sha1));
+  EXPECT_EQ(graph.find("d"), -1);
+  EXPECT_THAT(graph.durations, ElementsAre(1, 3, 2, 1, 1));
+  EXPECT_EQ(graph.at("b"), 2);
+  EXPECT_EQ(graph.startId(), 0);
+  EXPECT_EQ(graph.endId(), 4);
+
+  auto dependenciesOf = [&](builder::Id id) {
+    return std::vector<builder::Id>(graph.dependencies.begin(id),
+                                    graph.dependencies.end(id));
+  };
+  auto dependentsOf = [&](builder::Id id) {
+    return std::vector<builder::Id>(graph.dependents.begin(id),
+                                    graph.dependents.end(id));
+  };
+  EXPECT_THAT(dependenciesOf(0), ElementsAre());
+  EXPECT_THAT(dependenciesOf(1), ElementsAre(0));
+  EXPECT_THAT(dependenciesOf(3), ElementsAre(1, 2));
+  EXPECT_THAT(dependenciesOf(4), ElementsAre(3));
+  EXPECT_THAT(dependentsOf(0), ElementsAre(1));
+  EXPECT_THAT(dependentsOf(1), ElementsAre(2, 3));
+  EXPECT_THAT(dependentsOf(4), ElementsAre());
+}
+
+TEST(GraphTests, GraphAndActionsRoundTrip) {
+  std::string testInput = R"(
+    a 3
+    b 2
+    c 1  a  b
+    d 4  b)";
+  std::stringstream testStream(testInput);
+  auto actions = builder::load_actions(testStream);
+  auto roundTrip = builder::toActions(builder::toGraph(actions));
+
+  ASSERT_EQ(roundTrip.size(), actions.size());
+  for (auto &[sha, action] : actions) {
+    EXPECT_EQ(roundTrip.at(sha).duration, action.duration);
+    EXPECT_EQ(roundTrip.at(sha).dependencies, action.dependencies);
+  }
+}
+
+TEST(GraphTests, GraphScheduleMatchesActionsSchedule) {
+  std::string testInput = R"(
+    a 3
+    b 2
+    c 1  a  b
+    d 4  b
+    e 2  c  d
+    f 5)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  auto actions = builder::toActions(graph);
+
+  builder::calculateRanks(graph);
+  builder::calculateRanks(actions);
+  const auto rankShas = computeRankShas(actions);
+  schedule(2, rankShas, actions);
+
+  // Same order of equal ranks as of the actions schedule
+  builder::RankIds rankIds;
+  for (auto &[rank, sha] : rankShas) {
+    rankIds.emplace_back(rank, graph.at(sha));
+  }
+  schedule(2, rankIds, graph);
+
+  for (builder::Id id = 0; id < graph.size(); ++id) {
+    auto &action = actions.at(builder::SHA(graph.shas[id]));
+    EXPECT_EQ(graph.ranks[id], action.rank);
+    EXPECT_EQ(graph.longestPaths[id], action.longestPath);
+    EXPECT_EQ(graph.startTimes[id], action.startTime);
+    EXPECT_EQ(graph.endTimes[id], action.endTime);
+  }
+  EXPECT_EQ(getCriticalPath(graph).actionsShas,
+            getCriticalPath(actions).actionsShas);
+  EXPECT_EQ(getCriticalPath(graph).actualExecutorsLength,
+            getCriticalPath(actions).actualExecutorsLength);
+}
+
+TEST(GraphTests, DeepDenseDAGRanks) {
+  // Every action depends on up to 32 previously declared actions
+  const int32_t actionsNum{2000};
+  const int32_t width{32};
+  std::string testInput = "";
+  for (int32_t i = 0; i < actionsNum; ++i) {
+    testInput += "\n" + std::to_string(i) + " 1";
+    for (int32_t j = std::max(0, i - width); j < i; ++j) {
+      testInput += " " + std::to_string(j);
+    }
+  }
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  schedule(4, computeRankIds(graph), graph);
+
+  for (int32_t i = 0; i < actionsNum; ++i) {
+    const auto id = graph.at(std::to_string(i));
+    EXPECT_EQ(graph.ranks[id], actionsNum - i + 1);
+    EXPECT_EQ(graph.longestPaths[id], actionsNum - i);
+  }
+  const auto criticalPath = getCriticalPath(graph);
+  EXPECT_EQ(criticalPath.infiniteExecutorsLength, actionsNum);
+  EXPECT_EQ(criticalPath.actualExecutorsLength, actionsNum);
+  EXPECT_EQ(criticalPath.actionsShas.size(), actionsNum);
+}
+
+TEST(GraphTests, AncestorSubgraphOfTargets) {
+  std::string testInput = R"(
+    a 3 memory=8
+    b 2
+    c 1  a:16  b
+    d 4  b deviation=2
+    e 5  c
+    f 6)";
+  auto graph = builder::parse_graph(testInput);
+  const auto subgraph =
+      builder::ancestorSubgraph(graph, {graph.at("c"), graph.at("a")});
+  ASSERT_EQ(subgraph.size(), 5);
+  EXPECT_EQ(subgraph.find("d"), -1);
+  EXPECT_EQ(subgraph.find("e"), -1);
+  EXPECT_LT(subgraph.at("a"), subgraph.at("c"));
+  // End depends on c only, a is a dependency of c
+  ASSERT_EQ(subgraph.dependencies.size(subgraph.endId()), 1);
+  EXPECT_EQ(*subgraph.dependencies.begin(subgraph.endId()), subgraph.at("c"));
+  const auto edge = subgraph.dependencies.offsets[subgraph.at("c")];
+  EXPECT_EQ(subgraph.dependencies.dataSizes[edge], 16);
+  EXPECT_EQ(subgraph.demand(subgraph.at("a")).memory, 8);
+  EXPECT_FALSE(subgraph.ranksCalculated);
+  EXPECT_THAT([&]() { builder::ancestorSubgraph(graph, {graph.endId()}); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("phony")));
+
+  // Cone spans many words of the bitset
+  std::mt19937 random(3);
+  testInput.clear();
+  for (int i = 0; i < 3000; ++i) {
+    testInput += "action" + std::to_string(i) + " 1";
+    for (int j = 0; j < 2 && i > 0; ++j) {
+      testInput += " action" + std::to_string(random() % i);
+    }
+    testInput += "\n";
+  }
+  graph = builder::parse_graph(testInput);
+  const builder::Id target = graph.at("action2999");
+  std::vector<bool> inCone(graph.size(), false);
+  std::vector<builder::Id> cone{target};
+  inCone[target] = true;
+  for (size_t i = 0; i < cone.size(); ++i) {
+    for (auto dependency = graph.dependencies.begin(cone[i]);
+         dependency != graph.dependencies.end(cone[i]); ++dependency) {
+      if (!inCone[*dependency] && *dependency != graph.startId()) {
+        inCone[*dependency] = true;
+        cone.push_back(*dependency);
+      }
+    }
+  }
+  const auto large = builder::ancestorSubgraph(graph, {target});
+  EXPECT_EQ(large.size(), static_cast<builder::Id>(cone.size()) + 2);
+  for (builder::Id id : cone) {
+    EXPECT_EQ(large.dependencies.size(large.at(graph.shas[id])),
+              graph.dependencies.size(id));
+  }
+  EXPECT_EQ(large.dependencies.size(large.endId()), 1);
+}
+
+TEST(InputTests, ErrorsHaveLineNumbers) {
+  std::string testInput = "\n  a 1\n\n  b 1  c\n";
+  std::stringstream testStream(testInput);
+  EXPECT_THAT([&]() { builder::load_actions(testStream); },
+              ThrowsMessage<std::runtime_error>(
+                  HasSubstr("Line 4: Dependency of target b called: c")));
+}
+
+TEST(InputTests, TrailingGarbageIsFormatError) {
+  for (std::string testInput : {"a 1x", "a 1 b$", "a", "$ 1", "a 01"}) {
+    std::stringstream testStream(testInput);
+    EXPECT_THROW(builder::load_actions(testStream), std::runtime_error)
+        << testInput;
+  }
+}
+
+TEST(InputTests, ParallelParseMatchesSequential) {
+  // Big enough input to be split into several chunks
+  const int32_t actionsNum{200000};
+  std::string testInput = "";
+  for (int32_t i = 0; i < actionsNum; ++i) {
+    testInput += "action" + std::to_string(i) + " " + std::to_string(i % 7 + 1);
+    if (i > 0) {
+      testInput += " action" + std::to_string(i / 2);
+    }
+    testInput += "\r\n";
+  }
+  const auto sequential = builder::parse_graph(testInput, 1);
+  const auto parallel = builder::parse_graph(testInput, 4);
+  EXPECT_EQ(parallel.shas.bytes, sequential.shas.bytes);
+  EXPECT_EQ(parallel.shas.offsets, sequential.shas.offsets);
+  EXPECT_EQ(parallel.durations, sequential.durations);
+  EXPECT_EQ(parallel.dependencies.offsets, sequential.dependencies.offsets);
+  EXPECT_EQ(parallel.dependencies.targets, sequential.dependencies.targets);
+
+  testInput += "action0 1\n";
+  EXPECT_THAT([&]() { builder::parse_graph(testInput, 4); },
+              ThrowsMessage<std::runtime_error>(
+                  HasSubstr("Line " + std::to_string(actionsNum + 1) +
+                            ": Action action0 is already defined")));
+}
+
+TEST(InputTests, ParseAllocatesPerChunkNotPerAction) {
+  const int32_t actionsNum{20000};
+  std::string testInput = "";
+  for (int32_t i = 0; i < actionsNum; ++i) {
+    testInput += "action" + std::to_string(i) + " 1";
+    if (i > 0) {
+      testInput += " action" + std::to_string(i / 2);
+    }
+    testInput += "\n";
+  }
+  // Data sizes appear after many dependencies without them
+  testInput += "last 1 action0 action1:64\n";
+
+  const auto before = builder::heapUsage();
+  const auto graph = builder::parse_graph(testInput, 1);
+  const auto after = builder::heapUsage();
+  EXPECT_LT(after.allocations - before.allocations, 200);
+  EXPECT_GE(after.bytes - before.bytes,
+            static_cast<int64_t>(graph.storageBytes()));
+  EXPECT_LT(graph.storageBytes(), 160u * graph.size());
+
+  const auto last = graph.at("last");
+  ASSERT_EQ(graph.dependencies.size(last), 2);
+  const auto edge = graph.dependencies.offsets[last];
+  EXPECT_EQ(graph.dependencies.dataSizes[edge], 0);
+  EXPECT_EQ(graph.dependencies.dataSizes[edge + 1], 64);
+  EXPECT_EQ(graph.dependencies.dataSizes[graph.dependencies.offsets[2]], 0);
+}
+
+TEST(BinaryGraphTests, SaveAndLoadWithRanks) {
+  std::string testInput = R"(
+    a 3
+    b 2
+    c 1  a  b
+    d 4  b)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "builder_test_graph.bin";
+  builder::save_binary_graph(graph, file, true);
+  auto loaded = builder::load_graph(file);
+  std::filesystem::remove(file);
+
+  EXPECT_TRUE(loaded.ranksCalculated);
+  EXPECT_EQ(loaded.shas.bytes, graph.shas.bytes);
+  EXPECT_EQ(loaded.shas.offsets, graph.shas.offsets);
+  EXPECT_EQ(loaded.durations, graph.durations);
+  EXPECT_EQ(loaded.dependencies.targets, graph.dependencies.targets);
+  EXPECT_EQ(loaded.dependents.targets, graph.dependents.targets);
+  EXPECT_EQ(loaded.ranks, graph.ranks);
+  EXPECT_EQ(loaded.longestPaths, graph.longestPaths);
+  EXPECT_EQ(loaded.predecessors, graph.predecessors);
+  EXPECT_EQ(loaded.at("c"), graph.at("c"));
+  EXPECT_EQ(loaded.find("e"), -1);
+
+  schedule(2, computeRankIds(loaded), loaded);
+  schedule(2, computeRankIds(graph), graph);
+  EXPECT_EQ(loaded.startTimes, graph.startTimes);
+}
+
+TEST(BinaryGraphTests, SaveWithoutRanksAndTruncatedFile) {
+  std::string testInput = R"(
+    a 3
+    b 2  a)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "builder_test_graph.bin";
+  builder::save_binary_graph(graph, file, false);
+  std::ifstream fi(file, std::ios::binary);
+  const std::string data(std::istreambuf_iterator<char>(fi), {});
+  std::filesystem::remove(file);
+
+  auto loaded = builder::load_binary_graph(data);
+  EXPECT_FALSE(loaded.ranksCalculated);
+  EXPECT_EQ(loaded.dependencies.targets, graph.dependencies.targets);
+
+  EXPECT_THAT([&]() { builder::load_binary_graph(data.substr(0, 100)); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("truncated")));
+
+  // Flags of arrays unknown to this version
+  auto damaged = data;
+  damaged[13] = '\x40';
+  EXPECT_THAT([&]() { builder::load_binary_graph(damaged); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("unsupported")));
+  // Dependency of b on a made a forward edge
+  auto edges = data;
+  const std::string edgeBytes(reinterpret_cast<const char *>(
+                                  graph.dependencies.targets.data()),
+                              graph.dependencies.targets.size() * 4);
+  const auto edgesBegin = edges.find(edgeBytes);
+  ASSERT_NE(edgesBegin, std::string::npos);
+  const builder::Id forward = graph.endId();
+  const auto edgeOfB = graph.dependencies.offsets[graph.at("b")];
+  std::memcpy(&edges[edgesBegin + 4 * edgeOfB], &forward, sizeof(forward));
+  EXPECT_THAT([&]() { builder::load_binary_graph(edges); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("dependencies")));
+  // Slot of the SHA index out of range
+  auto index = data;
+  const std::string slotBytes(
+      reinterpret_cast<const char *>(graph.shaIndex.slots.data()),
+      graph.shaIndex.slots.size() * 4);
+  const auto slotsBegin = index.find(slotBytes);
+  ASSERT_NE(slotsBegin, std::string::npos);
+  const builder::Id wrongId{1000};
+  std::memcpy(&index[slotsBegin], &wrongId, sizeof(wrongId));
+  EXPECT_THAT([&]() { builder::load_binary_graph(index); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("SHA index")));
+  // Size of the SHA index in bytes wraps around to 4
+  auto slotsNumber = data;
+  const int64_t hugeSlotsNumber{(int64_t{1} << 62) + 1};
+  std::memcpy(&slotsNumber[48], &hugeSlotsNumber, sizeof(hugeSlotsNumber));
+  EXPECT_THAT([&]() { builder::load_binary_graph(slotsNumber); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("truncated")));
+}
+
+TEST(IdleGapsTests, FindAndOccupyGaps) {
+  builder::IdleGaps gaps;
+  EXPECT_EQ(gaps.findStart(3, 10), 3);
+  gaps.occupy(0, 2);
+  gaps.occupy(5, 3);
+  EXPECT_EQ(gaps.availableTime(), 8);
+
+  EXPECT_EQ(gaps.findStart(0, 3), 2);
+  EXPECT_EQ(gaps.findStart(0, 4), 8);
+  EXPECT_EQ(gaps.findStart(3, 2), 3);
+  EXPECT_EQ(gaps.findStart(4, 2), 8);
+  EXPECT_EQ(gaps.findStart(6, 1), 8);
+  EXPECT_EQ(gaps.findStart(20, 1), 20);
+
+  gaps.occupy(2, 3);
+  EXPECT_EQ(gaps.findStart(0, 1), 8);
+  gaps.occupy(10, 1);
+  EXPECT_EQ(gaps.findStart(0, 2), 8);
+  EXPECT_EQ(gaps.findStart(0, 3), 11);
+}
+
+/// @brief Check that actions start after their dependencies finish and
+/// actions on the same executor don't overlap
+void expectValidSchedule(const builder::Graph &graph,
+                         const builder::Executors &executors) {
+  std::vector<std::vector<std::pair<builder::Time, builder::Time>>> busy(
+      executors.size());
+  for (builder::Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    for (auto dependency = graph.dependencies.begin(id);
+         dependency != graph.dependencies.end(id); ++dependency) {
+      EXPECT_LE(graph.endTimes[*dependency], graph.startTimes[id]);
+    }
+    const builder::Id executor = graph.executorIds[id];
+    ASSERT_GE(executor, 0);
+    ASSERT_LT(executor, executors.size());
+    size_t classIndex = 0;
+    while (executor >= executors.classes[classIndex].firstExecutor +
+                           executors.classes[classIndex].count) {
+      ++classIndex;
+    }
+    EXPECT_EQ(graph.endTimes[id] - graph.startTimes[id],
+              executors.cost(graph, id, classIndex));
+    busy[executor].emplace_back(graph.startTimes[id], graph.endTimes[id]);
+  }
+  for (auto &intervals : busy) {
+    std::sort(intervals.begin(), intervals.end());
+    for (size_t i = 1; i < intervals.size(); ++i) {
+      EXPECT_LE(intervals[i - 1].second, intervals[i].first);
+    }
+  }
+}
+
+void expectValidSchedule(const builder::Graph &graph,
+                         builder::Id numberOfExecutors) {
+  expectValidSchedule(graph, builder::Executors::identical(numberOfExecutors));
+}
+
+/// @brief Random layered DAG in the input format
+std::string randomDAG(int32_t actionsNum, int32_t maxDependencies,
+                      uint32_t seed) {
+  std::mt19937 random(seed);
+  std::string testInput = "";
+  for (int32_t i = 0; i < actionsNum; ++i) {
+    testInput += "\n" + std::to_string(i) + " " +
+                 std::to_string(random() % 20 + 1);
+    const int32_t dependencies = i ? random() % (maxDependencies + 1) : 0;
+    for (int32_t j = 0; j < dependencies; ++j) {
+      testInput += " " + std::to_string(random() % i);
+    }
+  }
+  return testInput;
+}
+
+TEST(InsertionScheduleTests, UsesIdleGap) {
+  // e waits for b on the second executor, d fits into the gap before e
+  std::string testInput = R"(
+    a 6
+    b 1  a
+    c 6  b
+    d 3
+    e 5  b)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  const auto rankIds = computeRankIds(graph);
+  auto makespan = [&]() {
+    return *std::max_element(graph.endTimes.begin(), graph.endTimes.end());
+  };
+
+  schedule(2, rankIds, graph, builder::Placement::Append);
+  expectValidSchedule(graph, 2);
+  EXPECT_EQ(graph.startTimes[graph.at("e")], 7);
+  EXPECT_EQ(graph.startTimes[graph.at("d")], 12);
+  EXPECT_EQ(makespan(), 15);
+
+  schedule(2, rankIds, graph, builder::Placement::Insertion);
+  expectValidSchedule(graph, 2);
+  EXPECT_EQ(graph.startTimes[graph.at("e")], 7);
+  EXPECT_EQ(graph.startTimes[graph.at("d")], 0);
+  EXPECT_EQ(makespan(), 13);
+}
+
+TEST(InsertionScheduleTests, RandomDAGsAreValid) {
+  for (uint32_t seed = 0; seed < 5; ++seed) {
+    std::stringstream testStream(randomDAG(500, 4, seed));
+    auto graph = builder::load_graph(testStream);
+    builder::calculateRanks(graph);
+    for (builder::Id executors : {1, 3, 8}) {
+      schedule(executors, computeRankIds(graph), graph,
+               builder::Placement::Insertion);
+      expectValidSchedule(graph, executors);
+    }
+  }
+}
+
+TEST(GraphTests, ParallelRanksMatchSequential) {
+  builder::Executors heterogeneous;
+  heterogeneous.addClass("slow", 3, 1.0);
+  heterogeneous.addClass("fast", 2, 2.5);
+  // Wide levels near the End are calculated concurrently, deep narrow ones
+  // by one thread, short durations make many equal paths
+  std::stringstream testStream(randomDAG(30000, 3, 7));
+  auto graph = builder::load_graph(testStream);
+  for (const auto &executors :
+       {builder::Executors::identical(4), heterogeneous}) {
+    builder::calculateRanks(graph, executors);
+    const auto ranks = graph.ranks;
+    const auto longestPaths = graph.longestPaths;
+    const auto predecessors = graph.predecessors;
+    for (unsigned threadsNumber : {2u, 5u}) {
+      graph.resetSchedule();
+      builder::calculateRanks(graph, executors, threadsNumber);
+      EXPECT_EQ(graph.ranks, ranks);
+      EXPECT_EQ(graph.longestPaths, longestPaths);
+      EXPECT_EQ(graph.predecessors, predecessors);
+      EXPECT_TRUE(graph.ranksCalculated);
+    }
+  }
+}
+
+TEST(PlanOutputTests, ExecutionOrder) {
+  std::stringstream testStream(randomDAG(3000, 3, 11));
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  schedule(4, computeRankIds(graph), graph);
+  auto expectSortedByStartTime = [&]() {
+    std::vector<std::pair<builder::Time, builder::Id>> timeIds;
+    for (builder::Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+      timeIds.emplace_back(graph.startTimes[id], id);
+    }
+    std::sort(timeIds.begin(), timeIds.end());
+    const auto order = builder::getExecutionOrder(graph);
+    ASSERT_EQ(order.size(), timeIds.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      EXPECT_EQ(order[i], timeIds[i].second) << i;
+    }
+  };
+  expectSortedByStartTime();
+  // Start times which don't fit into 32 bits
+  for (builder::Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+    graph.startTimes[id] += (builder::Time{id % 5} << 33);
+  }
+  expectSortedByStartTime();
+}
+
+TEST(PlanOutputTests, Formats) {
+  std::stringstream testStream(R"(
+    a 10
+    b 3 a
+    c 1 a)");
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  schedule(2, computeRankIds(graph), graph);
+  auto output = [&](builder::PlanFormat format) {
+    std::stringstream plan;
+    builder::save_plan(graph, format, plan);
+    return plan.str();
+  };
+  EXPECT_EQ(output(builder::PlanFormat::Tsv), "a\t0\nb\t10\nc\t10\n");
+  EXPECT_EQ(output(builder::PlanFormat::Ndjson),
+            "{\"sha\":\"a\",\"executor\":0,\"start\":0,\"end\":10}\n"
+            "{\"sha\":\"b\",\"executor\":0,\"start\":10,\"end\":13}\n"
+            "{\"sha\":\"c\",\"executor\":1,\"start\":10,\"end\":11}\n");
+  const auto trace = output(builder::PlanFormat::ChromeTrace);
+  EXPECT_THAT(trace, HasSubstr("\"traceEvents\":[\n{\"name\":\"a\",\"ph\":"
+                               "\"X\",\"pid\":0,\"tid\":0,\"ts\":0,"
+                               "\"dur\":10},\n"));
+  EXPECT_THAT(trace, HasSubstr("\"tid\":1,\"ts\":10,\"dur\":1}\n]}\n"));
+
+  EXPECT_EQ(builder::parse_plan_format("trace"),
+            builder::PlanFormat::ChromeTrace);
+  EXPECT_THAT([]() { builder::parse_plan_format("xml"); },
+              ThrowsMessage<std::runtime_error>(
+                  HasSubstr("Unknown plan format 'xml'")));
+}
+
+TEST(EarliestFinishTimeTests, ExecutorSelection) {
+  const std::vector<builder::Time> available{5, 2, 9, 4, 2, 7, 3, 8, 6, 1};
+  auto choose = [&](builder::Time readyTime, builder::Id preferredExecutor) {
+    return builder::earliestStartExecutor(available.data(), available.size(),
+                                          readyTime, preferredExecutor);
+  };
+  // Best fit: the latest executor which is free when the action is ready
+  auto choice = choose(4, -1);
+  EXPECT_EQ(choice.executor, 3);
+  EXPECT_EQ(choice.start, 4);
+  // Preferred executor is taken if it is as good
+  choice = choose(4, 6);
+  EXPECT_EQ(choice.executor, 6);
+  EXPECT_EQ(choice.start, 4);
+  // but not if it is worse
+  choice = choose(4, 2);
+  EXPECT_EQ(choice.executor, 3);
+  // Nobody is free yet, the one which gets free first is taken
+  choice = choose(0, -1);
+  EXPECT_EQ(choice.executor, 9);
+  EXPECT_EQ(choice.start, 1);
+  // Equal times, the smallest Id wins
+  choice = choose(2, -1);
+  EXPECT_EQ(choice.executor, 1);
+  EXPECT_EQ(choice.start, 2);
+}
+
+TEST(EarliestFinishTimeTests, AppendScheduleKeepsChainsOnExecutor) {
+  for (uint32_t seed = 0; seed < 5; ++seed) {
+    std::stringstream testStream(randomDAG(500, 4, seed));
+    auto graph = builder::load_graph(testStream);
+    builder::calculateRanks(graph);
+    for (builder::Id executors : {1, 3, 8, 100}) {
+      schedule(executors, computeRankIds(graph), graph);
+      expectValidSchedule(graph, executors);
+    }
+  }
+
+  std::string testInput = R"(
+    a 2
+    b 1
+    c 1
+    d 3  a)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  schedule(3, computeRankIds(graph), graph);
+  EXPECT_EQ(graph.executorIds[graph.at("d")],
+            graph.executorIds[graph.at("a")]);
+  EXPECT_EQ(graph.startTimes[graph.at("d")], 2);
+}
+
+TEST(HeterogeneousExecutorsTests, LoadExecutors) {
+  std::stringstream actionsStream("a 10\nb 3 a");
+  auto graph = builder::load_graph(actionsStream);
+  std::stringstream executorsStream(R"(
+    executor fast 2 2.5
+    executor slow 3 1
+
+    duration b slow 9
+    duration b slow 7)");
+  auto executors = builder::load_executors(executorsStream, graph);
+  ASSERT_EQ(executors.classes.size(), 2u);
+  EXPECT_EQ(executors.size(), 5);
+  EXPECT_EQ(executors.classes[1].firstExecutor, 2);
+  EXPECT_FALSE(executors.isUniform());
+  EXPECT_EQ(executors.cost(graph, graph.at("a"), 0), 4);
+  EXPECT_EQ(executors.cost(graph, graph.at("a"), 1), 10);
+  EXPECT_EQ(executors.cost(graph, graph.at("b"), 0), 1);
+  EXPECT_EQ(executors.cost(graph, graph.at("b"), 1), 7);
+  // Only given durations are kept, the last one of an action and class
+  EXPECT_EQ(executors.durationOverrides.size(), 1u);
+  // (4 * 2 + 10 * 3) / 5
+  EXPECT_EQ(executors.averageCost(graph, graph.at("a")), 8);
+
+  auto load = [&](std::string input) {
+    std::stringstream stream(input);
+    builder::load_executors(stream, graph);
+  };
+  EXPECT_THAT([&]() { load(""); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("at least one")));
+  EXPECT_THAT([&]() { load("executor fast 0 1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+  EXPECT_THAT([&]() { load("executor fast 1 -1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+  EXPECT_THAT([&]() { load("executor fast 1 1\nexecutor fast 1 1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 2: ")));
+  EXPECT_THAT([&]() { load("executor fast 1 1\nduration c fast 1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("unknown action")));
+  EXPECT_THAT([&]() { load("duration a fast 1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("declared")));
+  EXPECT_THAT([&]() { load("executors fast 1 1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("format error")));
+}
+
+TEST(HeterogeneousExecutorsTests, DurationsOfTargetsCone) {
+  auto graph = builder::parse_graph("a 10\nb 3 a\nc 4\nd 6 b c\ne 2 a");
+  std::stringstream executorsStream(R"(
+    executor fast 1 2
+    executor slow 1 1
+    duration e slow 1
+    duration d fast 5
+    duration b slow 8
+    duration a fast 1)");
+  auto executors = builder::load_executors(executorsStream, graph);
+  // Targets are given with -T, durations of e and c are given for actions
+  // outside of the cone
+  const auto subgraph = builder::ancestorSubgraph(graph, {graph.at("b")});
+  executors.keepActionsOf(graph, subgraph);
+  ASSERT_EQ(executors.durationOverrides.size(), 2u);
+  EXPECT_EQ(executors.cost(subgraph, subgraph.at("a"), 0), 1);
+  EXPECT_EQ(executors.cost(subgraph, subgraph.at("a"), 1), 10);
+  EXPECT_EQ(executors.cost(subgraph, subgraph.at("b"), 0), 2);
+  EXPECT_EQ(executors.cost(subgraph, subgraph.at("b"), 1), 8);
+}
+
+TEST(HeterogeneousExecutorsTests, ActionsFinishOnFastestExecutors) {
+  std::string testInput = R"(
+    a 12
+    b 12
+    c 2 a b)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  builder::Executors executors;
+  executors.addClass("slow", 2, 1.0);
+  executors.addClass("fast", 1, 3.0);
+  builder::calculateRanks(graph, executors);
+  // Average durations are (12 * 2 + 4) / 3 for a and (2 * 2 + 1) / 3 for c
+  EXPECT_EQ(graph.longestPaths[graph.at("a")], 9 + 2);
+
+  for (auto placement :
+       {builder::Placement::Append, builder::Placement::Insertion}) {
+    schedule(executors, computeRankIds(graph), graph, placement);
+    expectValidSchedule(graph, executors);
+    // a and b take turns on the fast executor instead of 12 on a slow one
+    EXPECT_EQ(graph.executorIds[graph.at("a")], 2);
+    EXPECT_EQ(graph.executorIds[graph.at("b")], 2);
+    EXPECT_EQ(graph.endTimes[graph.at("c")], 9);
+  }
+
+  // Identical executors give the same schedule as the number of executors
+  for (uint32_t seed = 0; seed < 3; ++seed) {
+    std::stringstream randomStream(randomDAG(300, 4, seed));
+    auto graph = builder::load_graph(randomStream);
+    builder::calculateRanks(graph);
+    auto expected = graph;
+    schedule(4, computeRankIds(expected), expected);
+    builder::Executors uniform;
+    uniform.addClass("first", 1, 1.0);
+    uniform.addClass("rest", 3, 1.0);
+    builder::calculateRanks(graph, uniform);
+    EXPECT_EQ(graph.ranks, expected.ranks);
+    schedule(uniform, computeRankIds(graph), graph);
+    EXPECT_EQ(graph.endTimes, expected.endTimes);
+
+    executors.durationOverrides.clear();
+    builder::calculateRanks(graph, executors);
+    for (auto placement :
+         {builder::Placement::Append, builder::Placement::Insertion}) {
+      schedule(executors, computeRankIds(graph), graph, placement);
+      expectValidSchedule(graph, executors);
+    }
+  }
+}
+
+TEST(DataTransferTests, LoadDataSizes) {
+  std::stringstream testStream(R"(
+    a 1
+    b 2 a:100 a:50
+    c 1 b a
+    d 1 a:7 c:0)");
+  auto graph = builder::load_graph(testStream);
+  const auto a = graph.at("a");
+  const auto b = graph.at("b");
+  const auto d = graph.at("d");
+  ASSERT_EQ(graph.dependencies.dataSizes.size(),
+            graph.dependencies.targets.size());
+  EXPECT_EQ(graph.dependencies.size(b), 1);
+  EXPECT_EQ(graph.dependencies.dataSizes[graph.dependencies.offsets[b]], 100);
+  EXPECT_EQ(graph.dependencies.dataSizes[graph.dependencies.offsets[d]], 7);
+  // Dependents of a are b, c and d in order of Ids
+  const auto aDependents = graph.dependents.offsets[a];
+  EXPECT_EQ(graph.dependents.dataSizes[aDependents], 100);
+  EXPECT_EQ(graph.dependents.dataSizes[aDependents + 1], 0);
+  EXPECT_EQ(graph.dependents.dataSizes[aDependents + 2], 7);
+
+  const auto binaryPath =
+      std::filesystem::temp_directory_path() / "builder_test_graph.bin";
+  builder::save_binary_graph(graph, binaryPath, false);
+  auto loaded = builder::load_graph(binaryPath);
+  EXPECT_EQ(loaded.dependencies.dataSizes, graph.dependencies.dataSizes);
+  EXPECT_EQ(loaded.dependents.dataSizes, graph.dependents.dataSizes);
+  std::filesystem::remove(binaryPath);
+
+  for (std::string input : {"a 1\nb 1 a:", "a 1\nb 1 a:x", "a 1\nb 1 a:1x",
+                            "a 1\nb 1 a:99999999999999999999"}) {
+    std::stringstream errorStream(input);
+    EXPECT_THAT([&]() { builder::load_graph(errorStream); },
+                ThrowsMessage<std::runtime_error>(HasSubstr("Line 2: ")))
+        << input;
+  }
+}
+
+TEST(DataTransferTests, ChainsStayOnNode) {
+  std::string testInput = R"(
+    a 10
+    b 5 a:100
+    c 5 a:100)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  builder::Executors executors;
+  executors.addClass("first", 1, 1.0, "first");
+  executors.addClass("second", 1, 1.0, "second");
+
+  // Data is passed instantly without bandwidths
+  builder::calculateRanks(graph, executors);
+  schedule(executors, computeRankIds(graph), graph);
+  EXPECT_NE(graph.executorIds[graph.at("b")],
+            graph.executorIds[graph.at("c")]);
+  EXPECT_EQ(graph.endTimes[graph.at("c")], 15);
+
+  std::stringstream executorsStream(R"(
+    executor first 1 1 first
+    executor second 1 1 second
+    bandwidth 0 1)");
+  executors = builder::load_executors(executorsStream, graph);
+  ASSERT_EQ(executors.nodes.size(), 2u);
+  EXPECT_EQ(executors.transferCost(100, 0, 1), 100);
+  EXPECT_EQ(executors.transferCost(100, 1, 1), 0);
+  builder::calculateRanks(graph, executors);
+  // Half of executor pairs are on different nodes
+  EXPECT_EQ(graph.ranks[graph.at("a")], 10 + 50 + 5 + 1);
+  for (auto placement :
+       {builder::Placement::Append, builder::Placement::Insertion}) {
+    schedule(executors, computeRankIds(graph), graph, placement);
+    expectValidSchedule(graph, executors);
+    EXPECT_EQ(graph.executorIds[graph.at("b")],
+              graph.executorIds[graph.at("a")]);
+    EXPECT_EQ(graph.executorIds[graph.at("c")],
+              graph.executorIds[graph.at("a")]);
+    EXPECT_EQ(std::max(graph.endTimes[graph.at("b")],
+                       graph.endTimes[graph.at("c")]),
+              20);
+  }
+
+  // Data is passed to other nodes when it pays off
+  std::stringstream fastStream(R"(
+    executor first 1 1 first
+    executor second 1 1 second
+    bandwidth 0 100)");
+  executors = builder::load_executors(fastStream, graph);
+  builder::calculateRanks(graph, executors);
+  schedule(executors, computeRankIds(graph), graph);
+  EXPECT_NE(graph.executorIds[graph.at("b")],
+            graph.executorIds[graph.at("c")]);
+  EXPECT_EQ(std::max(graph.endTimes[graph.at("b")],
+                     graph.endTimes[graph.at("c")]),
+            16);
+
+  std::stringstream errorStream("executor first 1 1\nbandwidth -1 1");
+  EXPECT_THAT([&]() { builder::load_executors(errorStream, graph); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 2: ")));
+}
+
+void expectSamePlan(const builder::IncrementalPlan &plan,
+                    const builder::Executors &executors,
+                    builder::Placement placement) {
+  std::stringstream text;
+  builder::save_graph(plan.graph(), text);
+  auto graph = builder::parse_graph(text.str());
+  builder::calculateRanks(graph, executors);
+  const auto rankIds = computeRankIds(graph);
+  schedule(executors, rankIds, graph, placement);
+
+  EXPECT_EQ(plan.graph().shas.bytes, graph.shas.bytes);
+  EXPECT_EQ(plan.graph().dependencies.targets, graph.dependencies.targets);
+  EXPECT_EQ(plan.graph().ranks, graph.ranks);
+  EXPECT_EQ(plan.graph().longestPaths, graph.longestPaths);
+  EXPECT_EQ(plan.graph().predecessors, graph.predecessors);
+  EXPECT_EQ(plan.rankIds(), rankIds);
+  EXPECT_EQ(plan.graph().startTimes, graph.startTimes);
+  EXPECT_EQ(plan.graph().executorIds, graph.executorIds);
+}
+
+TEST(ResourceTests, TimelineFindAndOccupy) {
+  builder::ResourceTimeline timeline({10, 2});
+  EXPECT_TRUE(timeline.fits({10, 2}));
+  EXPECT_FALSE(timeline.fits({11, 1}));
+  EXPECT_FALSE(timeline.fits({0, 3}));
+  EXPECT_EQ(timeline.findStart(3, 5, {10, 2}), 3);
+
+  timeline.occupy(2, 4, {6, 1});
+  timeline.occupy(4, 6, {2, 1});
+  // Usage is {6, 1} on [2, 4), {8, 2} on [4, 6) and {2, 1} on [6, 10)
+  EXPECT_EQ(timeline.findStart(0, 3, {4, 1}), 0);
+  EXPECT_EQ(timeline.findStart(0, 3, {5, 1}), 6);
+  EXPECT_EQ(timeline.findStart(3, 2, {2, 0}), 3);
+  EXPECT_EQ(timeline.findStart(3, 2, {3, 0}), 6);
+  EXPECT_EQ(timeline.findStart(5, 1, {9, 0}), 10);
+  EXPECT_EQ(timeline.findStart(5, 0, {9, 0}), 5);
+
+  // Unlimited memory, only slots are kept
+  builder::ResourceTimeline slots({0, 1});
+  EXPECT_TRUE(slots.fits({1000, 1}));
+  slots.occupy(0, 5, {1000, 1});
+  EXPECT_EQ(slots.findStart(1, 2, {1, 1}), 5);
+}
+
+TEST(ResourceTests, LoadAndSaveDemands) {
+  std::stringstream testStream("a 3 memory=100\nb 2 a slots=4 memory=0\nc 1 b");
+  auto graph = builder::load_graph(testStream);
+  EXPECT_EQ(graph.demand(graph.at("a")).memory, 100);
+  EXPECT_EQ(graph.demand(graph.at("a")).slots, 1);
+  EXPECT_EQ(graph.demand(graph.at("b")).slots, 4);
+  EXPECT_EQ(graph.demand(graph.at("c")).memory, 0);
+  EXPECT_EQ(graph.dependencies.size(graph.at("b")), 1);
+
+  std::stringstream saved;
+  builder::save_graph(graph, saved);
+  auto reloaded = builder::load_graph(saved);
+  EXPECT_EQ(reloaded.memoryDemands, graph.memoryDemands);
+  EXPECT_EQ(reloaded.slotDemands, graph.slotDemands);
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "builder_test_demands.bin";
+  builder::save_binary_graph(graph, file, false);
+  auto loaded = builder::load_graph(file);
+  std::filesystem::remove(file);
+  EXPECT_EQ(loaded.memoryDemands, graph.memoryDemands);
+  EXPECT_EQ(loaded.slotDemands, graph.slotDemands);
+
+  auto load = [](std::string input) {
+    std::stringstream stream(input);
+    builder::load_graph(stream);
+  };
+  EXPECT_THAT([&]() { load("a 1 memory=-1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+  EXPECT_THAT([&]() { load("a 1 cpu=1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+  EXPECT_THAT([&]() { load("a 1 memory=99999999999999999999"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("too large")));
+
+  std::stringstream executorsStream(R"(
+    executor big 4 1 node1
+    capacity node1 1000 2)");
+  auto executors = builder::load_executors(executorsStream, graph);
+  ASSERT_TRUE(executors.hasCapacities());
+  EXPECT_EQ(executors.capacities[0].memory, 1000);
+  EXPECT_EQ(executors.capacities[0].slots, 2);
+  auto loadExecutors = [&](std::string input) {
+    std::stringstream stream(input);
+    builder::load_executors(stream, graph);
+  };
+  EXPECT_THAT([&]() { loadExecutors("executor e 1 1\ncapacity node2 1 1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 2: ")));
+  EXPECT_THAT([&]() { loadExecutors("executor e 1 1\ncapacity default 1"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("format error")));
+}
+
+/// @brief Check that demands of actions running at once on a node stay
+/// within its capacity at every time
+void expectWithinCapacities(const builder::Graph &graph,
+                            const builder::Executors &executors) {
+  const auto executorNodes = executors.executorNodes();
+  const auto nodesNumber = static_cast<builder::Id>(executors.nodes.size());
+  for (builder::Id node = 0; node < nodesNumber; ++node) {
+    // Usage changes only when actions start
+    for (builder::Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+      if (executorNodes[graph.executorIds[id]] != node ||
+          graph.startTimes[id] == graph.endTimes[id]) {
+        continue;
+      }
+      builder::Resources used{};
+      for (builder::Id other = graph.startId() + 1; other < graph.endId();
+           ++other) {
+        if (executorNodes[graph.executorIds[other]] == node &&
+            graph.startTimes[other] <= graph.startTimes[id] &&
+            graph.startTimes[id] < graph.endTimes[other]) {
+          used.memory += graph.demand(other).memory;
+          used.slots += graph.demand(other).slots;
+        }
+      }
+      const auto &capacity = executors.capacities[node];
+      if (capacity.memory > 0) {
+        EXPECT_LE(used.memory, capacity.memory);
+      }
+      if (capacity.slots > 0) {
+        EXPECT_LE(used.slots, capacity.slots);
+      }
+    }
+  }
+}
+
+TEST(ResourceTests, ActionsStayWithinCapacities) {
+  // Big actions don't fit on the node together although executors are free
+  std::stringstream testStream(R"(
+    a 4 memory=6
+    b 4 memory=6
+    c 4 memory=6
+    d 1 memory=1)");
+  auto graph = builder::load_graph(testStream);
+  builder::Executors executors;
+  executors.addClass("cpu", 4, 1.0, "node");
+  executors.setCapacity("node", {10, 0});
+  builder::calculateRanks(graph, executors);
+  const auto rankIds = computeRankIds(graph);
+  auto makespan = [&]() {
+    return *std::max_element(graph.endTimes.begin(), graph.endTimes.end());
+  };
+  for (auto placement :
+       {builder::Placement::Append, builder::Placement::Insertion}) {
+    schedule(executors, rankIds, graph, placement);
+    expectValidSchedule(graph, executors);
+    expectWithinCapacities(graph, executors);
+    EXPECT_EQ(makespan(), 12);
+    EXPECT_EQ(graph.startTimes[graph.at("d")], 0);
+  }
+  builder::scheduleWithLookahead(executors, rankIds, graph);
+  expectWithinCapacities(graph, executors);
+  EXPECT_EQ(makespan(), 12);
+
+  executors.setCapacity("node", {5, 0});
+  EXPECT_THAT(
+      [&]() { schedule(executors, rankIds, graph); },
+      ThrowsMessage<std::runtime_error>(HasSubstr("more resources")));
+
+  // Random demands on two nodes with limited slots and memory
+  for (uint32_t seed = 0; seed < 3; ++seed) {
+    std::stringstream randomStream(randomDAG(300, 3, seed));
+    auto random = builder::load_graph(randomStream);
+    std::mt19937 generator(seed);
+    for (builder::Id id = random.startId() + 1; id < random.endId(); ++id) {
+      random.setDemand(id, {static_cast<int64_t>(generator() % 8),
+                            static_cast<int32_t>(generator() % 3)});
+    }
+    builder::Executors nodes;
+    nodes.addClass("small", 4, 1.0, "small");
+    nodes.addClass("large", 6, 2.0, "large");
+    nodes.setCapacity("small", {8, 3});
+    nodes.setCapacity("large", {12, 4});
+    builder::calculateRanks(random, nodes);
+    const auto randomRankIds = computeRankIds(random);
+    for (auto placement :
+         {builder::Placement::Append, builder::Placement::Insertion}) {
+      schedule(nodes, randomRankIds, random, placement);
+      expectValidSchedule(random, nodes);
+      expectWithinCapacities(random, nodes);
+    }
+    builder::scheduleWithLookahead(nodes, randomRankIds, random);
+    expectValidSchedule(random, nodes);
+    expectWithinCapacities(random, nodes);
+  }
+}
+
+TEST(IncrementalPlanTests, EditsAndErrors) {
+  std::stringstream testStream(R"(
+    a 3
+    b 2 a
+    c 4 b
+    d 1
+    e 5 d)");
+  builder::IncrementalPlan plan(builder::load_graph(testStream),
+                                builder::Executors::identical(2));
+
+  EXPECT_THAT([&]() { plan.addAction("a", 1, {}); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("already defined")));
+  EXPECT_THAT([&]() { plan.addAction("f", 1, {"x"}); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("no action x")));
+  EXPECT_THAT([&]() { plan.changeDuration("a", 0); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("positive")));
+  EXPECT_THAT([&]() { plan.addEdge("a", "c"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("declared before")));
+  EXPECT_THAT([&]() { plan.removeEdge("c", "a"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("doesn't depend")));
+
+  // Longer c moves before e in the rank order, actions before stay planned
+  plan.changeDuration("c", 5);
+  auto stats = plan.replan();
+  EXPECT_EQ(stats.firstRescheduledPosition, 3u);
+  EXPECT_EQ(stats.recalculatedRanks, 4);
+  expectSamePlan(plan, builder::Executors::identical(2),
+                 builder::Placement::Append);
+
+  plan.removeAction("b");
+  plan.addAction("f", 2, {"c", "e"});
+  plan.addAction("b", 7, {"a"});
+  plan.addEdge("c", "a");
+  plan.removeEdge("e", "d");
+  plan.replan();
+  EXPECT_EQ(plan.graph().shas.bytes, "$tartacdef" "b#nd");
+  expectSamePlan(plan, builder::Executors::identical(2),
+                 builder::Placement::Append);
+  EXPECT_EQ(plan.replan().firstRescheduledPosition, plan.rankIds().size());
+
+  // Overridden durations follow their actions to new Ids
+  std::stringstream overridesGraphStream("a 3\nb 2 a\nc 4 b");
+  auto overridesGraph = builder::load_graph(overridesGraphStream);
+  std::stringstream executorsStream("executor only 2 1\nduration c only 40");
+  auto overridesExecutors =
+      builder::load_executors(executorsStream, overridesGraph);
+  builder::IncrementalPlan overridesPlan(std::move(overridesGraph),
+                                         std::move(overridesExecutors));
+  overridesPlan.removeAction("b");
+  overridesPlan.replan();
+  const auto &replanned = overridesPlan.graph();
+  const auto c = replanned.at("c");
+  EXPECT_EQ(replanned.endTimes[c] - replanned.startTimes[c], 40);
+}
+
+TEST(IncrementalPlanTests, RandomEditsMatchFullReplan) {
+  builder::Executors heterogeneous;
+  heterogeneous.addClass("slow", 3, 1.0, "first");
+  heterogeneous.addClass("fast", 2, 2.5, "second");
+  heterogeneous.interNodeBandwidth = 10;
+
+  for (uint32_t seed = 0; seed < 4; ++seed) {
+    const auto executors =
+        seed % 2 ? heterogeneous : builder::Executors::identical(4);
+    const auto placement = seed < 2 ? builder::Placement::Append
+                                    : builder::Placement::Insertion;
+    std::stringstream testStream(randomDAG(400, 4, seed));
+    builder::IncrementalPlan plan(builder::load_graph(testStream), executors,
+                                  placement);
+    std::mt19937 random(seed);
+    int32_t added{0};
+    for (int32_t round = 0; round < 20; ++round) {
+      // A few random edits of every kind, invalid ones are skipped
+      for (int32_t edit = 0; edit < 5; ++edit) {
+        const auto &graph = plan.graph();
+        auto randomSha = [&]() {
+          return std::string(
+              graph.shas[1 + random() % (graph.size() - 2)]);
+        };
+        const auto sha = randomSha();
+        const auto other = randomSha();
+        try {
+          switch (random() % 5) {
+          case 0:
+            plan.changeDuration(sha, random() % 20 + 1);
+            break;
+          case 1:
+            plan.addAction("added" + std::to_string(added++),
+                           random() % 20 + 1, {sha, other});
+            break;
+          case 2:
+            if (graph.size() > 10) {
+              plan.removeAction(sha);
+            }
+            break;
+          case 3:
+            plan.addEdge(std::max(sha, other, [&](auto &lhs, auto &rhs) {
+                           return graph.at(lhs) < graph.at(rhs);
+                         }),
+                         std::min(sha, other, [&](auto &lhs, auto &rhs) {
+                           return graph.at(lhs) < graph.at(rhs);
+                         }),
+                         random() % 50);
+            break;
+          default:
+            plan.removeEdge(sha, other);
+          }
+        } catch (std::runtime_error &) {
+        }
+      }
+      const auto stats = plan.replan();
+      EXPECT_LE(stats.recalculatedRanks, plan.graph().size());
+      expectSamePlan(plan, executors, placement);
+    }
+  }
+}
+
+TEST(SweepTests, KneeOfNonMonotonicSweep) {
+  auto knee = [](std::vector<std::pair<builder::Id, builder::Time>> plans) {
+    std::vector<builder::SweepPoint> points;
+    for (auto &[executorsNumber, makespan] : plans) {
+      points.push_back({executorsNumber, makespan});
+    }
+    return builder::findKnee(points);
+  };
+  EXPECT_EQ(knee({}), -1);
+  EXPECT_EQ(knee({{4, 100}}), 0);
+  EXPECT_EQ(knee({{1, 100}, {2, 50}, {4, 25}}), 2);
+  EXPECT_EQ(knee({{1, 100}, {2, 50}, {4, 48}, {8, 47}}), 1);
+  // Makespan goes up with 3 executors, 4 and 5 pay off again from 2
+  EXPECT_EQ(knee({{1, 100}, {2, 60}, {3, 70}, {4, 30}, {5, 29}}), 3);
+  // A step from the bump pays off, but not from the point before it
+  EXPECT_EQ(knee({{1, 100}, {2, 50}, {3, 80}, {4, 49}}), 1);
+}
+
+TEST(SweepTests, ParseRange) {
+  EXPECT_THAT(builder::parse_concurrency_sweep("2:10:4"),
+              ElementsAre(2, 6, 10));
+  EXPECT_THAT(builder::parse_concurrency_sweep("3:5"), ElementsAre(3, 4, 5));
+  EXPECT_THAT(builder::parse_concurrency_sweep("7:7:3"), ElementsAre(7));
+  for (auto range : {"", "0:4", "5:4", "1:4:0", "1:x", "1:2:3:4", "-1:4",
+                     "1::2", "1:9999999999"}) {
+    EXPECT_THROW(builder::parse_concurrency_sweep(range), std::runtime_error)
+        << range;
+  }
+}
+
+TEST(SweepTests, MatchesSeparateSchedules) {
+  std::stringstream testStream(randomDAG(2000, 3, 11));
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  const auto executorsNumbers = builder::parse_concurrency_sweep("1:2000:111");
+  for (auto placement :
+       {builder::Placement::Append, builder::Placement::Insertion}) {
+    const auto sweep =
+        builder::sweepConcurrency(graph, executorsNumbers, placement, 3);
+    ASSERT_EQ(sweep.points.size(), executorsNumbers.size());
+    builder::Time busyTime{0};
+    for (builder::Id id = 1; id < graph.endId(); ++id) {
+      busyTime += graph.durations[id];
+    }
+    for (size_t index = 0; index < executorsNumbers.size(); ++index) {
+      const auto &point = sweep.points[index];
+      schedule(executorsNumbers[index], computeRankIds(graph), graph,
+               placement);
+      const auto criticalPath = getCriticalPath(graph);
+      const auto makespan =
+          *std::max_element(graph.endTimes.begin(), graph.endTimes.end());
+      EXPECT_EQ(point.executorsNumber, executorsNumbers[index]);
+      EXPECT_EQ(point.makespan, makespan);
+      EXPECT_DOUBLE_EQ(point.utilization,
+                       static_cast<double>(busyTime) /
+                           (makespan * executorsNumbers[index]));
+      EXPECT_DOUBLE_EQ(point.criticalPathRatio,
+                       static_cast<double>(makespan) /
+                           criticalPath.infiniteExecutorsLength);
+    }
+    // One executor does all the work, plenty of them follow the critical path
+    EXPECT_DOUBLE_EQ(sweep.points.front().utilization, 1);
+    EXPECT_DOUBLE_EQ(sweep.points.back().criticalPathRatio, 1);
+    EXPECT_LE(sweep.knee, sweep.saturation);
+    EXPECT_EQ(sweep.points[sweep.saturation].makespan,
+              graph.longestPaths[graph.predecessors[graph.startId()]]);
+  }
+}
+
+TEST(SchedulerTests, AllSchedulersMakeValidPlans) {
+  builder::Executors heterogeneous;
+  heterogeneous.addClass("slow", 3, 1.0, "first");
+  heterogeneous.addClass("fast", 2, 2.5, "second");
+  EXPECT_THROW(builder::makeScheduler("fifo"), std::runtime_error);
+
+  for (uint32_t seed = 0; seed < 4; ++seed) {
+    std::stringstream testStream(randomDAG(300, 3, seed));
+    auto graph = builder::load_graph(testStream);
+    const auto executors =
+        seed % 2 ? heterogeneous : builder::Executors::identical(4);
+    builder::calculateRanks(graph, executors);
+    const auto ranks = graph.ranks;
+    for (auto placement :
+         {builder::Placement::Append, builder::Placement::Insertion}) {
+      schedule(executors, computeRankIds(graph), graph, placement);
+      const auto heftEndTimes = graph.endTimes;
+      builder::Time shortest{std::numeric_limits<builder::Time>::max()};
+      for (auto name : builder::schedulerNames()) {
+        SCOPED_TRACE(std::string(name));
+        const auto scheduler = builder::makeScheduler(name);
+        EXPECT_EQ(scheduler->name(), name);
+        const auto usedName = scheduler->schedule(executors, graph, placement);
+        expectValidSchedule(graph, executors);
+        EXPECT_EQ(graph.ranks, ranks);
+        if (name == "heft") {
+          EXPECT_EQ(graph.endTimes, heftEndTimes);
+        }
+        if (name == "best") {
+          EXPECT_NE(usedName, "best");
+          EXPECT_EQ(builder::makespan(graph), shortest);
+        } else {
+          EXPECT_EQ(usedName, name);
+          shortest = std::min(shortest, builder::makespan(graph));
+        }
+      }
+    }
+  }
+}
+
+TEST(SchedulerTests, CpopPinsCriticalPath) {
+  // a, c, e is the critical path, it stays on the fast executor even though
+  // c would start earlier on a slow one
+  std::string testInput = R"(
+    a 8
+    b 8
+    c 8  a  b
+    d 2  b
+    e 8  c)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  builder::Executors executors;
+  executors.addClass("slow", 2, 1.0);
+  executors.addClass("fast", 1, 2.0);
+  builder::calculateRanks(graph, executors);
+  builder::makeScheduler("cpop")->schedule(executors, graph,
+                                           builder::Placement::Append);
+  expectValidSchedule(graph, executors);
+  for (auto sha : {"a", "c", "e"}) {
+    EXPECT_EQ(graph.executorIds[graph.at(sha)], 2) << sha;
+  }
+  EXPECT_NE(graph.executorIds[graph.at("b")], 2);
+}
+
+TEST(SlackTests, SlackAndNearCriticalActions) {
+  // a-c-d is critical, b may start up to 4 later, e up to 3 later
+  std::string testInput = R"(
+    a 5
+    b 1
+    c 3  a  b
+    d 2  c
+    e 2  a)";
+  std::stringstream testStream(testInput);
+  auto graph = builder::load_graph(testStream);
+  const auto slack = builder::calculateSlack(graph);
+  EXPECT_EQ(slack.length, 10);
+  EXPECT_EQ(slack.earliestStarts[graph.at("c")], 5);
+  EXPECT_EQ(slack.latestStarts[graph.at("b")], 4);
+  EXPECT_EQ(slack.slack(graph.at("a")), 0);
+  EXPECT_EQ(slack.slack(graph.at("b")), 4);
+  EXPECT_EQ(slack.slack(graph.at("d")), 0);
+  EXPECT_EQ(slack.slack(graph.at("e")), 3);
+
+  auto shas = [&](const std::vector<builder::Id> &ids) {
+    std::vector<std::string> result;
+    for (auto id : ids) {
+      result.emplace_back(graph.shas[id]);
+    }
+    return result;
+  };
+  // Critical ones by decreasing duration
+  EXPECT_THAT(shas(builder::nearCriticalActions(graph, slack, 0)),
+              ElementsAre("a", "c", "d"));
+  EXPECT_THAT(shas(builder::nearCriticalActions(graph, slack, 3)),
+              ElementsAre("a", "c", "d", "e"));
+
+  const auto paths = builder::longestPaths(graph, slack, 10);
+  ASSERT_EQ(paths.size(), 3u);
+  EXPECT_EQ(paths[0].length, 10);
+  EXPECT_THAT(shas(paths[0].ids), ElementsAre("a", "c", "d"));
+  EXPECT_EQ(paths[1].length, 7);
+  EXPECT_THAT(shas(paths[1].ids), ElementsAre("a", "e"));
+  EXPECT_EQ(paths[2].length, 6);
+  EXPECT_THAT(shas(paths[2].ids), ElementsAre("b", "c", "d"));
+  EXPECT_TRUE(builder::longestPaths(graph, slack, 0).empty());
+}
+
+TEST(SlackTests, LongestPathsMatchAllPaths) {
+  for (uint32_t seed = 0; seed < 5; ++seed) {
+    std::stringstream testStream(randomDAG(40, 2, seed));
+    auto graph = builder::load_graph(testStream);
+    const auto slack = builder::calculateSlack(graph);
+
+    // Lengths of all paths from the Start to the End by depth first search
+    std::vector<builder::Time> lengths;
+    std::function<void(builder::Id, builder::Time)> walk =
+        [&](builder::Id id, builder::Time length) {
+          if (id == graph.endId()) {
+            lengths.push_back(length);
+            return;
+          }
+          if (id != graph.startId()) {
+            length += graph.durations[id];
+          }
+          for (auto dependent = graph.dependents.begin(id);
+               dependent != graph.dependents.end(id); ++dependent) {
+            walk(*dependent, length);
+          }
+        };
+    walk(graph.startId(), 0);
+    std::sort(lengths.rbegin(), lengths.rend());
+
+    const size_t pathsNumber = std::min<size_t>(50, lengths.size());
+    const auto paths = builder::longestPaths(graph, slack, pathsNumber);
+    ASSERT_EQ(paths.size(), pathsNumber);
+    EXPECT_EQ(paths[0].length, slack.length);
+    for (size_t index = 0; index < pathsNumber; ++index) {
+      EXPECT_EQ(paths[index].length, lengths[index]);
+      builder::Time length{0};
+      for (size_t step = 0; step < paths[index].ids.size(); ++step) {
+        const builder::Id id = paths[index].ids[step];
+        length += graph.durations[id];
+        if (step > 0) {
+          EXPECT_LE(slack.earliestStarts[paths[index].ids[step - 1]] +
+                        graph.durations[paths[index].ids[step - 1]],
+                    slack.earliestStarts[id]);
+        }
+      }
+      EXPECT_EQ(length, paths[index].length);
+    }
+    for (builder::Id id = graph.startId(); id <= graph.endId(); ++id) {
+      EXPECT_GE(slack.slack(id), 0);
+    }
+  }
+}
+
+TEST(DurationModelTests, EstimatesAndFallbacks) {
+  builder::DurationModel model;
+  for (builder::Time duration : {10, 20, 30, 40, 100}) {
+    model.observe("a", duration);
+  }
+  const builder::Id a = model.find("a");
+  ASSERT_EQ(a, 0);
+  EXPECT_EQ(model.find("b"), -1);
+  EXPECT_EQ(model.counts[a], 5);
+  EXPECT_EQ(model.estimate(a, builder::Estimator::Mean), 40);
+  EXPECT_EQ(model.estimate(a, builder::Estimator::Median), 30);
+  EXPECT_EQ(model.estimate(a, builder::Estimator::P90), 100);
+  // Moving average weighs recent runs most
+  EXPECT_GT(model.estimate(a, builder::Estimator::Ewma), 40);
+  EXPECT_LT(model.estimate(a, builder::Estimator::Ewma), 100);
+  // Percentiles are of the recent window only
+  for (int64_t run = 0; run < builder::DurationModel::windowSize; ++run) {
+    model.observe("a", 7);
+  }
+  EXPECT_EQ(model.estimate(a, builder::Estimator::P90), 7);
+  // Mean of all runs is 312 / 21
+  EXPECT_EQ(model.estimate(a, builder::Estimator::Mean), 15);
+  EXPECT_EQ(builder::parse_estimator("p90"), builder::Estimator::P90);
+  EXPECT_THAT([]() { builder::parse_estimator("max"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Unknown")));
+
+  // Inputs underestimate observed actions 3 times, so unseen ones are
+  // corrected by the same factor
+  std::stringstream testStream("a 5\nb 10 a\nc 4 b\nd 6");
+  auto graph = builder::load_graph(testStream);
+  builder::DurationModel learned;
+  builder::parse_log(learned, "b 30\nc 12 0\nc 12\n\n");
+  const auto update =
+      builder::applyDurationModel(graph, learned, builder::Estimator::Mean);
+  EXPECT_EQ(update.observed, 2);
+  EXPECT_EQ(update.unseen, 2);
+  EXPECT_DOUBLE_EQ(update.fallbackScale, 3);
+  EXPECT_EQ(graph.durations[graph.at("a")], 15);
+  EXPECT_EQ(graph.durations[graph.at("b")], 30);
+  EXPECT_EQ(graph.durations[graph.at("c")], 12);
+  EXPECT_EQ(graph.durations[graph.at("d")], 18);
+  EXPECT_FALSE(graph.ranksCalculated);
+}
+
+TEST(DurationModelTests, IngestAndStore) {
+  // Durations on executors of speed 2 are twice as long on speed 1
+  builder::Executors executors;
+  executors.addClass("slow", 1, 1.0);
+  executors.addClass("fast", 2, 2.0);
+  builder::DurationModel model;
+  EXPECT_EQ(builder::parse_log(model, "a 10 0\n  b 10 2  \r\n", &executors),
+            2);
+  EXPECT_EQ(model.estimate(model.find("a"), builder::Estimator::Mean), 10);
+  EXPECT_EQ(model.estimate(model.find("b"), builder::Estimator::Mean), 20);
+  auto ingest = [&](std::string log) {
+    builder::parse_log(model, log, &executors);
+  };
+  EXPECT_THAT([&]() { ingest("a 10\nb 10 3"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 2: ")));
+  EXPECT_THAT([&]() { ingest("a -10"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+  EXPECT_THAT([&]() { ingest("a 10 1 x"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+
+  // Stream is ingested in blocks which split lines
+  std::string log;
+  std::mt19937 random(7);
+  for (int record = 0; record < 100000; ++record) {
+    log += "action" + std::to_string(random() % 5000) + " " +
+           std::to_string(random() % 1000) + " " +
+           std::to_string(random() % 3) + "\n";
+  }
+  builder::DurationModel whole, streamed;
+  EXPECT_EQ(builder::parse_log(whole, log), 100000);
+  std::stringstream logStream(log + "last 1");
+  EXPECT_EQ(builder::ingest_log(streamed, logStream), 100001);
+  EXPECT_EQ(streamed.find("last"), streamed.size() - 1);
+  EXPECT_EQ(streamed.counts.size(), whole.counts.size() + 1);
+  EXPECT_TRUE(std::equal(whole.means.begin(), whole.means.end(),
+                         streamed.means.begin()));
+  std::stringstream badStream(log + "last x");
+  EXPECT_THAT([&]() { builder::ingest_log(streamed, badStream); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 100001: ")));
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "builder_test_durations.bin";
+  builder::save_duration_model(whole, file);
+  builder::save_duration_model(whole, file);
+  auto loaded = builder::load_duration_model(file);
+  std::filesystem::remove(file);
+  // Models are written to temporary files of unique names, none is left
+  // after a successful or a failed save
+  auto temporaries = [&]() {
+    const auto prefix = file.filename().string() + ".tmp";
+    int count{0};
+    for (auto &entry :
+         std::filesystem::directory_iterator(file.parent_path())) {
+      count += entry.path().filename().string().rfind(prefix, 0) == 0;
+    }
+    return count;
+  };
+  EXPECT_EQ(temporaries(), 0);
+  // Model can't be renamed over a directory
+  std::filesystem::create_directories(file / "x");
+  EXPECT_THROW(builder::save_duration_model(whole, file),
+               std::filesystem::filesystem_error);
+  EXPECT_EQ(temporaries(), 0);
+  std::filesystem::remove_all(file);
+  EXPECT_EQ(loaded.shas.bytes, whole.shas.bytes);
+  EXPECT_EQ(loaded.counts, whole.counts);
+  EXPECT_EQ(loaded.means, whole.means);
+  EXPECT_EQ(loaded.ewmas, whole.ewmas);
+  EXPECT_EQ(loaded.windows, whole.windows);
+  EXPECT_EQ(loaded.find("action42"), whole.find("action42"));
+  loaded.observe("action42", 1);
+  EXPECT_EQ(loaded.counts[loaded.find("action42")],
+            whole.counts[whole.find("action42")] + 1);
+}
+
+TEST(DurationModelTests, LoadCorruptedFile) {
+  builder::DurationModel model;
+  builder::parse_log(model, "a 10\nbb 20\nbb 30");
+  const auto file =
+      std::filesystem::temp_directory_path() / "builder_test_corrupted.bin";
+  builder::save_duration_model(model, file);
+  std::string data;
+  {
+    std::ifstream fi(file, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(fi), {});
+  }
+  auto load = [&](const std::string &damaged) {
+    std::ofstream(file, std::ios::binary) << damaged;
+    builder::load_duration_model(file);
+  };
+  auto begin = [&](const auto &array) {
+    const std::string arrayBytes(
+        reinterpret_cast<const char *>(array.data()),
+        array.size() * sizeof(array[0]));
+    const auto found = data.find(arrayBytes);
+    EXPECT_NE(found, std::string::npos);
+    return found;
+  };
+  auto replace = [&](const auto &array, size_t element, auto value) {
+    auto damaged = data;
+    std::memcpy(&damaged[begin(array) + element * sizeof(value)], &value,
+                sizeof(value));
+    return damaged;
+  };
+  EXPECT_NO_THROW(load(data));
+  // SHA of bb ends before it begins
+  EXPECT_THAT([&]() { load(replace(model.shas.offsets, 1, int64_t{5})); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("offsets")));
+  auto slots = data;
+  const builder::Id wrongId{1000};
+  for (size_t slot = 0; slot < model.shaIndex.slots.size(); ++slot) {
+    std::memcpy(&slots[begin(model.shaIndex.slots) + slot * sizeof(wrongId)],
+                &wrongId, sizeof(wrongId));
+  }
+  EXPECT_THAT([&]() { load(slots); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("SHA index")));
+  EXPECT_THAT([&]() { load(replace(model.counts, 1, int64_t{0})); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("counts")));
+  std::filesystem::remove(file);
+}
+
+TEST(SimulationTests, DeviationsInputAndModel) {
+  std::stringstream testStream("a 100 deviation=20\nb 50 a memory=8\nc 30");
+  auto graph = builder::load_graph(testStream);
+  EXPECT_EQ(graph.deviation(graph.at("a")), 20);
+  EXPECT_EQ(graph.deviation(graph.at("b")), 0);
+  EXPECT_THAT([]() { builder::parse_graph("a 1 deviation=x"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+
+  std::stringstream saved;
+  builder::save_graph(graph, saved);
+  EXPECT_EQ(builder::load_graph(saved).deviations, graph.deviations);
+  const auto file =
+      std::filesystem::temp_directory_path() / "builder_test_graph.bin";
+  builder::save_binary_graph(graph, file, false);
+  auto loaded = builder::load_graph(file);
+  std::filesystem::remove(file);
+  EXPECT_EQ(loaded.deviations, graph.deviations);
+  EXPECT_EQ(loaded.memoryDemands, graph.memoryDemands);
+
+  // Deviations are learned from runs, a single run has none
+  builder::DurationModel model;
+  builder::parse_log(model, "a 90\na 110\nc 30\n");
+  builder::applyDurationModel(graph, model, builder::Estimator::Mean);
+  EXPECT_EQ(graph.durations[graph.at("a")], 100);
+  EXPECT_EQ(graph.deviation(graph.at("a")), 14);
+  EXPECT_EQ(graph.deviation(graph.at("c")), 0);
+}
+
+TEST(SimulationTests, MakespanDistribution) {
+  std::stringstream testStream(R"(
+    a 100 deviation=30
+    b 40
+    c 20 a b
+    d 60 deviation=10
+    e 10 c d)");
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  const auto executors = builder::Executors::identical(2);
+  builder::schedule(2, builder::computeRankIds(graph), graph);
+
+  const size_t samplesNumber{20000};
+  const auto sequential =
+      builder::simulateMakespans(graph, executors, samplesNumber, 3, 1);
+  const auto parallel =
+      builder::simulateMakespans(graph, executors, samplesNumber, 3, 4);
+  EXPECT_EQ(sequential.makespans, parallel.makespans);
+  EXPECT_EQ(sequential.criticalCounts, parallel.criticalCounts);
+  EXPECT_EQ(sequential.planned, builder::makespan(graph));
+  ASSERT_EQ(sequential.makespans.size(), samplesNumber);
+  EXPECT_TRUE(std::is_sorted(sequential.makespans.begin(),
+                             sequential.makespans.end()));
+  // Mean duration of a is as planned, but the makespan only grows with it
+  EXPECT_GT(sequential.mean(), sequential.planned);
+  EXPECT_LT(sequential.percentile(0.5), sequential.percentile(0.99));
+  EXPECT_EQ(sequential.percentile(1), sequential.makespans.back());
+  EXPECT_EQ(sequential.criticalCounts[graph.at("e")], samplesNumber);
+  EXPECT_GT(sequential.criticalCounts[graph.at("a")], samplesNumber / 2);
+
+  // Exact durations give the plan in every sample
+  graph.deviations.assign(graph.size(), 0);
+  const auto exact = builder::simulateMakespans(graph, executors, 100);
+  EXPECT_EQ(exact.makespans.front(), exact.planned);
+  EXPECT_EQ(exact.makespans.back(), exact.planned);
+  for (auto count : exact.criticalCounts) {
+    EXPECT_TRUE(count == 0 || count == 100);
+  }
+
+  // Sampled durations keep their means
+  std::stringstream singleStream("a 100 deviation=20");
+  auto single = builder::load_graph(singleStream);
+  builder::calculateRanks(single);
+  builder::schedule(1, builder::computeRankIds(single), single);
+  const auto sampled = builder::simulateMakespans(
+      single, builder::Executors::identical(1), samplesNumber);
+  EXPECT_NEAR(sampled.mean(), 100, 1);
+  const auto deviationRank = sampled.percentile(0.8413);
+  EXPECT_NEAR(deviationRank, 119, 3);
+}
+
+TEST(PlanCacheTests, GraphHash) {
+  // Arrays of the graph take several blocks
+  std::string testInput;
+  for (int i = 0; i < 100000; ++i) {
+    testInput += "action" + std::to_string(i) + " " +
+                 std::to_string(1 + i % 7);
+    if (i > 0) {
+      testInput += " action" + std::to_string(i / 2);
+    }
+    testInput += "\n";
+  }
+  auto graph = builder::parse_graph(testInput, 1);
+  const auto hash = builder::hashGraph(graph, 1);
+  EXPECT_EQ(builder::hashGraph(graph, 4), hash);
+  EXPECT_EQ(hash.hex().size(), 32u);
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "builder_test_graph.bin";
+  builder::calculateRanks(graph);
+  builder::save_binary_graph(graph, file, true);
+  EXPECT_EQ(builder::hashGraph(builder::load_graph(file)), hash);
+  std::filesystem::remove(file);
+
+  graph.durations[graph.at("action77777")] += 1;
+  EXPECT_NE(builder::hashGraph(graph), hash);
+
+  const auto executors = builder::Executors::identical(4);
+  const auto key = builder::makePlanKey(hash, executors, "heft",
+                                        builder::Placement::Append);
+  EXPECT_EQ(builder::makePlanKey(hash, executors, "heft",
+                                 builder::Placement::Append),
+            key);
+  EXPECT_NE(builder::makePlanKey(hash, executors, "cpop",
+                                 builder::Placement::Append),
+            key);
+  EXPECT_NE(builder::makePlanKey(hash, executors, "heft",
+                                 builder::Placement::Insertion),
+            key);
+  EXPECT_NE(builder::makePlanKey(hash, builder::Executors::identical(5),
+                                 "heft", builder::Placement::Append),
+            key);
+}
+
+TEST(PlanCacheTests, StoreLoadAndEvict) {
+  std::string testInput = R"(
+    a 3
+    b 2
+    c 1  a  b
+    d 4  b)";
+  auto graph = builder::parse_graph(testInput);
+  builder::calculateRanks(graph);
+  builder::schedule(2, builder::computeRankIds(graph), graph);
+  const auto criticalPath = builder::getCriticalPath(graph);
+  const auto executors = builder::Executors::identical(2);
+  const auto key = builder::makePlanKey(builder::hashGraph(graph), executors,
+                                        "heft", builder::Placement::Append);
+
+  const auto directory =
+      std::filesystem::temp_directory_path() / "builder_test_plan_cache";
+  std::filesystem::remove_all(directory);
+  auto cached = builder::parse_graph(testInput);
+  builder::CriticalPath cachedPath;
+  EXPECT_FALSE(
+      builder::load_cached_plan(directory, key, cached, cachedPath));
+  builder::save_cached_plan(directory, key, graph, criticalPath, 1 << 20);
+  ASSERT_TRUE(builder::load_cached_plan(directory, key, cached, cachedPath));
+  EXPECT_FALSE(cached.ranksCalculated);
+  EXPECT_EQ(cached.startTimes, graph.startTimes);
+  EXPECT_EQ(cached.endTimes, graph.endTimes);
+  EXPECT_EQ(cached.executorIds, graph.executorIds);
+  EXPECT_EQ(cachedPath.actionsShas, criticalPath.actionsShas);
+  EXPECT_EQ(cachedPath.infiniteExecutorsLength,
+            criticalPath.infiniteExecutorsLength);
+  EXPECT_EQ(cachedPath.actualExecutorsLength,
+            criticalPath.actualExecutorsLength);
+
+  // Damaged entry is removed
+  const auto file = directory / (key.hex() + ".plan");
+  const auto entrySize = std::filesystem::file_size(file);
+  {
+    std::fstream entry(file, std::ios::in | std::ios::out | std::ios::binary);
+    entry.seekp(entrySize - 20);
+    entry.put('\x7f');
+  }
+  EXPECT_FALSE(builder::load_cached_plan(directory, key, cached, cachedPath));
+  EXPECT_FALSE(std::filesystem::exists(file));
+  builder::save_cached_plan(directory, key, graph, criticalPath, 1 << 20);
+  std::filesystem::resize_file(file, entrySize - 8);
+  EXPECT_FALSE(builder::load_cached_plan(directory, key, cached, cachedPath));
+
+  // The least recently used entries are removed, the new one is kept
+  std::vector<builder::PlanKey> keys;
+  for (builder::Id executorsNumber = 1; executorsNumber <= 4;
+       ++executorsNumber) {
+    keys.push_back(builder::makePlanKey(
+        builder::hashGraph(graph),
+        builder::Executors::identical(executorsNumber), "heft",
+        builder::Placement::Append));
+    builder::save_cached_plan(directory, keys.back(), graph, criticalPath,
+                              3 * entrySize);
+    std::filesystem::last_write_time(
+        directory / (keys.back().hex() + ".plan"),
+        std::filesystem::file_time_type::clock::now() -
+            std::chrono::hours(10 - executorsNumber));
+  }
+  EXPECT_FALSE(builder::load_cached_plan(directory, keys[0], cached,
+                                         cachedPath));
+  EXPECT_TRUE(builder::load_cached_plan(directory, keys[1], cached,
+                                        cachedPath));
+  EXPECT_TRUE(builder::load_cached_plan(directory, keys[3], cached,
+                                        cachedPath));
+  builder::save_cached_plan(directory, key, graph, criticalPath, 0);
+  EXPECT_TRUE(builder::load_cached_plan(directory, key, cached, cachedPath));
+  EXPECT_FALSE(builder::load_cached_plan(directory, keys[3], cached,
+                                         cachedPath));
+  std::filesystem::remove_all(directory);
+}
+
+TEST(PlanCacheTests, FailedSaveLeavesNoTemporaryFile) {
+  auto graph = builder::parse_graph("a 3\nb 2 a");
+  builder::calculateRanks(graph);
+  builder::schedule(1, builder::computeRankIds(graph), graph);
+  const auto criticalPath = builder::getCriticalPath(graph);
+  const auto key = builder::makePlanKey(
+      builder::hashGraph(graph), builder::Executors::identical(1), "heft",
+      builder::Placement::Append);
+  const auto directory =
+      std::filesystem::temp_directory_path() / "builder_test_failed_cache";
+  std::filesystem::remove_all(directory);
+
+  // Cache directory is a regular file
+  std::ofstream(directory) << "not a directory";
+  EXPECT_THROW(builder::save_cached_plan(directory, key, graph, criticalPath,
+                                         1 << 20),
+               std::filesystem::filesystem_error);
+  std::filesystem::remove(directory);
+
+  // Entry can't be renamed into place
+  std::filesystem::create_directories(directory / (key.hex() + ".plan") /
+                                      "x");
+  EXPECT_THROW(builder::save_cached_plan(directory, key, graph, criticalPath,
+                                         1 << 20),
+               std::filesystem::filesystem_error);
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(directory),
+                          std::filesystem::directory_iterator()),
+            1);
+  std::filesystem::remove_all(directory);
+}
+
+TEST(PlanCacheTests, ExecuteCachedPlan) {
+  std::string testInput = R"(
+    a 1
+    b 9
+    c 5
+    d 1  a
+    e 1  b  c)";
+  auto graph = builder::parse_graph(testInput);
+  builder::calculateRanks(graph);
+  builder::schedule(1, builder::computeRankIds(graph), graph);
+  const auto key = builder::makePlanKey(
+      builder::hashGraph(graph), builder::Executors::identical(1), "heft",
+      builder::Placement::Append);
+  const auto directory =
+      std::filesystem::temp_directory_path() / "builder_test_execute_cache";
+  std::filesystem::remove_all(directory);
+  builder::save_cached_plan(directory, key, graph,
+                            builder::getCriticalPath(graph), 1 << 20);
+
+  auto cached = builder::parse_graph(testInput);
+  builder::CriticalPath cachedPath;
+  ASSERT_TRUE(builder::load_cached_plan(directory, key, cached, cachedPath));
+  std::filesystem::remove_all(directory);
+  auto run = [](const builder::Graph &graph) {
+    std::vector<builder::Id> order;
+    builder::execute(graph, 1, [&](builder::Id action) {
+      order.push_back(action);
+      return 0;
+    });
+    return order;
+  };
+  // Ranks aren't cached, executing in order of Ids would run a first
+  EXPECT_THAT([&]() { run(cached); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Ranks")));
+  builder::calculateRanks(cached);
+  const auto order = run(cached);
+  EXPECT_EQ(order, run(graph));
+  EXPECT_EQ(order.front(), cached.at("b"));
+}
+
+TEST(DispatchTests, HighestRankFirst) {
+  std::stringstream testStream(R"(
+    a 1
+    b 5
+    c 3
+    d 1 a
+    e 1 b c)");
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  builder::Dispatcher dispatcher(graph, 2);
+  std::vector<builder::Dispatch> decisions;
+  auto runs = [&]() {
+    std::vector<std::pair<std::string, builder::Id>> result;
+    for (auto &[action, executor] : decisions) {
+      result.emplace_back(graph.shas[action], executor);
+    }
+    decisions.clear();
+    return result;
+  };
+
+  dispatcher.start(decisions);
+  EXPECT_THAT(runs(), ElementsAre(Pair("b", 0), Pair("c", 1)));
+  dispatcher.finished(graph.at("c"), 1, decisions);
+  EXPECT_THAT(runs(), ElementsAre(Pair("a", 1)));
+  EXPECT_THAT([&]() { dispatcher.finished(graph.at("c"), 1, decisions); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("not running")));
+  EXPECT_THAT([&]() { dispatcher.finished(graph.at("b"), 1, decisions); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("not running")));
+  dispatcher.finished(graph.at("b"), 0, decisions);
+  EXPECT_THAT(runs(), ElementsAre(Pair("e", 0)));
+  dispatcher.finished(graph.at("a"), 1, decisions);
+  EXPECT_THAT(runs(), ElementsAre(Pair("d", 1)));
+  dispatcher.finished(graph.at("d"), 1, decisions);
+  EXPECT_FALSE(dispatcher.done());
+  dispatcher.finished(graph.at("e"), 0, decisions);
+  EXPECT_TRUE(runs().empty());
+  EXPECT_TRUE(dispatcher.done());
+}
+
+TEST(DispatchTests, TextEventsAndReplay) {
+  std::stringstream testStream(R"(
+    a 2
+    b 3 a
+    c 4 a)");
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+
+  std::stringstream events("finished a 3 0\n\nfinished c 9 0\n"
+                           "finished b 10 1\n");
+  std::stringstream decisions;
+  builder::run_dispatch(graph, 2, events, decisions);
+  EXPECT_EQ(decisions.str(), "run a 0\nrun c 0\nrun b 1\ndone\n");
+
+  std::stringstream badEvents("finished a 3 1\n");
+  EXPECT_THAT(
+      [&]() { builder::run_dispatch(graph, 2, badEvents, decisions); },
+      ThrowsMessage<std::runtime_error>(HasSubstr("Line 1: ")));
+
+  // Recorded durations are a 3, c 6 and b 7 instead of 2, 4 and 3
+  std::stringstream log("run a 0\nfinished a 3 0\nrun c 0\nrun b 1\n"
+                        "finished c 9 0\nfinished b 10 1\ndone\n");
+  const auto stats = builder::replay_dispatch(graph, 2, log);
+  EXPECT_EQ(stats.events, 3);
+  EXPECT_EQ(stats.makespan, 10);
+  EXPECT_GE(stats.maxLatencyNs, 0);
+  for (std::string badLog :
+       {"run a 0\nrun x 1\n", "run a 0\nfinished x 3 0\n"}) {
+    std::stringstream unknownLog(badLog);
+    EXPECT_THAT([&]() { builder::replay_dispatch(graph, 2, unknownLog); },
+                ThrowsMessage<std::runtime_error>(
+                    HasSubstr("Line 2: Unknown action x")));
+  }
+
+  // Without log actions take planned durations
+  for (uint32_t seed = 0; seed < 3; ++seed) {
+    std::stringstream randomStream(randomDAG(1000, 4, seed));
+    auto graph = builder::load_graph(randomStream);
+    builder::calculateRanks(graph);
+    std::stringstream emptyLog;
+    const auto stats = builder::replay_dispatch(graph, 8, emptyLog);
+    EXPECT_EQ(stats.events, graph.size() - 2);
+    EXPECT_GE(stats.makespan, getCriticalPath(graph).infiniteExecutorsLength);
+  }
+}
+
+TEST(ServerTests, Requests) {
+  std::stringstream testStream(R"(
+    a 2
+    b 3 a
+    c 4 a
+    d 1)");
+  builder::PlanningServer server(builder::load_graph(testStream),
+                                 builder::Placement::Append, 1);
+  std::stringstream requests("schedule 2\n\nmakespan 1 b\ncritical-path\n"
+                             "update c 1 d 8\nmakespan 2\nbad\n"
+                             "update c 0\nquit\nmakespan 1\n");
+  std::stringstream responses;
+  builder::run_server(server, requests, responses);
+  EXPECT_EQ(responses.str(), "a 0 0\nb 2 1\nc 2 0\nd 5 1\nok 6\n"
+                             "ok 5\n"
+                             "a\nc\nok 6\n"
+                             "ok 2\nok 8\n"
+                             "error unknown request 'bad', must be schedule, "
+                             "makespan, critical-path or update\n"
+                             "error Duration of action c must be positive, "
+                             "got 0\n");
+
+  std::string response;
+  server.handle("makespan 0", response);
+  server.handle("makespan 1 unknown", response);
+  server.handle("critical-path", response);
+  EXPECT_THAT(response, HasSubstr("error Number of executors must be "
+                                  "positive, got 0\nerror "));
+  EXPECT_THAT(response, HasSubstr("\nd\nok 8\n"));
+}
+
+TEST(ServerTests, UpdatesMatchFullRecalculation) {
+  const auto text = randomDAG(500, 4, 7);
+  std::stringstream testStream(text);
+  builder::PlanningServer server(builder::load_graph(testStream),
+                                 builder::Placement::Append, 0);
+  std::stringstream expectedStream(text);
+  auto expected = builder::load_graph(expectedStream);
+  std::mt19937 random(7);
+  for (int32_t round = 0; round < 10; ++round) {
+    std::string request{"update"};
+    for (int32_t change = 0; change < 3; ++change) {
+      const builder::Id id = 1 + random() % (expected.size() - 2);
+      expected.durations[id] = random() % 20 + 1;
+      request += " " + std::string(expected.shas[id]) + " " +
+                 std::to_string(expected.durations[id]);
+    }
+    std::string response;
+    server.handle(request, response);
+    ASSERT_THAT(response, testing::StartsWith("ok "));
+
+    builder::calculateRanks(expected);
+    const auto rankIds = builder::computeRankIds(expected);
+    builder::schedule(4, rankIds, expected);
+    const auto makespan = *std::max_element(expected.endTimes.begin(),
+                                            expected.endTimes.end());
+
+    // Queries of several threads at once give the same answers
+    std::vector<std::string> responses(4);
+    std::vector<std::thread> threads;
+    for (auto &threadResponse : responses) {
+      threads.emplace_back(
+          [&]() { server.handle("makespan 4", threadResponse); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto &threadResponse : responses) {
+      EXPECT_EQ(threadResponse, "ok " + std::to_string(makespan) + "\n");
+    }
+  }
+}
+
+TEST(StatsTests, PhasesAndCounters) {
+  builder::RunStats stats;
+  stats.begin("load_graph");
+  std::stringstream testStream(randomDAG(1000, 4, 3));
+  auto graph = builder::load_graph(testStream);
+  stats.end(graph);
+  stats.begin("schedule");
+  builder::calculateRanks(graph);
+  builder::schedule(4, builder::computeRankIds(graph), graph);
+  stats.end(graph);
+  // Nothing is measured after the phase ended
+  builder::schedule(4, builder::computeRankIds(graph), graph);
+
+  ASSERT_EQ(stats.phases().size(), 2);
+  const auto &load = stats.phases()[0];
+  const auto &schedule = stats.phases()[1];
+  EXPECT_EQ(load.name, "load_graph");
+  EXPECT_EQ(load.nodes, graph.size());
+  EXPECT_EQ(load.edges, graph.dependencies.targets.size());
+  EXPECT_GT(load.allocations, 0);
+  EXPECT_GT(load.allocatedBytes, 0);
+  EXPECT_GE(load.wallSeconds, 0);
+  EXPECT_GE(load.counters[static_cast<size_t>(
+                builder::Counter::ShaIndexRehashes)],
+            1);
+  // Every action is compared on all 4 identical executors
+  EXPECT_EQ(schedule.counters[static_cast<size_t>(
+                builder::Counter::ExecutorScans)],
+            4 * (graph.size() - 2));
+  EXPECT_EQ(
+      schedule.counters[static_cast<size_t>(builder::Counter::StallTime)] > 0,
+      schedule.counters[static_cast<size_t>(
+          builder::Counter::DependencyStalls)] > 0);
+
+  std::stringstream json;
+  builder::save_stats(stats, builder::parse_stats_format("json"), json);
+  EXPECT_THAT(json.str(),
+              testing::StartsWith(
+                  "{\"phases\":[{\"name\":\"load_graph\",\"wall_seconds\":"));
+  EXPECT_THAT(json.str(), HasSubstr("\"executor_scans\":" +
+                                    std::to_string(4 * (graph.size() - 2))));
+  EXPECT_THAT(json.str(), HasSubstr("\"peak_resident_bytes\":"));
+  std::stringstream text;
+  builder::save_stats(stats, builder::StatsFormat::Text, text);
+  EXPECT_THAT(text.str(), HasSubstr("schedule executor_scans = "));
+  EXPECT_THAT([]() { builder::parse_stats_format("xml"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("'xml'")));
+}
+
+TEST(ExecutionTests, RunsActionsAfterDependencies) {
+  for (uint32_t seed = 0; seed < 3; ++seed) {
+    std::stringstream testStream(randomDAG(300, 4, seed));
+    auto graph = builder::load_graph(testStream);
+    builder::calculateRanks(graph);
+    schedule(4, computeRankIds(graph), graph);
+
+    std::mutex mutex;
+    std::vector<builder::Id> order;
+    const auto result =
+        builder::execute(graph, 4, [&](builder::Id action) {
+          std::lock_guard<std::mutex> lock(mutex);
+          order.push_back(action);
+          return 0;
+        });
+    ASSERT_EQ(order.size(), static_cast<size_t>(graph.size() - 2));
+    std::vector<size_t> position(graph.size(), 0);
+    for (size_t i = 0; i < order.size(); ++i) {
+      position[order[i]] = i + 1;
+    }
+    for (builder::Id id = graph.startId() + 1; id < graph.endId(); ++id) {
+      EXPECT_GE(result.durations[id], 0);
+      EXPECT_GE(result.executorIds[id], 0);
+      for (auto dependency = graph.dependencies.begin(id);
+           dependency != graph.dependencies.end(id); ++dependency) {
+        if (*dependency != graph.startId()) {
+          EXPECT_LT(position[*dependency], position[id]);
+        }
+      }
+    }
+    EXPECT_EQ(result.failedAction, -1);
+  }
+}
+
+TEST(ExecutionTests, StopsAfterFailure) {
+  std::stringstream testStream(R"(
+    a 5
+    b 1 a
+    c 1 b)");
+  auto graph = builder::load_graph(testStream);
+  builder::calculateRanks(graph);
+  std::atomic<int> runs{0};
+  const auto result = builder::execute(graph, 2, [&](builder::Id action) {
+    ++runs;
+    return action == graph.at("b") ? 3 : 0;
+  });
+  EXPECT_EQ(result.failedAction, graph.at("b"));
+  EXPECT_EQ(result.failedStatus, 3);
+  EXPECT_EQ(result.durations[graph.at("c")], -1);
+  EXPECT_EQ(runs, 2);
+}
+
+TEST(ExecutionTests, CommandsAndSavedGraph) {
+  std::stringstream testStream("a 5\nb 1 a:30\nc 2 a b");
+  auto graph = builder::load_graph(testStream);
+  std::stringstream commandsStream("a  echo a\n\nb sh -c 'exit 0'\nc true");
+  const auto commands = builder::load_commands(commandsStream, graph);
+  EXPECT_EQ(commands[graph.at("a")], "echo a");
+  EXPECT_EQ(commands[graph.at("b")], "sh -c 'exit 0'");
+
+  auto load = [&](std::string input) {
+    std::stringstream stream(input);
+    builder::load_commands(stream, graph);
+  };
+  EXPECT_THAT([&]() { load("a x\nb x\nc x\nd x"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 4: ")));
+  EXPECT_THAT([&]() { load("a x\nb x\na y\nc x"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("Line 3: ")));
+  EXPECT_THAT([&]() { load("a x\nc x"); },
+              ThrowsMessage<std::runtime_error>(HasSubstr("action b")));
+
+  std::stringstream saved;
+  builder::save_graph(graph, saved);
+  EXPECT_EQ(saved.str(), "a 5\nb 1 a:30\nc 2 a b\n");
+}